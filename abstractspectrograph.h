@@ -3,6 +3,8 @@
 
 #include <QWidget>
 #include <QVector>
+#include "fft.h"
+#include "spectrumframestore.h"
 
 // the spectrum visualization widget
 /**
@@ -23,7 +25,17 @@ public:
    * @param parent is the pointer to parent widget (it is supposed to be the place
      * where this widget has to be drawn)
    */
-  explicit AbstractSpectrograph(QWidget *parent):QWidget(parent){}
+  explicit AbstractSpectrograph(QWidget *parent):QWidget(parent), frames(0){}
+
+  /**
+   * @brief setSpectrumSource tells where the spectrum analyzer publishes its spectra
+   * @details Subclasses call pollSpectrum() whenever they are about to draw, and
+   * the newest spectrum is passed to loadSamples(). A subclass that has nothing
+   * to animate may stop polling with sleepSpectrum(); spectrumReady() is called
+   * when the next spectrum arrives
+   * @param store is the frame store written by the analyzer
+   */
+  void setSpectrumSource(SpectrumFrameStore *store){ frames = store; }
 
 signals:
 
@@ -31,14 +43,84 @@ public slots:
   // load the spectrum to be displayed
   /**
    * @brief loadSamples should be used to load the spectrum to be displayed
+   * @details SpectrumReal is double, or float when the analyzer is built
+   * in single precision
+   */
+  virtual void loadSamples(QVector<SpectrumReal>&)=0;
+
+  /**
+   * @brief loadChannels loads a frame holding the spectra of several channels
+   * @details The spectra come one after the other, each size()/channels
+   * values long. By default the channels are merged, band by band, into
+   * their loudest value and passed to loadSamples(). Widgets that can show
+   * the channels apart override it
+   * @param spectra holds the spectra. It may be changed
+   * @param channels is the number of spectra
    */
-  virtual void loadSamples(QVector<double>&)=0;
+  virtual void loadChannels(QVector<SpectrumReal> &spectra, int channels){
+    int bands;
+
+    if(channels > 1){
+      bands = spectra.size()/channels;
+      for(int c=1; c<channels; c++){
+        for(int i=0; i<bands; i++)
+          spectra[i] = qMax(spectra[i], spectra[c*bands + i]);
+      }
+      spectra.resize(bands);
+    }
+    loadSamples(spectra);
+  }
 
   //
   /**
    * @brief loadLevels should be used to load left and right mean audio levels
+   * @details The levels are rms levels, already placed on the level bars:
+   * 0 is METER_RANGE decibels below full scale and 1 is full scale
    */
     virtual void loadLevels(double, double)=0;
+
+  /**
+   * @brief loadPeaks loads the left and right true peaks, on the same
+   * scale as loadLevels()
+   * @details Widgets with level bars may hold them for a while. By default
+   * they are not shown
+   */
+  virtual void loadPeaks(double, double){}
+
+  /**
+   * @brief spectrumReady is called when a spectrum arrives after sleepSpectrum()
+   * @details By default it schedules a repaint. Subclasses that poll from a
+   * timer restart it here
+   */
+  virtual void spectrumReady(){ update(); }
+
+protected:
+  /**
+   * @brief pollSpectrum loads the newest spectrum from the spectrum source
+   * @return true if a new spectrum was passed to loadChannels()
+   */
+  bool pollSpectrum(){
+    if(frames && frames->acquire()){
+      loadChannels(frames->front(), frames->frontChannels());
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * @brief sleepSpectrum stops polling until spectrumReady() is called
+   * @return false when a spectrum arrived in the meantime. The subclass
+   * must keep polling then
+   */
+  bool sleepSpectrum(){
+    return !frames || frames->sleep();
+  }
+
+private:
+  /**
+   * @brief frames is the spectrum source
+   */
+  SpectrumFrameStore *frames;
 };
 
 #endif // ABSTRACTSPECTROGRAPH_H
@@ -0,0 +1,157 @@
+#include "bandmapper.h"
+#include "simdkernels.h"
+#include <cmath>
+
+// the perceptual scales start here, a bit below what anyone hears
+#define MIN_FREQUENCY 20.0
+
+// rows shorter than this are summed in place. a kernel call
+// costs more than the few products it would save
+#define MIN_KERNEL_ROW 16
+
+static double hzToMel(double f){
+  return 2595*log10(1 + f/700);
+}
+
+static double melToHz(double m){
+  return 700*(pow(10, m/2595) - 1);
+}
+
+// traunmuller's approximation of the bark scale
+static double hzToBark(double f){
+  return 26.81*f/(1960 + f) - 0.53;
+}
+
+static double barkToHz(double z){
+  return 1960*(z + 0.53)/(26.28 - z);
+}
+
+BandMapper::BandMapper(){
+  binCount = 0;
+}
+
+void BandMapper::configure(int bins, int sampleRate, int bands, BandScale scale){
+  QVector<double> edges;
+  double nyquist, low, high, position, center;
+  int first, last;
+  Row row;
+
+  binCount = qMax(0, bins);
+  rows.clear();
+  weights.clear();
+  if(binCount == 0 || bands <= 0 || sampleRate <= 0)
+    return;
+
+  // bin j is centered at j*sampleRate/(2*bins) hertz and covers
+  // [j, j+1) on the bin axis, so a frequency f lies at
+  // f*2*bins/sampleRate + 0.5 on that axis
+  nyquist = sampleRate/2.0;
+  switch(scale){
+  case SCALE_LINEAR:
+    for(int i=0; i<=bands; i++)
+      edges.append(double(i)*binCount/bands);
+    break;
+  case SCALE_MEL:
+  case SCALE_BARK:
+    if(scale == SCALE_MEL){
+      low = hzToMel(MIN_FREQUENCY);
+      high = hzToMel(nyquist);
+    }
+    else{
+      low = hzToBark(MIN_FREQUENCY);
+      high = hzToBark(nyquist);
+    }
+    for(int i=0; i<=bands; i++){
+      position = low + (high - low)*i/bands;
+      position = scale == SCALE_MEL ? melToHz(position) : barkToHz(position);
+      edges.append(position*binCount/nyquist + 0.5);
+    }
+    break;
+  case SCALE_THIRD_OCTAVE:
+    // iso centers are 1000*2^(k/3) hertz. each band spans
+    // 1/6 octave on both sides of its center
+    for(int k=-17; ; k++){
+      center = 1000*pow(2.0, k/3.0);
+      if(center > nyquist)
+        break;
+      if(center < MIN_FREQUENCY)
+        continue;
+      if(edges.isEmpty())
+        edges.append(center*pow(2.0, -1/6.0)*binCount/nyquist + 0.5);
+      edges.append(center*pow(2.0, 1/6.0)*binCount/nyquist + 0.5);
+    }
+    break;
+  default:
+    // the same geometric spacing the spectrum display always had
+    for(int i=0; i<=bands; i++)
+      edges.append(pow(double(binCount), double(i)/bands) - 0.5);
+    break;
+  }
+
+  // each band adds up the bins it overlaps, weighted
+  // by the length of the overlap
+  for(int i=0; i+1<edges.size(); i++){
+    low = qBound(0.0, edges[i], double(binCount));
+    high = qBound(0.0, edges[i+1], double(binCount));
+    row.offset = weights.size();
+    row.first = 0;
+    row.count = 0;
+    if(high > low){
+      first = int(floor(low));
+      last = qMin(binCount-1, int(ceil(high)) - 1);
+      row.first = first;
+      row.count = last - first + 1;
+      for(int j=first; j<=last; j++)
+        weights.append(SpectrumReal(qMin(high, j + 1.0) - qMax(low, double(j))));
+    }
+    rows.append(row);
+  }
+}
+
+void BandMapper::apply(const SpectrumReal *in, SpectrumReal *out) const{
+  const FFTKernels &kernels = fftKernels();
+  const SpectrumReal *w = weights.constData();
+  const Row *row = rows.constData();
+  SpectrumReal sum;
+
+  for(int i=0; i<rows.size(); i++, row++){
+    if(row->count >= MIN_KERNEL_ROW){
+      out[i] = dot(kernels, in + row->first, w + row->offset, row->count);
+    }
+    else{
+      sum = 0;
+      for(int j=0; j<row->count; j++)
+        sum += in[row->first + j]*w[row->offset + j];
+      out[i] = sum;
+    }
+  }
+}
+
+void BandMapper::applyCompressed(const SpectrumReal *in, SpectrumReal *out,
+                                 bool approximate) const{
+  const int bands = rows.size();
+  SpectrumReal sum, val;
+
+  apply(in, out);
+
+  // the same scale, with log10(x) = log10(2)*log2(x):
+  // 1 + 20*log10(sum*bands/12)/40
+  if(approximate){
+    logScale(fftKernels(), out, out, bands, SpectrumReal(0.5*log10(2.0)),
+             SpectrumReal(1 + 0.5*log10(bands/12.0)));
+    return;
+  }
+
+  for(int i=0; i<bands; i++){
+    /* fudge factor to make the graph have the same overall height as a
+       12-band one no matter how many bands there are */
+    sum = out[i]*bands/12;
+
+    /* convert to dB */
+    val = 20*log10(sum);
+
+    /* scale (-DB_RANGE, 0.0) to (0.0, 1.0) */
+    val = 1 + val / 40;
+    out[i] = qBound(SpectrumReal(0), val, SpectrumReal(1));
+  }
+}
@@ -0,0 +1,114 @@
+#ifndef BANDMAPPER_H
+#define BANDMAPPER_H
+
+#include <QVector>
+#include "fft.h"
+
+/**
+ * @brief BandScale lists the frequency scales the bands may follow
+ */
+enum BandScale{
+  /**
+   * @brief SCALE_LOG spaces the band edges geometrically over the bins,
+   * like the classic spectrum display
+   */
+  SCALE_LOG = 0,
+  /**
+   * @brief SCALE_LINEAR gives every band the same number of bins
+   */
+  SCALE_LINEAR,
+  /**
+   * @brief SCALE_MEL spaces the bands evenly in mels, from 20 Hz to Nyquist
+   */
+  SCALE_MEL,
+  /**
+   * @brief SCALE_BARK spaces the bands evenly in barks, from 20 Hz to Nyquist
+   */
+  SCALE_BARK,
+  /**
+   * @brief SCALE_THIRD_OCTAVE uses the ISO 1/3 octave bands between 20 Hz
+   * and Nyquist. The number of bands follows from the sample rate
+   */
+  SCALE_THIRD_OCTAVE,
+  SCALE_COUNT
+};
+
+/**
+ * @brief The BandMapper class folds the bins of a spectrum into display bands
+ * @details Each band is a weighted sum of the bins it overlaps. Bin j covers
+ * [j, j+1) on the bin axis and its weight in a band is the length of the
+ * overlap, so partial bins at the band edges count in proportion.
+ *
+ * The weights are computed once per configuration and stored as a sparse
+ * matrix: one row per band, each holding a contiguous run of bins. A row
+ * costs one dot product with the vector kernels, and every bin belongs to
+ * at most a few rows, so applying the mapping costs about the same for 32
+ * or for 1024 bands.
+ */
+class BandMapper{
+public:
+  /**
+   * @brief Creates an empty mapping, with no bins and no bands
+   */
+  BandMapper();
+
+  /**
+   * @brief configure builds the weights of a new mapping
+   * @param bins is the number of magnitudes in each spectrum
+   * @param sampleRate is the sample rate of the analyzed audio. The spectrum
+   * spans from 0 to half of it
+   * @param bands is the number of bands wanted. SCALE_THIRD_OCTAVE ignores it
+   * @param scale tells how the band edges are spaced
+   */
+  void configure(int bins, int sampleRate, int bands, BandScale scale);
+
+  /**
+   * @brief bands returns the number of bands of the mapping
+   */
+  int bands() const { return rows.size(); }
+
+  /**
+   * @brief bins returns the number of magnitudes the mapping expects
+   */
+  int bins() const { return binCount; }
+
+  /**
+   * @brief apply folds a spectrum into bands
+   * @param in points to bins() magnitudes
+   * @param out receives bands() sums
+   */
+  void apply(const SpectrumReal *in, SpectrumReal *out) const;
+
+  /**
+   * @brief applyCompressed folds a spectrum into bands on the display's
+   * decibel scale
+   * @details Each band sum s is scaled by bands()/12, so the graph is as
+   * high as a 12 band one, and shown at 1 + 20*log10(s)/40: the top 40 dB
+   * fill [0,1], and anything outside is clamped.
+   * @param in points to bins() magnitudes
+   * @param out receives bands() values within [0,1]
+   * @param approximate takes the logarithm with the vector kernel, within
+   * 0.001 dB, instead of calling log10 for every band
+   */
+  void applyCompressed(const SpectrumReal *in, SpectrumReal *out, bool approximate) const;
+
+private:
+  /**
+   * @brief The Row struct tells which bins a band adds up and where its
+   * weights are
+   */
+  struct Row{
+    int first, count, offset;
+  };
+
+  QVector<Row> rows;
+
+  /**
+   * @brief weights holds the weights of all rows, one after the other
+   */
+  QVector<SpectrumReal> weights;
+
+  int binCount;
+};
+
+#endif // BANDMAPPER_H
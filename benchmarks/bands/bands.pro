@@ -0,0 +1,18 @@
+# times the compressed spectrum, from the bins to the display
+# values, with exact and with approximate decibels
+TEMPLATE = app
+TARGET = bench_bands
+CONFIG += console release
+CONFIG -= app_bundle
+QT -= gui
+
+INCLUDEPATH += ../..
+
+SOURCES += bench_bands.cpp \
+    ../../bandmapper.cpp \
+    ../../simdkernels.cpp \
+    ../../fft.cpp
+
+HEADERS += ../../bandmapper.h \
+    ../../simdkernels.h \
+    ../../fft.h
@@ -0,0 +1,57 @@
+// times what the analyzer does with the bins of each frame when
+// the spectrum is compressed: magnitudes, folding into bands and
+// decibels. the exact decibels call log10 for every band, the
+// approximate ones take the vector log kernel. the best time of
+// a few runs is printed, in microseconds per spectrum
+
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <QElapsedTimer>
+#include "bandmapper.h"
+#include "simdkernels.h"
+
+static const int REPEATS = 2000;
+static const int RUNS = 5;
+
+static double spectrumTime(const BandMapper &mapper, const std::vector<SpectrumComplex> &bins,
+                           bool approximate){
+  std::vector<SpectrumReal> magnitude(bins.size()), out(mapper.bands());
+  QElapsedTimer timer;
+  qint64 best = -1;
+
+  for(int run=0; run<RUNS; run++){
+    timer.start();
+    for(int i=0; i<REPEATS; i++){
+      magnitudes(fftKernels(), &bins[0], &magnitude[0], bins.size(), SpectrumReal(1));
+      mapper.applyCompressed(&magnitude[0], &out[0], approximate);
+    }
+    qint64 elapsed = timer.nsecsElapsed();
+    if(best < 0 || elapsed < best)
+      best = elapsed;
+  }
+  return best * 1e-3 / REPEATS;
+}
+
+int main(){
+  static const int binCounts[] = {256, 2048, 8192};
+  static const int bandCounts[] = {64, 256, 1024};
+
+  srand(1);
+  printf("us per spectrum, %s, %s kernels\n",
+         sizeof(SpectrumReal) == sizeof(float) ? "float" : "double", fftKernels().name);
+  printf("%-6s%-7s%10s%13s\n", "bins", "bands", "exact", "approximate");
+  for(int i=0; i<3; i++){
+    std::vector<SpectrumComplex> bins(binCounts[i]);
+    for(int k=0; k<binCounts[i]; k++)
+      bins[k] = SpectrumComplex(SpectrumReal(rand()) / RAND_MAX, SpectrumReal(rand()) / RAND_MAX);
+    for(int j=0; j<3; j++){
+      BandMapper mapper;
+      mapper.configure(binCounts[i], 44100, bandCounts[j], SCALE_LOG);
+      printf("%-6d%-7d%10.2f%13.2f\n", binCounts[i], bandCounts[j],
+             spectrumTime(mapper, bins, false), spectrumTime(mapper, bins, true));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,4 @@
+# timings of the analysis and drawing code. they are not checks: build
+# them in release mode and run them by hand
+TEMPLATE = subdirs
+SUBDIRS = pcmconvert bands spectrograph precision
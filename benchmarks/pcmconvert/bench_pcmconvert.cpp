@@ -0,0 +1,109 @@
+// times the pcm conversion kernels. a buffer of a second of
+// 8 channel audio is converted over and over with each kernel,
+// and the best time of a few runs is printed for each format,
+// in nanoseconds per sample. the channel count does not
+// matter to the kernels, which read the samples in the order
+// they come. the last table times what the converter thread
+// does with a stereo buffer for each channel mode
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <QElapsedTimer>
+#include "pcmconvert.h"
+
+static const char *formatNames[PCM_FORMATS] = {
+  "u8", "s8", "u16", "s16", "s24", "u32", "s32", "f32"
+};
+
+static const char *modeNames[PCM_CHANNEL_MODES] = {
+  "left", "right", "mid", "side", "mid/side", "all"
+};
+
+// a second at 48 kHz, 8 channels
+static const int SAMPLES = 48000*8;
+static const int REPEATS = 20;
+static const int RUNS = 5;
+
+static double kernelTime(PcmConvertKernel convert, const void *in, SpectrumReal *out){
+  QElapsedTimer timer;
+  qint64 best = -1;
+
+  for(int run=0; run<RUNS; run++){
+    timer.start();
+    for(int i=0; i<REPEATS; i++)
+      convert(in, SAMPLES, out);
+    qint64 elapsed = timer.nsecsElapsed();
+    if(best < 0 || elapsed < best)
+      best = elapsed;
+  }
+  return double(best) / REPEATS / SAMPLES;
+}
+
+static double modeTime(const void *in, PcmChannelMode mode,
+                       SpectrumReal *channels, SpectrumReal *out){
+  const int frames = SAMPLES/2;
+  QAudioFormat format;
+  QElapsedTimer timer;
+  qint64 best = -1;
+
+  format.setChannelCount(2);
+  format.setSampleSize(16);
+  format.setSampleType(QAudioFormat::SignedInt);
+  format.setByteOrder(QAudioFormat::LittleEndian);
+  for(int run=0; run<RUNS; run++){
+    timer.start();
+    for(int i=0; i<REPEATS; i++){
+      pcmConvertChannels(format, in, frames, channels);
+      if(mode != PCM_ALL_CHANNELS)
+        pcmSelectStreams(channels, frames, 2, mode, out);
+    }
+    qint64 elapsed = timer.nsecsElapsed();
+    if(best < 0 || elapsed < best)
+      best = elapsed;
+  }
+  return double(best) / REPEATS / frames;
+}
+
+int main(){
+  std::vector<uchar> bytes(SAMPLES*4);
+  std::vector<SpectrumReal> channels(SAMPLES), out(SAMPLES);
+  const PcmKernels *levels[SIMD_AVX512 + 1];
+  int count = 0;
+
+  // full scale noise. float samples are made of random
+  // bytes too, a few of them are nans and get muted
+  srand(1);
+  for(size_t i=0; i<bytes.size(); i++)
+    bytes[i] = uchar(rand());
+
+  // levels the cpu lacks fall back to a supported one
+  for(int level=SIMD_SCALAR; level<=SIMD_AVX512; level++){
+    const PcmKernels &kernels = pcmKernels(SimdLevel(level));
+    bool seen = false;
+    for(int i=0; i<count; i++)
+      seen = seen || levels[i] == &kernels;
+    if(!seen)
+      levels[count++] = &kernels;
+  }
+
+  printf("ns per sample, %s\n", sizeof(SpectrumReal) == sizeof(float) ? "float" : "double");
+  printf("%-6s", "");
+  for(int i=0; i<count; i++)
+    printf("%10s", levels[i]->name);
+  printf("\n");
+  for(int f=0; f<PCM_FORMATS; f++){
+    printf("%-6s", formatNames[f]);
+    for(int i=0; i<count; i++)
+      printf("%10.3f", kernelTime(levels[i]->convert[f], &bytes[0], &out[0]));
+    printf("\n");
+  }
+
+  printf("\nns per stereo s16 frame, converted and split, %s kernels\n",
+         pcmKernels().name);
+  for(int mode=0; mode<PCM_CHANNEL_MODES; mode++){
+    printf("%-10s%10.3f\n", modeNames[mode],
+           modeTime(&bytes[0], PcmChannelMode(mode), &channels[0], &out[0]));
+  }
+  return 0;
+}
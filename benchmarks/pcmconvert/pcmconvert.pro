@@ -0,0 +1,19 @@
+# times the pcm conversion kernels, for every sample format
+# and every kernel set the cpu supports
+TEMPLATE = app
+TARGET = bench_pcmconvert
+CONFIG += console release
+CONFIG -= app_bundle
+QT -= gui
+QT += multimedia
+
+INCLUDEPATH += ../..
+
+SOURCES += bench_pcmconvert.cpp \
+    ../../pcmconvert.cpp \
+    ../../simdkernels.cpp \
+    ../../fft.cpp
+
+HEADERS += ../../pcmconvert.h \
+    ../../simdkernels.h \
+    ../../fft.h
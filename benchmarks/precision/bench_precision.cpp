@@ -0,0 +1,83 @@
+// times what the analyzer does with each frame, the real input
+// FFT and the scaled magnitudes, with floats and with doubles,
+// as CONFIG+=fft_float would build it. the input mixes tones of
+// 0, -40 and -80 dB with some noise. the errors are those of the
+// float results against the double ones: the largest bin error,
+// relative to the largest bin, and the largest magnitude error,
+// on the [0,1] scale the display takes. the best time of a few
+// runs is printed, in microseconds per frame
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <QElapsedTimer>
+#include "fft.h"
+#include "simdkernels.h"
+
+static const int FRAMES = 20000000;
+static const int RUNS = 5;
+
+template <typename T>
+static double frameTime(const std::vector<T> &in, std::vector<std::complex<T> > &bins,
+                        std::vector<T> &magnitude){
+  size_t n = in.size();
+  BasicRealFFTPlan<T> plan(n);
+  int repeats = FRAMES / int(n) + 1;
+  QElapsedTimer timer;
+  qint64 best = -1;
+
+  plan.setKernels(fftKernels());
+  for(int run=0; run<RUNS; run++){
+    timer.start();
+    for(int i=0; i<repeats; i++){
+      plan.transform(&in[0], &bins[0]);
+      magnitudes(fftKernels(), &bins[0], &magnitude[0], n/2, T(2.0/n));
+    }
+    qint64 elapsed = timer.nsecsElapsed();
+    if(best < 0 || elapsed < best)
+      best = elapsed;
+  }
+  return best * 1e-3 / repeats;
+}
+
+int main(){
+  static const size_t sizes[] = {256, 1024, 4096, 16384, 65536};
+
+  srand(1);
+  printf("us per frame, %s kernels\n", fftKernels().name);
+  printf("%-8s%10s%10s%9s%12s%12s\n", "size", "double", "float", "speedup",
+         "bin error", "mag error");
+  for(int s=0; s<5; s++){
+    size_t n = sizes[s];
+    std::vector<double> in(n);
+    std::vector<float> inf(n);
+    std::vector<std::complex<double> > bins(n/2 + 1);
+    std::vector<std::complex<float> > binsf(n/2 + 1);
+    std::vector<double> magnitude(n/2);
+    std::vector<float> magnitudef(n/2);
+    double largest = 0, binError = 0, magnitudeError = 0;
+
+    for(size_t i=0; i<n; i++){
+      in[i] = 0.5*std::sin(0.1*i) + 0.005*std::sin(0.37*i) + 0.00005*std::sin(1.3*i) +
+          1e-3*(double(rand()) / RAND_MAX - 0.5);
+      inf[i] = float(in[i]);
+    }
+    double timeDouble = frameTime(in, bins, magnitude);
+    double timeFloat = frameTime(inf, binsf, magnitudef);
+
+    // the float input is rounded too, which is
+    // part of what single precision loses
+    for(size_t k=0; k<=n/2; k++){
+      largest = std::max(largest, std::abs(bins[k]));
+      binError = std::max(binError, std::abs(bins[k] - std::complex<double>(binsf[k])));
+    }
+    for(size_t k=0; k<n/2; k++)
+      magnitudeError = std::max(magnitudeError, std::fabs(magnitude[k] - magnitudef[k]));
+    printf("%-8u%10.2f%10.2f%9.2f%12.2e%12.2e\n", unsigned(n), timeDouble, timeFloat,
+           timeDouble / timeFloat, binError / largest, magnitudeError);
+  }
+  return 0;
+}
@@ -0,0 +1,16 @@
+# times the real input FFT and the magnitudes in single and in
+# double precision, and measures what single precision loses
+TEMPLATE = app
+TARGET = bench_precision
+CONFIG += console release
+CONFIG -= app_bundle
+QT -= gui
+
+INCLUDEPATH += ../..
+
+SOURCES += bench_precision.cpp \
+    ../../fft.cpp \
+    ../../simdkernels.cpp
+
+HEADERS += ../../fft.h \
+    ../../simdkernels.h
@@ -0,0 +1,18 @@
+# times how long the spectrograph takes to paint, classic and
+# batched, at a few widget sizes
+TEMPLATE = app
+TARGET = bench_spectrograph
+CONFIG += console release
+CONFIG -= app_bundle
+QT += widgets
+
+INCLUDEPATH += ../..
+
+SOURCES += bench_spectrograph.cpp \
+    ../../spectrograph.cpp \
+    ../../spectrumframestore.cpp
+
+HEADERS += ../../spectrograph.h \
+    ../../abstractspectrograph.h \
+    ../../spectrumframestore.h \
+    ../../fft.h
@@ -1,24 +1,252 @@
 #include "fft.h"
+#include "simdkernels.h"
+#include <algorithm>
 
-void fft(CArray& x){
-    const size_t N = x.size();
-    if (N <= 1) return;
-
-    // split parts to build the butterfly
-    CArray even = x[std::slice(0, N/2, 2)];
-    CArray  odd = x[std::slice(1, N/2, 2)];
-
-    // let's work
-    fft(even);
-    fft(odd);
-
-    // combine the parts
-    for (size_t k = 0; k < N/2; ++k)
-    {
-        Complex t = std::polar(1.0, -2 * PI * k / N) * odd[k];
-        x[k] = even[k] + t;
-        x[k+N/2] = even[k] - t;
+// the kernel set has one entry for each data type.
+// these helpers pick the right one
+static inline void radix4Pass(const FFTKernels *kernels, std::complex<double> *x,
+                              size_t n, size_t m, const std::complex<double> *w){
+  kernels->radix4(x, n, m, w);
+}
+
+static inline void radix4Pass(const FFTKernels *kernels, std::complex<float> *x,
+                              size_t n, size_t m, const std::complex<float> *w){
+  kernels->radix4f(x, n, m, w);
+}
+
+template <typename T>
+BasicFFTPlan<T>::BasicFFTPlan(size_t n){
+  kernels = &fftKernels();
+  resize(n);
+}
+
+template <typename T>
+void BasicFFTPlan<T>::resize(size_t _n){
+  unsigned bits, j;
+  size_t m;
+  n = _n;
+  swaps.clear();
+  twiddles.clear();
+  chirp.clear();
+  filter.clear();
+  work.clear();
+
+  // sizes that are not a power of two are convolved with
+  // a chirp, using a power of two transform of at least
+  // 2n-1 points
+  radixSize = 1;
+  while(radixSize < n)
+    radixSize *= 2;
+  if(radixSize != n && n > 1)
+    for(radixSize=1; radixSize < 2*n-1; radixSize *= 2);
+
+  // number of bits needed to index the array
+  bits = 0;
+  while((size_t(1) << bits) < radixSize)
+    bits++;
+
+  // record the pairs exchanged by the bit reversal permutation.
+  // each pair is stored only once (i < j)
+  for(size_t i=0; i<radixSize; i++){
+    j = 0;
+    for(unsigned b=0; b<bits; b++){
+      if(i & (size_t(1) << b))
+        j |= 1u << (bits-1-b);
+    }
+    if(i < j){
+      swaps.push_back(i);
+      swaps.push_back(j);
     }
+  }
+
+  // twiddle factors are calculated once, so no trig function
+  // is called while transforming. each radix-4 pass reads its
+  // own contiguous block of w^k, w^2k and w^3k, which suits the
+  // vector kernels. they are always calculated in double precision
+  for(m = (bits % 2) ? 2 : 1; m<radixSize; m*=4){
+    for(unsigned p=1; p<=3; p++){
+      for(size_t k=0; k<m; k++){
+        twiddles.push_back(ComplexT(std::polar(1.0, -2 * PI * p * k / (4*m))));
+      }
+    }
+  }
+
+  if(radixSize == n || n < 2)
+    return;
+
+  // the chirp is exp(-PI*i*k^2/n). k^2 is taken modulo 2n,
+  // so the angle stays small and accurate for big k
+  chirp.resize(n);
+  for(size_t k=0; k<n; k++){
+    chirp[k] = ComplexT(std::polar(1.0, -PI * double((k*k) % (2*n)) / n));
+  }
+
+  // the filter is the conjugate chirp, wrapped around so the
+  // circular convolution equals the linear one on [0,n)
+  filter.assign(radixSize, ComplexT(0));
+  filter[0] = std::conj(chirp[0]);
+  for(size_t k=1; k<n; k++){
+    filter[k] = filter[radixSize-k] = std::conj(chirp[k]);
+  }
+  radixTransform(&filter[0]);
+  for(size_t k=0; k<radixSize; k++){
+    filter[k] /= T(radixSize);
+  }
+  work.resize(radixSize);
+}
+
+template <typename T>
+void BasicFFTPlan<T>::setKernels(const FFTKernels &_kernels){
+  kernels = &_kernels;
+}
+
+template <typename T>
+void BasicFFTPlan<T>::radixTransform(ComplexT *x) const{
+  size_t m;
+  const ComplexT *w;
+  ComplexT t;
+
+  if (radixSize <= 1) return;
+
+  // reorder the input so the butterflies can work in place
+  for(size_t i=0; i<swaps.size(); i+=2){
+    std::swap(x[swaps[i]], x[swaps[i+1]]);
+  }
+
+  // when log2(n) is odd, a single radix-2 pass makes
+  // transforms of size 2 before the radix-4 passes start
+  for(m=1; m<radixSize; m*=4);
+  if(m != radixSize){
+    for(size_t base=0; base<radixSize; base+=2){
+      t = x[base+1];
+      x[base+1] = x[base] - t;
+      x[base] += t;
+    }
+    m = 2;
+  }
+  else{
+    m = 1;
+  }
+
+  // each radix-4 pass merges four transforms of size m
+  // into one of size 4m
+  for(w = &twiddles[0]; m<radixSize; w+=3*m, m*=4){
+    radix4Pass(kernels, x, radixSize, m, w);
+  }
+}
+
+template <typename T>
+void BasicFFTPlan<T>::transform(ComplexT *x) const{
+  ComplexT *y;
+
+  if(chirp.empty()){
+    radixTransform(x);
+    return;
+  }
+
+  // bluestein: X[k] = chirp[k] * sum(x[j]*chirp[j] * conj(chirp[k-j]))
+  y = &work[0];
+  for(size_t k=0; k<n; k++){
+    y[k] = x[k]*chirp[k];
+  }
+  std::fill(y+n, y+radixSize, ComplexT(0));
+  radixTransform(y);
+
+  // the inverse transform is the forward one between two
+  // conjugations. the filter already holds the scaling
+  for(size_t k=0; k<radixSize; k++){
+    y[k] = std::conj(y[k]*filter[k]);
+  }
+  radixTransform(y);
+  for(size_t k=0; k<n; k++){
+    x[k] = std::conj(y[k])*chirp[k];
+  }
+}
+
+template <typename T>
+void BasicFFTPlan<T>::transform(std::valarray<ComplexT> &x) const{
+  transform(&x[0]);
+}
+
+template <typename T>
+BasicRealFFTPlan<T>::BasicRealFFTPlan(size_t n){
+  resize(n);
+}
+
+template <typename T>
+void BasicRealFFTPlan<T>::resize(size_t _n){
+  n = _n;
+  half.resize(n/2);
+  twiddles.resize(n/4+1);
+  for(size_t k=0; k<=n/4; k++){
+    twiddles[k] = ComplexT(std::polar(1.0, -2 * PI * k / n));
+  }
+}
+
+template <typename T>
+void BasicRealFFTPlan<T>::setKernels(const FFTKernels &kernels){
+  half.setKernels(kernels);
+}
+
+template <typename T>
+void BasicRealFFTPlan<T>::transform(const T *in, ComplexT *out) const{
+  const T h2 = T(0.5);
+  size_t h, k;
+  ComplexT zk, zj, even, odd;
+
+  if(n < 2) return;
+  h = n/2;
+
+  // even samples go to the real part, odd samples to the imaginary part
+  for(k=0; k<h; k++){
+    out[k] = ComplexT(in[2*k], in[2*k+1]);
+  }
+
+  half.transform(out);
+
+  // dc and nyquist bins are both real
+  zk = out[0];
+  out[0] = ComplexT(zk.real() + zk.imag(), 0);
+  out[h] = ComplexT(zk.real() - zk.imag(), 0);
+
+  // bins k and h-k are built from the same pair of values, so both
+  // are untangled together and the work is done in place
+  for(k=1; k<=h/2; k++){
+    zk = out[k];
+    zj = out[h-k];
+    even = h2 * (zk + std::conj(zj));
+    // odd = (zk - conj(zj))/(2i)
+    odd = zk - std::conj(zj);
+    odd = ComplexT(h2 * odd.imag(), -h2 * odd.real());
+    odd *= twiddles[k];
+    out[k] = even + odd;
+    out[h-k] = std::conj(even - odd);
+  }
+}
+
+template <typename T>
+void BasicRealFFTPlan<T>::transformBatch(const T *in, ComplexT *out, size_t count) const{
+  for(size_t b=0; b<count; b++){
+    transform(in + b*n, out + b*(n/2+1));
+  }
+}
+
+// the analyzer may run in single or double precision.
+// both versions are built
+template class BasicFFTPlan<float>;
+template class BasicFFTPlan<double>;
+template class BasicRealFFTPlan<float>;
+template class BasicRealFFTPlan<double>;
+
+void fft(CArray& x){
+  FFTPlan plan(x.size());
+  plan.transform(x);
+}
+
+void rfft(const std::valarray<double>& x, CArray& y){
+  RealFFTPlan plan(x.size());
+  y.resize(x.size()/2+1);
+  plan.transform(&x[0], &y[0]);
 }
 
 // inverse fft (in-place)
@@ -4,6 +4,7 @@
 #include <complex>
 #include <iostream>
 #include <valarray>
+#include <vector>
 
 /**
  * @brief PI is just PI
@@ -13,12 +14,232 @@ const double PI = 3.141592653589793238460;
 typedef std::complex<double> Complex;
 typedef std::valarray<Complex> CArray;
 
+/**
+ * @brief SpectrumReal is the floating point type used by the spectrum analyzer
+ * @details It is double by default. Building with FFT_SINGLE_PRECISION
+ * defined (qmake CONFIG+=fft_float) switches the whole analysis pipeline,
+ * from the audio samples to the spectrum handed to the widgets, to float
+ */
+#ifdef FFT_SINGLE_PRECISION
+typedef float SpectrumReal;
+#else
+typedef double SpectrumReal;
+#endif
+
+typedef std::complex<SpectrumReal> SpectrumComplex;
+
+struct FFTKernels;
+
+/**
+ * @brief The BasicFFTPlan class holds everything a forward FFT of a given
+ * size needs, so the transform itself does not allocate memory or
+ * call trigonometric functions
+ * @details The plan stores the bit reversal permutation and the twiddle
+ * factors for its size. The transform is done in place: the input is
+ * permuted and then combined using radix-4 passes (plus one radix-2 pass
+ * when log2(size) is odd).
+ *
+ * Sizes that are not a power of two use Bluestein's algorithm: the
+ * transform is written as a convolution with a chirp, which is done with
+ * power of two transforms of at least 2*size-1 points. It costs about
+ * three of those, and the plan keeps a scratch buffer for them, so a plan
+ * of such a size must not transform from two threads at once.
+ *
+ * Plans are expensive to build and cheap to use. Create one for each
+ * transform size and keep it around.
+ *
+ * T is the floating point type of the data, float or double.
+ */
+template <typename T>
+class BasicFFTPlan{
+public:
+  typedef std::complex<T> ComplexT;
+
+  /**
+   * @brief Builds a plan for transforms of n points
+   * @param n is the transform size
+   */
+  explicit BasicFFTPlan(size_t n = 0);
+
+  /**
+   * @brief Rebuilds the plan for a new transform size
+   * @param n is the new transform size
+   */
+  void resize(size_t n);
+
+  /**
+   * @brief size returns the transform size of this plan
+   */
+  size_t size() const { return n; }
+
+  /**
+   * @brief transform calcs the forward FFT in place
+   * @param x points to size() complex values. The result is placed
+   * directly into x
+   */
+  void transform(ComplexT *x) const;
+
+  /**
+   * @brief transform calcs the forward FFT in place
+   * @param x is the array to be transformed. Its size must match size()
+   */
+  void transform(std::valarray<ComplexT> &x) const;
+
+  /**
+   * @brief setKernels chooses the butterfly kernels used by the plan
+   * @details By default the plan uses fftKernels(), the best set for the cpu
+   * @param kernels is the kernel set to be used
+   */
+  void setKernels(const FFTKernels &kernels);
+
+private:
+  /**
+   * @brief radixTransform runs the power of two transform of radixSize points
+   */
+  void radixTransform(ComplexT *x) const;
+
+  /**
+   * @brief n is the transform size
+   */
+  size_t n;
+
+  /**
+   * @brief radixSize is the size of the power of two transform: n itself,
+   * or the convolution size when Bluestein's algorithm is used
+   */
+  size_t radixSize;
+
+  /**
+   * @brief kernels points to the butterfly kernels
+   */
+  const FFTKernels *kernels;
+
+  /**
+   * @brief swaps stores the pairs of positions exchanged by the
+   * bit reversal permutation
+   */
+  std::vector<unsigned> swaps;
+
+  /**
+   * @brief twiddles stores the twiddle factors of every radix-4 pass,
+   * one pass after the other
+   */
+  std::vector<ComplexT> twiddles;
+
+  /**
+   * @brief chirp stores exp(-PI*i*k^2/n) for k in [0,n). It is empty
+   * when n is a power of two
+   */
+  std::vector<ComplexT> chirp;
+
+  /**
+   * @brief filter stores the transform of the conjugate chirp, divided
+   * by radixSize so the inverse transform needs no scaling
+   */
+  std::vector<ComplexT> filter;
+
+  /**
+   * @brief work is the convolution buffer
+   */
+  mutable std::vector<ComplexT> work;
+};
+
+/**
+ * @brief The BasicRealFFTPlan class calcs the forward FFT of real valued input
+ * @details Real input has a Hermitian spectrum, so only the first n/2+1
+ * bins carry information. The plan packs the n real values as n/2 complex
+ * values, runs a half size BasicFFTPlan on them and untangles the even and
+ * odd parts with one extra twiddle pass. It costs about half of a complex
+ * transform of the same size.
+ *
+ * T is the floating point type of the data, float or double.
+ */
+template <typename T>
+class BasicRealFFTPlan{
+public:
+  typedef std::complex<T> ComplexT;
+
+  /**
+   * @brief Builds a plan for transforms of n real points
+   * @param n is the transform size. It must be even, at least 2
+   */
+  explicit BasicRealFFTPlan(size_t n = 0);
+
+  /**
+   * @brief Rebuilds the plan for a new transform size
+   * @param n is the new transform size. It must be even, at least 2
+   */
+  void resize(size_t n);
+
+  /**
+   * @brief size returns the number of real input points of this plan
+   */
+  size_t size() const { return n; }
+
+  /**
+   * @brief transform calcs the forward FFT of real input
+   * @param in points to size() real values. It is not modified
+   * @param out points to size()/2+1 complex values that receive bins
+   * 0 to size()/2. The remaining bins are the complex conjugates of these
+   */
+  void transform(const T *in, ComplexT *out) const;
+
+  /**
+   * @brief transformBatch calcs the forward FFT of several real arrays
+   * with the same plan
+   * @details The arrays are transformed one after the other. Running the
+   * whole batch through each pass was tried: it saves nothing while the
+   * batch fits in cache and loses up to a fifth when it does not
+   * @param in points to count arrays of size() real values, one after the other
+   * @param out points to count arrays of size()/2+1 complex values, one
+   * after the other
+   * @param count is the number of arrays
+   */
+  void transformBatch(const T *in, ComplexT *out, size_t count) const;
+
+  /**
+   * @brief setKernels chooses the butterfly kernels used by the plan
+   * @param kernels is the kernel set to be used
+   */
+  void setKernels(const FFTKernels &kernels);
+
+private:
+  /**
+   * @brief n is the number of real input points
+   */
+  size_t n;
+
+  /**
+   * @brief half is the complex plan of size n/2
+   */
+  BasicFFTPlan<T> half;
+
+  /**
+   * @brief twiddles stores exp(-2*PI*i*k/n) for k in [0,n/4]
+   */
+  std::vector<ComplexT> twiddles;
+};
+
+typedef BasicFFTPlan<double> FFTPlan;
+typedef BasicRealFFTPlan<double> RealFFTPlan;
+
 /**
  * @brief fft calcs forward FFT transform
+ * @details This builds a new plan on every call. Code that transforms
+ * many arrays of the same size should keep a FFTPlan instead.
  * @param x is the array to be transformed. The result is placed directly
  * into x
  */
 
 void fft(CArray& x);
 
+/**
+ * @brief rfft calcs forward FFT transform of real input
+ * @details This builds a new plan on every call. Code that transforms
+ * many arrays of the same size should keep a RealFFTPlan instead.
+ * @param x is the real array to be transformed. Its size must be even
+ * @param y receives the x.size()/2+1 non redundant bins of the spectrum
+ */
+void rfft(const std::valarray<double>& x, CArray& y);
+
 #endif
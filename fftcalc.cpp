@@ -1,110 +1,293 @@
 #include "fftcalc.h"
+#include "simdkernels.h"
+#include "pcmconvert.h"
 
 #undef CLAMP
 #define CLAMP(a,min,max) ((a) < (min) ? (min) : (a) > (max) ? (max) : (a))
 
 // fftcalc class is designed to treat with fft calculations
 FFTCalc::FFTCalc(QObject *parent)
-  :QObject(parent){
+  :QObject(parent), ring(RINGSIZE){
+
+  // the probe writes into the ring and the processor reads from it.
+  // spectra go out through the frame store
+  processor.setInput(&ring);
+  processor.setOutput(&frames);
+  processor.setClock(&clock);
+  sampleRate = 0;
+  frameSize = DEFAULTFFTSIZE;
+  streams = 1;
+
+  // a sleeping widget is woken up through the gui thread
+  connect(&processor, SIGNAL(spectrumReady()),
+          this, SIGNAL(spectrumReady()));
 
   // fftcalc is done in other thread
   // so it cannot overload the main thread
   processor.moveToThread(&processorThread);
 
-  // qRegisterMetaType is used to register QVector<double> as the typename for QVector<double>
-  // it is necessary for signal/slots events treatment.
-  qRegisterMetaType< QVector<double> >("QVector<double>");
-
-  // when the spectrum is calculated, setSpectrum function will comunicate
-  // such spectrum to Qt as an emitted signal
-  connect(&processor, SIGNAL(calculatedSpectrum(QVector<double>)), SLOT(setSpectrum(QVector<double>)));
-
-  // when the processor finishes the calculation, the busy condition is changed.
-  connect(&processor, SIGNAL(allDone()),SLOT(freeCalc()));
-
   // start the processor thread with low priority
   processorThread.start(QThread::LowestPriority);
 
-  // initially, the processor is not occupied
-  isBusy = false;
+  // probed buffers are converted in another thread too. they
+  // get there through queued connections, as implicitly
+  // shared QAudioBuffers, so they are not copied
+  qRegisterMetaType<QAudioBuffer>();
+  qRegisterMetaType<LoudnessReading>();
+  converter.setCalculator(this);
+  connect(&converter, SIGNAL(levels(double,double)),
+          this, SIGNAL(levels(double,double)));
+  connect(&converter, SIGNAL(peaks(double,double)),
+          this, SIGNAL(peaks(double,double)));
+  connect(&converter, SIGNAL(loudness(LoudnessReading)),
+          this, SIGNAL(loudness(LoudnessReading)));
+  converter.moveToThread(&converterThread);
+  converterThread.start();
 }
 
 FFTCalc::~FFTCalc(){
+  // the converter goes first, as it feeds the processor
+  converterThread.quit();
+  converterThread.wait(10000);
+
   // tells the processor thread to quit
   processorThread.quit();
   // wait a bit until it finishes. I guess 10ms is enough!
   processorThread.wait(10000);
 }
 
-void FFTCalc::calc(QVector<double> &_array, int duration){
-  if(isBusy)
-    return;
+BufferConverter *FFTCalc::bufferConverter(){
+  return &converter;
+}
 
-  // processor is busy performing fft calculations...
-  isBusy = true;
+void FFTCalc::calc(const SpectrumReal *data, int frames, int _sampleRate,
+                  qint64 startTime, int _streams){
+  // sample rate changes are rare. only then an event is posted
+  if(_sampleRate != sampleRate){
+    sampleRate = _sampleRate;
+    QMetaObject::invokeMethod(&processor, "setSampleRate",
+                              Qt::QueuedConnection, Q_ARG(int, sampleRate));
+  }
+
+  // the processor is told where the new layout starts. it
+  // drops whatever is left of the old one up to there
+  if(_streams != streams){
+    streams = _streams;
+    QMetaObject::invokeMethod(&processor, "setStreams",
+                              Qt::QueuedConnection, Q_ARG(int, streams),
+                              Q_ARG(uint, ring.writePosition()));
+  }
+
+  // the samples go straight into the ring. no copy is queued
+  // and nothing is dropped unless the ring is full
+  ring.write(data, frames*streams, startTime, streams);
+
+  // the processor only needs an event when it went to sleep
+  if(ring.wakeup()){
+    QMetaObject::invokeMethod(&processor, "wake", Qt::QueuedConnection);
+  }
+}
+
+void FFTCalc::setFrameSize(int fftSize, int hopSize){
+  frameSize = CLAMP(fftSize, MINFFTSIZE, MAXFFTSIZE) & ~1;
+  QMetaObject::invokeMethod(&processor, "setFrameSize",
+                            Qt::QueuedConnection, Q_ARG(int, fftSize),
+                            Q_ARG(int, hopSize));
+}
+
+int FFTCalc::fftSize() const{
+  return frameSize;
+}
+
+void FFTCalc::setFftSize(int size){
+  setFrameSize(size, size/2);
+}
+
+void FFTCalc::setWindow(WindowType type, double parameter){
+  QMetaObject::invokeMethod(&processor, "setWindow",
+                            Qt::QueuedConnection, Q_ARG(int, int(type)),
+                            Q_ARG(double, parameter));
+}
+
+void FFTCalc::setApproximate(bool approximate){
+  QMetaObject::invokeMethod(&processor, "setApproximate",
+                            Qt::QueuedConnection, Q_ARG(bool, approximate));
+}
+
+void FFTCalc::setChannelMode(PcmChannelMode mode){
+  QMetaObject::invokeMethod(&converter, "setChannelMode",
+                            Qt::QueuedConnection, Q_ARG(int, int(mode)));
+}
+
+void FFTCalc::resetLoudness(){
+  QMetaObject::invokeMethod(&converter, "resetLoudness", Qt::QueuedConnection);
+}
+
+void FFTCalc::setRmsWindow(int ms){
+  QMetaObject::invokeMethod(&converter, "setRmsWindow",
+                            Qt::QueuedConnection, Q_ARG(int, ms));
+}
+
+void FFTCalc::setBands(int count, BandScale scale){
+  QMetaObject::invokeMethod(&processor, "setBands",
+                            Qt::QueuedConnection, Q_ARG(int, count),
+                            Q_ARG(int, int(scale)));
+}
 
-  // start the calcs...
-  QMetaObject::invokeMethod(&processor, "processBuffer",
-                            Qt::QueuedConnection, Q_ARG(QVector<double>, _array),
-                            Q_ARG(int, duration));
+int FFTCalc::droppedSamples() const{
+  return ring.droppedSamples();
 }
 
-void FFTCalc::setSpectrum(QVector<double> spectrum){
-  // tells Qt about that a new spectrum has arrived
-  emit calculatedSpectrum(spectrum);
+int FFTCalc::skippedSamples() const{
+  return ring.skippedSamples();
 }
 
-void FFTCalc::freeCalc()
-{
-  // fftcalc is ready for new spectrum calculations
-  isBusy = false;
+SpectrumFrameStore *FFTCalc::spectrumFrames(){
+  return &frames;
 }
+
+void FFTCalc::setPlaybackPosition(qint64 ms){
+  clock.setPosition(ms);
+}
+
+void FFTCalc::setPlaying(bool playing){
+  clock.setRunning(playing);
+
+  // a paused processor waits for the clock to run again
+  if(playing){
+    QMetaObject::invokeMethod(&processor, "wake", Qt::QueuedConnection);
+  }
+}
+
 /*
- * processes the buffer for fft calculation
+ * converts the probed buffers
  */
 
-BufferProcessor::BufferProcessor(QObject *parent){
+BufferConverter::BufferConverter(QObject *parent){
   // the pointer is not used here
   Q_UNUSED(parent);
+  calculator = 0;
 
-  // this timer is used to send the pieces of spectrum
-  // as they are calculated
-  timer = new QTimer(this);
+  // the spectrum is taken from the left channel
+  channelMode = PCM_LEFT;
+  sinceLoudness = 0;
+}
 
-  // call run() to send such pieces
-  connect(timer,SIGNAL(timeout()),this,SLOT(run()));
+void BufferConverter::setCalculator(FFTCalc *calc){
+  calculator = calc;
+}
 
-  // window functions are used to filter some undesired
-  // information for fft calculation.
-  window.resize(SPECSIZE);
+void BufferConverter::setChannelMode(int mode){
+  channelMode = mode >= 0 && mode < PCM_CHANNEL_MODES ? PcmChannelMode(mode) : PCM_LEFT;
+}
 
-  // the complex frame that is sent to fft function
-  complexFrame.resize(SPECSIZE);
+void BufferConverter::resetLoudness(){
+  meter.reset();
+}
 
-  // only half spectrum is used because of the simetry property
-  spectrum.resize(SPECSIZE/2);
+void BufferConverter::setRmsWindow(int ms){
+  meter.setRmsWindow(ms);
+}
 
-  // logscale is used for audio spectrum display
-  logscale.resize(SPECSIZE/2+1);
+void BufferConverter::processBuffer(QAudioBuffer buffer){
+  LoudnessReading reading;
+  const SpectrumReal *analyzed;
+  int streams, channels, right;
 
-  // by default, spectrum is log scaled (compressed)
-  compressed = true;
+  // the fft calculator keeps its own history, so even
+  // small buffers are useful
+  if(buffer.frameCount() == 0)
+    return;
 
-  // window function (HANN)
-  for(int i=0; i<SPECSIZE;i++){
-    window[i] = 0.5 * (1 - cos((2*PI*i)/(SPECSIZE)));
+  // every sample format and channel count the decoder may
+  // produce is converted to [-1,1] once. the meter takes
+  // every channel
+  channels = pcmStreams(PCM_ALL_CHANNELS, buffer.format().channelCount());
+  channelSamples.resize(buffer.frameCount()*channels);
+  if(!pcmConvertChannels(buffer.format(), buffer.constData(), buffer.frameCount(),
+                         channelSamples.data()))
+    return;
+  meter.configure(buffer.format().sampleRate(), channels);
+  meter.process(channelSamples.constData(), buffer.frameCount());
+
+  // mid and side are made here too, from the converted
+  // channels, so the processor only sees streams
+  streams = pcmStreams(channelMode, channels);
+  analyzed = channelSamples.constData();
+  if(channelMode != PCM_ALL_CHANNELS){
+    sample.resize(buffer.frameCount()*streams);
+    pcmSelectStreams(channelSamples.constData(), buffer.frameCount(), channels,
+                     channelMode, sample.data());
+    analyzed = sample.constData();
   }
 
-  // the log scale
-  for(int i=0; i<=SPECSIZE/2; i++){
-    logscale[i] = powf (SPECSIZE/2, (float) 2*i / SPECSIZE) - 0.5f;
+  // the samples go to the fft thread
+  calculator->calc(analyzed, buffer.frameCount(),
+                   buffer.format().sampleRate(), buffer.startTime(), streams);
+
+  // left and right levels. mono streams show the same on both
+  reading = meter.reading();
+  right = reading.channels > 1 ? 1 : 0;
+  emit levels(meterPosition(reading.rms[0]), meterPosition(reading.rms[right]));
+  emit peaks(meterPosition(reading.truePeak[0]), meterPosition(reading.truePeak[right]));
+
+  // the loudness moves slowly. nobody reads it
+  // faster than ten times per second
+  sinceLoudness += buffer.frameCount();
+  if(sinceLoudness >= buffer.format().sampleRate()/10){
+    sinceLoudness = 0;
+    emit loudness(reading);
   }
+}
+
+/*
+ * processes the buffer for fft calculation
+ */
+
+BufferProcessor::BufferProcessor(QObject *parent){
+  // the pointer is not used here
+  Q_UNUSED(parent);
+
+  // this timer fires once, when the next frame is due
+  timer = new QTimer(this);
+  timer->setTimerType(Qt::PreciseTimer);
+  timer->setSingleShot(true);
+
+  // call run() to send such pieces
+  connect(timer,SIGNAL(timeout()),this,SLOT(run()));
+
+  // by default, spectrum is log scaled (compressed), with
+  // the approximate log
+  compressed = true;
+  approximate = true;
 
   // nothing is running yet
   running = false;
 
-  // process buffer each 100ms (initially, of course)
-  timer->start(100);
+  // no input or output yet
+  input = 0;
+  output = 0;
+  clock = 0;
+  timed = false;
+  fftSize = 0;
+  sampleRate = 44100;
+  plan = 0;
+
+  // a single stream until the converter says otherwise
+  streams = 1;
+  streamStart = 0;
+  realign = false;
+
+  // frames are multiplied by a hann window by default
+  windowFunction = WINDOW_HANN;
+  windowParameter = 0;
+
+  // the display bands follow the classic log scale
+  bandCount = NUMBANDS;
+  bandScale = SCALE_LOG;
+
+  // frames overlap by 50% by default
+  setFrameSize(DEFAULTFFTSIZE, DEFAULTFFTSIZE/2);
 }
 
 BufferProcessor::~BufferProcessor(){
@@ -112,108 +295,301 @@ BufferProcessor::~BufferProcessor(){
 
 }
 
-void BufferProcessor::processBuffer(QVector<double> _array, int duration){
-  // if the music is new, array size may change
-  if(array.size() != _array.size()){
-    //array is splitted into a set of small chuncks
-    chunks = _array.size()/SPECSIZE;
+void BufferProcessor::setFrameSize(int _fftSize, int _hopSize){
+  // the real fft packs pairs of samples, so the size is even
+  fftSize = CLAMP(_fftSize, MINFFTSIZE, MAXFFTSIZE) & ~1;
+  hopSize = CLAMP(_hopSize, 1, fftSize);
 
-    // resize the array to the new array size
-    array.resize(_array.size());
+  resizeFrames();
+
+  // the fft plan is built once per size. sizes used
+  // before are taken from the cache
+  if(planOrder.removeOne(fftSize)){
+    planOrder.append(fftSize);
+  }
+  else{
+    // forget the least recently used sizes when there are too many
+    while(planOrder.size() >= PLANCACHE)
+      plans.remove(planOrder.takeFirst());
+    planOrder.append(fftSize);
+    plans[fftSize].plan.resize(fftSize);
   }
-  // interval of notification depends on the duration of the sample
-  interval = duration/chunks;
+  plan = &plans[fftSize].plan;
 
-  // copy the array
-  array = _array;
+  // window functions are used to filter some undesired
+  // information for fft calculation. the cached plan
+  // keeps its window, so it is found again here
+  window = windowTable(windowFunction, fftSize, windowParameter);
+  plans[fftSize].window = window;
 
-  // count the number of fft calculations until the chunk size
-  // is reached
-  pass = 0;
+  // the bands depend on the number of bins
+  configureBands();
 
-  // it cannot be so small
-  if(interval < 1)
-    interval = 1;
+  // a new hop size changes the deadlines
+  if(timer->isActive())
+    timer->start(0);
+}
+
+void BufferProcessor::resizeFrames(){
+  // the windowed real frames that are sent to fft
+  // function, one block for each stream
+  frame.resize(fftSize*streams);
 
-  // redefines the timer interval
-  timer->start(interval);
+  // the input is real, so fft only returns the
+  // fftSize/2+1 non redundant bins
+  complexFrame.resize((fftSize/2+1)*streams);
+
+  // only half spectrum is used because of the simetry property.
+  // the streams take turns with it
+  magnitude.resize(fftSize/2);
 }
 
-void BufferProcessor::run(){
-  // spectrum amplitude
-  qreal amplitude;
-  qreal SpectrumAnalyserMultiplier = 1e-2;
+void BufferProcessor::setStreams(int count, uint position){
+  streams = CLAMP(count, 1, PCM_MAX_CHANNELS);
+  streamStart = position;
+  realign = true;
+  resizeFrames();
+  if(timer->isActive())
+    timer->start(0);
+}
 
-  // tells when all chunks has been processed
-  if(pass == chunks){
-    emit allDone();
-    return;
+// drops the samples written before the stream layout changed.
+// when some of the new ones were already read with the old
+// layout, it skips to the next whole frame of streams
+bool BufferProcessor::align(){
+  int ahead, behind;
+
+  ahead = int(streamStart - input->readPosition());
+  if(ahead < 0){
+    behind = -ahead;
+    ahead = (streams - behind % streams) % streams;
   }
+  if(input->available() < ahead)
+    return false;
+  input->skip(ahead);
+  realign = false;
+  return true;
+}
+
+void BufferProcessor::setWindow(int type, double parameter){
+  windowFunction = type >= 0 && type < WINDOW_TYPES ? WindowType(type) : WINDOW_HANN;
+  windowParameter = parameter;
+  window = windowTable(windowFunction, fftSize, windowParameter);
+
+  // the windows kept for the other sizes are not used any
+  // more. they are made again when those sizes come back
+  for(QMap<int, CachedPlan>::iterator it = plans.begin(); it != plans.end(); ++it)
+    it.value().window.clear();
+  if(plans.contains(fftSize))
+    plans[fftSize].window = window;
+}
+
+void BufferProcessor::setApproximate(bool _approximate){
+  approximate = _approximate;
+}
+
+void BufferProcessor::setBands(int count, int scale){
+  bandCount = CLAMP(count, 1, 4096);
+  bandScale = scale >= 0 && scale < SCALE_COUNT ? BandScale(scale) : SCALE_LOG;
+  configureBands();
+}
+
+void BufferProcessor::configureBands(){
+  // the weights of every band are computed here, once, so
+  // each frame only runs the sparse product
+  bandMapper.configure(fftSize/2, sampleRate, bandCount, bandScale);
+  bandValues.resize(bandMapper.bands());
+}
+
+void BufferProcessor::setInput(PcmRingBuffer *ring){
+  input = ring;
+}
+
+void BufferProcessor::setOutput(SpectrumFrameStore *store){
+  output = store;
+}
+
+void BufferProcessor::setClock(const PlaybackClock *playbackClock){
+  clock = playbackClock;
+}
 
-  // we does not calc spectra when array is too small
-  if(array.size() < SPECSIZE){
+int BufferProcessor::frameInterval() const{
+  // without timestamps, frames are sent once every
+  // hopSize samples of audio
+  return qMax(1, qRound(1000.0*hopSize/sampleRate));
+}
+
+void BufferProcessor::setSampleRate(int _sampleRate){
+  if(_sampleRate <= 0)
     return;
-  }
+  sampleRate = _sampleRate;
+
+  // the perceptual scales place their bands in hertz
+  if(bandScale != SCALE_LOG && bandScale != SCALE_LINEAR)
+    configureBands();
+  if(timer->isActive())
+    timer->start(0);
+}
 
-  // prepare complex frame for fft calculations
-  for(uint i=0; i<SPECSIZE; i++){
-    complexFrame[i] = Complex(window[i]*array[i+pass*SPECSIZE],0);
+void BufferProcessor::wake(){
+  // new samples arrived while the processor was sleeping,
+  // or the playback was resumed
+  if(!timer->isActive())
+    timer->start(0);
+}
+
+// tells how many milliseconds are left until the frame at the
+// read position is heard. frames that are already late are
+// skipped, so the one being heard now is the one analyzed
+int BufferProcessor::nextDeadline(){
+  qint64 start, lead;
+  int pending, late;
+
+  // the old stream layout is dropped first
+  if(realign && !align())
+    return NO_FRAME;
+
+  // nothing to do until a whole frame is in the ring. from
+  // here on, everything is counted in samples of each stream
+  pending = input->available()/streams;
+  if(pending < fftSize)
+    return NO_FRAME;
+
+  // if the analysis fell too far behind the audio,
+  // skip to the most recent frame
+  if(pending*streams > input->capacity()/2){
+    input->skip((pending - fftSize)*streams);
+    pending = fftSize;
   }
 
-  // do the magic
-  fft(complexFrame);
+  // without a clock or timestamps there is no deadline.
+  // the ring position advances streams times faster
+  start = input->readTimestamp(sampleRate*streams);
+  timed = clock && start >= 0;
+  if(!timed)
+    return 0;
+
+  // the frame is heard when its center is
+  lead = start + qint64(fftSize/2)*1000000/sampleRate - clock->position();
+
+  // the player went back in the media: the buffered
+  // audio will not be heard soon, if ever
+  if(lead > MAXLEAD && pending > fftSize){
+    input->skip((pending - fftSize)*streams);
+    pending = fftSize;
+    lead = input->readTimestamp(sampleRate*streams) + qint64(fftSize/2)*1000000/sampleRate
+        - clock->position();
+  }
+  if(lead > MAXLEAD){
+    return clock->isRunning() ? int(MAXLEAD/1000) : PAUSED;
+  }
 
-  // some scaling/windowing is needed for displaying the fourier spectrum somewhere
-  for(uint i=0; i<SPECSIZE/2;i++){
-    amplitude = SpectrumAnalyserMultiplier*std::abs(complexFrame[i]);
-    amplitude = qMax(qreal(0.0), amplitude);
-    amplitude = qMin(qreal(1.0), amplitude);
-    complexFrame[i] = amplitude;
+  // the frame is not heard yet
+  if(lead > 0){
+    if(!clock->isRunning())
+      return PAUSED;
+    return int((lead + 999)/1000);
   }
 
-  // audio spectrum is usually compressed for better displaying
-  if(compressed){
-    for (int i = 0; i <SPECSIZE/2; i ++){
-      /* sum up values in freq array between logscale[i] and logscale[i + 1],
-         including fractional parts */
-      int a = ceilf (logscale[i]);
-      int b = floorf (logscale[i+1]);
-      float sum = 0;
-
-      if (b < a)
-        sum += complexFrame[b].real()*(logscale[i+1]-logscale[i]);
-      else{
-        if (a > 0)
-          sum += complexFrame[a-1].real()*(a-logscale[i]);
-        for (; a < b; a++)
-          sum += complexFrame[a].real();
-        if (b < SPECSIZE/2)
-          sum += complexFrame[b].real()*(logscale[i+1] - b);
-      }
-
-      /* fudge factor to make the graph have the same overall height as a
-         12-band one no matter how many bands there are */
-      sum *= (float) SPECSIZE/24;
-
-      /* convert to dB */
-      float val = 20*log10f (sum);
-
-      /* scale (-DB_RANGE, 0.0) to (0.0, 1.0) */
-      val = 1 + val / 40;
-      spectrum[i] = CLAMP (val, 0, 1);
-    }
+  // the frame is late. skip whole hops, as long as a
+  // complete frame is left in the ring
+  late = int(-lead*sampleRate/1000000);
+  late = qMin(late, pending - fftSize)/hopSize*hopSize;
+  if(late > 0)
+    input->skip(late*streams);
+  return 0;
+}
+
+void BufferProcessor::schedule(int wait){
+  if(wait == NO_FRAME){
+    // the processor sleeps until the producer wakes it up
+    timer->stop();
+    if(!input->sleep(fftSize*streams))
+      timer->start(0);
+  }
+  else if(wait == PAUSED){
+    // the processor sleeps until the playback is resumed
+    timer->stop();
   }
   else{
-    // if not compressed, just copy the real part clamped between 0 and 1
-    for(int i=0; i<SPECSIZE/2; i++){
-      spectrum[i] = CLAMP(complexFrame[i].real()*100,0,1);
-    }
+    timer->start(wait);
+  }
+}
+
+void BufferProcessor::run(){
+  int wait;
+
+  // the frame is analyzed only when it is due
+  wait = nextDeadline();
+  if(wait == 0){
+    analyze();
+
+    // without deadlines, frames are paced by the hop size
+    wait = nextDeadline();
+    if(wait == 0 && !timed)
+      wait = frameInterval();
+  }
+  schedule(wait);
+}
+
+void BufferProcessor::analyze(){
+  qreal SpectrumAnalyserMultiplier = 1e-2;
+  SpectrumReal *spectrum, scale;
+  int bands;
+
+  // the windowed frame of each stream is read from the
+  // ring in a single pass
+  input->peekStreams(frame.data(), fftSize, streams, window->coefficients.constData());
+
+  // do the magic. every stream goes through the same plan
+  plan->transformBatch(frame.constData(), &complexFrame[0], streams);
+
+  // some scaling/windowing is needed for displaying the fourier spectrum somewhere.
+  // the multiplier was tuned for the hann window (coherent gain 1/2).
+  // it is corrected so a tone reads the same height with any window
+  scale = SpectrumReal(SpectrumAnalyserMultiplier*0.5*window->amplitudeCorrection());
+
+  // the spectra are written straight into the frame store,
+  // one after the other
+  bands = bandValues.size();
+  spectrum = output->beginWrite(bands*streams, streams);
+  for(int s=0; s<streams; s++){
+    scaleBands(&complexFrame[s*(fftSize/2+1)], spectrum + s*bands, scale);
   }
-  // emit the spectrum
-  emit calculatedSpectrum(spectrum);
 
-  // count the pass
-  pass++;
+  // hand the spectrum to the widget thread. it is only
+  // told about it when it stopped polling
+  if(output->publish())
+    emit spectrumReady();
+
+  // the next frame starts one hop later
+  input->consume(hopSize*streams);
 }
 
+// folds the bins of one stream into the display bands
+void BufferProcessor::scaleBands(const SpectrumComplex *bins, SpectrumReal *spectrum,
+                                 SpectrumReal scale){
+  int bands;
+
+  bands = bandValues.size();
 
+  // magnitudes are scaled and clamped to [0,1] by the vector kernel,
+  // then folded into the display bands. audio spectrum is usually
+  // compressed (shown in decibels) for better displaying
+  magnitudes(fftKernels(), bins, magnitude.data(), fftSize/2, scale);
+  if(compressed){
+    bandMapper.applyCompressed(magnitude.constData(), spectrum, approximate);
+  }
+  else{
+    // if not compressed, the magnitudes each band overlaps are
+    // summed, weighted by the overlap, times the bands per bin
+    // and a gain of 100, then clamped between 0 and 1. that is
+    // the mean magnitude of the band on the linear scale only,
+    // where every band spans the same bins. the wider bands of
+    // the other scales add up more bins and read higher
+    bandMapper.apply(magnitude.constData(), bandValues.data());
+    for(int i=0; i<bands; i++){
+      spectrum[i] = CLAMP(bandValues[i]*100*bands/(fftSize/2),0,1);
+    }
+  }
+}
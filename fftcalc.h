@@ -8,53 +8,237 @@
 #include <QDebug>
 #include <QTimer>
 #include <QObject>
+#include <QMap>
+#include <QAudioBuffer>
 #include "fft.h"
+#include "pcmringbuffer.h"
+#include "spectrumframestore.h"
+#include "playbackclock.h"
+#include "bandmapper.h"
+#include "windowfunction.h"
+#include "pcmconvert.h"
+#include "loudnessmeter.h"
 
-// the size of fft array that is dispatched to
-// mainwindow
-#define SPECSIZE 512
+// the fft sizes the analyzer accepts, and the one it starts
+// with. sizes that are not a power of two cost a few times more
+#define MINFFTSIZE 256
+#define MAXFFTSIZE 16384
+#define DEFAULTFFTSIZE 512
 
+// plans of this many fft sizes are kept, so going back
+// to a recent size builds nothing. the least recently
+// used one is forgotten first
+#define PLANCACHE 4
+
+// the spectrum is folded into this many bands by default
+#define NUMBANDS 256
+
+// number of pcm samples buffered between the audio
+// probe and the fft thread. the streams of a frame are
+// interleaved there, so it must hold a few of the largest
+// frames of PCM_MAX_CHANNELS streams
+#define RINGSIZE 524288
+
+// frames that would be heard further than this (in microseconds)
+// ahead of the player do not belong to what is playing now
+// (the player was seeked backwards), so they are skipped
+#define MAXLEAD 2000000
+
+// bufferprocessor runs a short-time fourier transform over the
+// audio stream. it reads pcm from a lock-free ring buffer fed by
+// the audio probe, and analyzes a frame of fftSize samples every
+// hopSize samples, no matter how big the incoming buffers are.
+// each frame is released when its center is being heard, as told
+// by the playback clock. between frames the processor waits on a
+// single shot timer, and it sleeps when there is nothing to wait for.
+// the ring may carry several interleaved streams (channels, or mid
+// and side). each one gets its spectrum, all with the same plan
 class BufferProcessor: public QObject
 {
     Q_OBJECT
-  QVector<double> array;
-  QVector<double> window;
-  QVector<double> spectrum;
-  QVector<double> logscale;
+  PcmRingBuffer *input;
+  SpectrumFrameStore *output;
+  const PlaybackClock *clock;
+  QVector<SpectrumReal> frame;
+  QVector<SpectrumReal> magnitude;
+  QVector<SpectrumReal> bandValues;
+  BandMapper bandMapper;
   QTimer *timer;
-  bool compressed, running, iscalc;
-  int chunks, interval, pass;
-  CArray complexFrame;
+  bool compressed, approximate, running, iscalc, timed;
+  int fftSize, hopSize, sampleRate, bandCount;
+  // the number of interleaved streams. when it changes, the
+  // samples before streamStart still have the old layout
+  int streams;
+  quint32 streamStart;
+  bool realign;
+  BandScale bandScale;
+  std::vector<SpectrumComplex> complexFrame;
+  // a plan of a recently used size, and the window of that
+  // size. windows are only cached weakly by windowTable(),
+  // the reference here keeps it alive along with the plan
+  struct CachedPlan{
+    BasicRealFFTPlan<SpectrumReal> plan;
+    QSharedPointer<const WindowTable> window;
+  };
+  // plans of the recently used sizes, and the sizes from the
+  // least to the most recently used. plan points into them
+  QMap<int, CachedPlan> plans;
+  QList<int> planOrder;
+  const BasicRealFFTPlan<SpectrumReal> *plan;
+  // the window table is shared with anyone using the same one
+  QSharedPointer<const WindowTable> window;
+  WindowType windowFunction;
+  double windowParameter;
+  int frameInterval() const;
+  // return values of nextDeadline() other than a wait time
+  enum { NO_FRAME = -1, PAUSED = -2 };
+  int nextDeadline();
+  void analyze();
+  void schedule(int wait);
+  void configureBands();
+  void resizeFrames();
+  bool align();
+  void scaleBands(const SpectrumComplex *bins, SpectrumReal *spectrum, SpectrumReal scale);
 public slots:
-    void processBuffer(QVector<double> _array, int duration);
-signals:
-    void calculatedSpectrum(QVector<double> spectrum);
-    void allDone(void);
+    void wake();
+    void setSampleRate(int _sampleRate);
+    void setFrameSize(int _fftSize, int _hopSize);
+    void setBands(int count, int scale);
+    void setWindow(int type, double parameter);
+    void setApproximate(bool _approximate);
+    // the ring carries count streams from the free running
+    // write position on
+    void setStreams(int count, uint position);
 protected slots:
     void run();
+signals:
+    // a spectrum was published while the reader was sleeping
+    void spectrumReady();
 public:
     explicit BufferProcessor(QObject *parent=0);
     ~BufferProcessor();
-    void calc(QVector<double> &_array, int duration);
+    // the ring buffer the samples are read from
+    void setInput(PcmRingBuffer *ring);
+    // the store the spectra are published to
+    void setOutput(SpectrumFrameStore *store);
+    // the clock that tells what is being heard. without it
+    // (or without timestamps) frames are paced by the hop size
+    void setClock(const PlaybackClock *playbackClock);
+};
+
+class FFTCalc;
+
+// bufferconverter turns the buffers probed from the player into
+// the analyzed streams and the channel levels, and feeds them to
+// the calculator. it runs in a thread of its own, so big decoded
+// buffers never stall the widgets. every sample also goes through
+// the loudness meter here: the processor may skip frames, the
+// meter must not
+class BufferConverter: public QObject
+{
+    Q_OBJECT
+  FFTCalc *calculator;
+  QVector<SpectrumReal> sample, channelSamples;
+  PcmChannelMode channelMode;
+  LoudnessMeter meter;
+  int sinceLoudness;
+public slots:
+    void processBuffer(QAudioBuffer buffer);
+    // which streams are taken from the channels (a PcmChannelMode)
+    void setChannelMode(int mode);
+    // the integrated loudness and the largest peak start over
+    void resetLoudness();
+    // the time the rms levels are taken over, in milliseconds
+    void setRmsWindow(int ms);
+signals:
+    // tells where the left and right rms levels of each
+    // buffer are on the level bars, within [0,1]
+    void levels(double left, double right);
+    // the same for the left and right true peaks
+    void peaks(double left, double right);
+    // everything the meter knows, ten times per second
+    void loudness(LoudnessReading reading);
+public:
+    explicit BufferConverter(QObject *parent=0);
+    // the calculator the samples are handed to
+    void setCalculator(FFTCalc *calc);
 };
 
 // fftcalc runs in a separate thread
 class FFTCalc : public QObject{
     Q_OBJECT
 private:
-  bool isBusy;
+  PcmRingBuffer ring;
+  SpectrumFrameStore frames;
+  PlaybackClock clock;
+  int sampleRate, frameSize, streams;
   BufferProcessor processor;
   QThread processorThread;
+  BufferConverter converter;
+  QThread converterThread;
 
 public:
   explicit FFTCalc(QObject *parent = 0);
   ~FFTCalc();
-  void calc(QVector<double> &_array, int duration);
-public slots:
-  void setSpectrum(QVector<double> spectrum);
-  void freeCalc();
+  // the converter thread takes the probed buffers. connect
+  // the probe to it with a queued connection
+  BufferConverter *bufferConverter();
+  // queues pcm samples for analysis. it never blocks and must
+  // always be called from the same thread (the converter's). startTime is the media
+  // time of the first sample in microseconds (-1 if unknown). data holds
+  // frames samples of each of the interleaved streams
+  void calc(const SpectrumReal *data, int frames, int sampleRate,
+            qint64 startTime = -1, int streams = 1);
+  // fftSize is rounded to an even number within
+  // [MINFFTSIZE,MAXFFTSIZE]. hopSize is the distance between
+  // frames: fftSize/2 gives 50% overlap, fftSize/4 75%
+  void setFrameSize(int fftSize, int hopSize);
+  // the size of the analyzed frames, in samples
+  int fftSize() const;
+  // the spectrum is folded into count bands spaced by
+  // scale (a BandScale). the widgets follow the new count
+  void setBands(int count, BandScale scale);
+  // the window function frames are multiplied by. parameter
+  // shapes kaiser and gaussian windows (0 for the default)
+  void setWindow(WindowType type, double parameter = 0);
+  // the compressed spectrum is turned into decibels with a
+  // vector log (error below 0.001 dB) instead of calling
+  // log10 for every band
+  void setApproximate(bool approximate);
+  // the channels analyzed. modes with several streams publish
+  // one spectrum for each, one after the other in the frame
+  void setChannelMode(PcmChannelMode mode);
+  // see BufferConverter
+  void resetLoudness();
+  void setRmsWindow(int ms);
+  // samples lost because the ring was full, and samples
+  // skipped because the analysis fell behind the audio
+  int droppedSamples() const;
+  int skippedSamples() const;
+  // the processor publishes every spectrum here. the widget
+  // thread reads the newest one whenever it wants
+  SpectrumFrameStore *spectrumFrames();
+
 signals:
-  void calculatedSpectrum(QVector<double> spectrum);
+  // left and right rms levels and true peaks, as positions on
+  // the level bars, and the loudness readings. they are
+  // delivered in the thread fftcalc lives in
+  void levels(double left, double right);
+  void peaks(double left, double right);
+  void loudness(LoudnessReading reading);
+  // the widget went to sleep and a new spectrum is waiting
+  // in the frame store
+  void spectrumReady();
+
+public slots:
+  // the player reports what is being heard, so the
+  // spectra are shown in sync with the audio
+  void setPlaybackPosition(qint64 ms);
+  void setPlaying(bool playing);
+  // changes the fft size while running, keeping the frames
+  // 50% overlapped. bigger sizes resolve finer frequencies,
+  // smaller ones follow the music more closely
+  void setFftSize(int size);
 };
 
 #endif // FFTCALC_H
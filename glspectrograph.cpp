@@ -0,0 +1,309 @@
+#include "glspectrograph.h"
+#include <QVBoxLayout>
+#include <QShowEvent>
+#include <QHideEvent>
+#include <QTimerEvent>
+#include <QVector2D>
+
+// same look and pace as the raster spectrograph
+#define FRAME_INTERVAL 16
+#define GRAVITY 4444.0f
+#define LEVEL_DECAY 66.7f
+
+// band ages are stored up to this many seconds. by then
+// any bar has fallen all the way down
+#define MAX_AGE 2.0f
+
+// the quad covers the whole viewport. position goes from
+// (0,0) at the bottom left corner to (1,1) at the top right one
+static const char *vertexShader =
+    "attribute highp vec2 vertex;\n"
+    "varying highp vec2 position;\n"
+    "void main(){\n"
+    "  position = vertex*0.5 + 0.5;\n"
+    "  gl_Position = vec4(vertex, 0.0, 1.0);\n"
+    "}\n";
+
+// everything the raster spectrograph draws, decided per pixel
+static const char *fragmentShader =
+    "uniform sampler2D bands;\n"
+    "uniform highp float bandCount;\n"
+    "uniform highp float elapsed;\n"
+    "uniform highp float gravity;\n"
+    "uniform highp float maxAge;\n"
+    "uniform highp vec2 size;\n"
+    "uniform highp vec2 levels;\n"
+    "varying highp vec2 position;\n"
+    "void main(){\n"
+    "  highp vec2 pixel = position*size;\n"
+    "  highp float mid = 0.5*size.x;\n"
+    // level meters: a black strip at the bottom, the left one in
+    // red growing to the left, the right one in blue to the right
+    "  if(pixel.y < 7.0){\n"
+    "    lowp vec4 color = vec4(0.0, 0.0, 0.0, 1.0);\n"
+    "    if(pixel.y < 6.0 && pixel.x < mid && pixel.x >= mid - levels.x)\n"
+    "      color = vec4(1.0, 0.0, 0.0, 1.0);\n"
+    "    if(pixel.y < 6.0 && pixel.x >= mid && pixel.x < mid + levels.y)\n"
+    "      color = vec4(0.0, 0.0, 1.0, 1.0);\n"
+    "    gl_FragColor = color;\n"
+    "    return;\n"
+    "  }\n"
+    // peak and age of the band, 16 bits each
+    "  highp float band = position.x*bandCount;\n"
+    "  highp vec4 texel = texture2D(bands, vec2((floor(band) + 0.5)/bandCount, 0.5));\n"
+    "  highp float peak = dot(texel.rg, vec2(65280.0, 255.0))/65535.0;\n"
+    "  highp float age = dot(texel.ba, vec2(65280.0, 255.0))/65535.0*maxAge + elapsed;\n"
+    "  highp float height = max(peak - 0.5*gravity*age*age, 0.0);\n"
+    // one pixel between bars, when they are wide enough
+    "  highp float barWidth = size.x/bandCount;\n"
+    "  highp float gap = barWidth > 2.0 ? 1.0 : 0.0;\n"
+    "  if(abs(position.y - 0.5) < 0.5*height && fract(band)*barWidth < barWidth - gap)\n"
+    "    gl_FragColor = mix(vec4(0.0, 0.0, 1.0, 1.0), vec4(1.0, 0.0, 0.0, 1.0), position.y);\n"
+    "  else\n"
+    "    gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);\n"
+    "}\n";
+
+/*
+ * the opengl view
+ */
+
+GLSpectrumView::GLSpectrumView(QWidget *parent) :
+  QOpenGLWidget(parent), quad(QOpenGLBuffer::VertexBuffer){
+  texture = 0;
+  bandsChanged = false;
+  elapsed = gravity = 0;
+  leftLevel = rightLevel = 0;
+}
+
+GLSpectrumView::~GLSpectrumView(){
+  // gl objects are released with their context current
+  makeCurrent();
+  if(texture)
+    glDeleteTextures(1, &texture);
+  quad.destroy();
+  doneCurrent();
+}
+
+void GLSpectrumView::setBands(const QVector<uchar> &texels){
+  bands = texels;
+  bandsChanged = true;
+}
+
+void GLSpectrumView::setFrame(float _elapsed, float _gravity, float left, float right){
+  elapsed = _elapsed;
+  gravity = _gravity;
+  leftLevel = left;
+  rightLevel = right;
+}
+
+void GLSpectrumView::initializeGL(){
+  static const GLfloat vertices[] = { -1, -1,  1, -1,  -1, 1,  1, 1 };
+
+  initializeOpenGLFunctions();
+
+  program.addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader);
+  program.addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader);
+  program.bindAttributeLocation("vertex", 0);
+  program.link();
+
+  quad.create();
+  quad.bind();
+  quad.allocate(vertices, sizeof(vertices));
+  quad.release();
+
+  // one texel per band. no filtering: each bar has a flat top
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  // the texture gets its size on the first upload
+  bandsChanged = true;
+}
+
+void GLSpectrumView::paintGL(){
+  int count = bands.size()/4;
+
+  if(count == 0){
+    glClearColor(0, 0, 0, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    return;
+  }
+
+  // the only upload: one texel per band, when a new spectrum arrived
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  if(bandsChanged){
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, count, 1, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, bands.constData());
+    bandsChanged = false;
+  }
+
+  program.bind();
+  program.setUniformValue("bands", 0);
+  program.setUniformValue("bandCount", GLfloat(count));
+  program.setUniformValue("elapsed", elapsed);
+  program.setUniformValue("gravity", gravity);
+  program.setUniformValue("maxAge", MAX_AGE);
+  program.setUniformValue("size", QVector2D(width(), height()));
+  program.setUniformValue("levels", QVector2D(leftLevel, rightLevel));
+
+  quad.bind();
+  program.enableAttributeArray(0);
+  program.setAttributeBuffer(0, GL_FLOAT, 0, 2);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  program.disableAttributeArray(0);
+  quad.release();
+  program.release();
+}
+
+/*
+ * the spectrograph
+ */
+
+GLSpectrograph::GLSpectrograph(QWidget *parent) :
+  AbstractSpectrograph(parent){
+  QVBoxLayout *layout;
+
+  // the number of bands follows the analyzer
+  NUM_BANDS = 0;
+  texelTime = 0;
+
+  leftLevel = rightLevel = 0;
+
+  // the frame timer starts when the widget is shown
+  timerId = 0;
+  clock.start();
+  lastFrame = 0;
+
+  // the view fills the whole widget
+  view = new GLSpectrumView(this);
+  setBandCount(256);
+  layout = new QVBoxLayout(this);
+  layout->setContentsMargins(0, 0, 0, 0);
+  layout->addWidget(view);
+}
+
+float GLSpectrograph::bandHeight(int band, qint64 now) const{
+  float g, age;
+  g = GRAVITY/qMax(1, height());
+  age = seconds(now - peakTime[band]);
+  return qMax(0.0f, peak[band] - 0.5f*g*age*age);
+}
+
+void GLSpectrograph::setBandCount(int count){
+  // every band starts at the bottom
+  NUM_BANDS = count;
+  peak.fill(0, NUM_BANDS);
+  peakTime.fill(0, NUM_BANDS);
+  texels.fill(0, 4*NUM_BANDS);
+  view->setBands(texels);
+}
+
+void GLSpectrograph::loadSamples(QVector<SpectrumReal> &_spectrum){
+  int p, age;
+  qint64 now;
+  float value;
+
+  if(_spectrum.isEmpty())
+    return;
+  if(_spectrum.size() != NUM_BANDS)
+    setBandCount(_spectrum.size());
+
+  // a band only jumps up. the shader takes care of the fall
+  now = clock.nsecsElapsed();
+  for(int i=0; i<NUM_BANDS; i++){
+    value = _spectrum[i];
+    if(value > bandHeight(i, now)){
+      peak[i] = value;
+      peakTime[i] = now;
+    }
+  }
+
+  // peak and age of every band, as 16 bit fixed point
+  texelTime = now;
+  for(int i=0; i<NUM_BANDS; i++){
+    p = qBound(0, qRound(peak[i]*65535), 65535);
+    age = qRound(qMin(seconds(now - peakTime[i]), MAX_AGE)/MAX_AGE*65535);
+    texels[4*i] = p >> 8;
+    texels[4*i+1] = p & 0xFF;
+    texels[4*i+2] = age >> 8;
+    texels[4*i+3] = age & 0xFF;
+  }
+  view->setBands(texels);
+}
+
+void GLSpectrograph::loadLevels(double left, double right){
+  // same scale as the raster spectrograph
+  if(leftLevel < width()/2*left)
+    leftLevel = width()/2*left;
+  if(rightLevel < width()/2*right)
+    rightLevel = width()/2*right;
+
+  if(leftLevel > 0 || rightLevel > 0)
+    startAnimation();
+}
+
+void GLSpectrograph::spectrumReady(){
+  startAnimation();
+}
+
+void GLSpectrograph::showEvent(QShowEvent *e){
+  Q_UNUSED(e);
+  startAnimation();
+}
+
+void GLSpectrograph::hideEvent(QHideEvent *e){
+  Q_UNUSED(e);
+  stopAnimation();
+}
+
+void GLSpectrograph::startAnimation(){
+  if(timerId == 0 && isVisible()){
+    lastFrame = clock.nsecsElapsed();
+    timerId = startTimer(FRAME_INTERVAL);
+  }
+}
+
+void GLSpectrograph::stopAnimation(){
+  if(timerId != 0){
+    killTimer(timerId);
+    timerId = 0;
+  }
+}
+
+void GLSpectrograph::timerEvent(QTimerEvent *e){
+  qint64 now;
+  float dt;
+  bool idle;
+  Q_UNUSED(e);
+
+  now = clock.nsecsElapsed();
+  dt = qMin(seconds(now - lastFrame), 0.1f);
+  lastFrame = now;
+
+  // pick up the newest spectrum from the analyzer
+  idle = !pollSpectrum();
+
+  // level bars fall at a constant speed
+  leftLevel = qMax(0.0f, leftLevel - LEVEL_DECAY*dt);
+  rightLevel = qMax(0.0f, rightLevel - LEVEL_DECAY*dt);
+  if(leftLevel > 0 || rightLevel > 0)
+    idle = false;
+
+  // the bars fall on the gpu. here it is only checked
+  // whether any of them is still up
+  for(int i=0; idle && i<NUM_BANDS; i++){
+    if(bandHeight(i, now) > 0)
+      idle = false;
+  }
+
+  view->setFrame(seconds(now - texelTime), GRAVITY/qMax(1, height()), leftLevel, rightLevel);
+  view->update();
+
+  // everything has fallen and no audio arrives
+  if(idle && sleepSpectrum())
+    stopAnimation();
+}
@@ -0,0 +1,169 @@
+#ifndef GLSPECTROGRAPH_H
+#define GLSPECTROGRAPH_H
+
+#include "abstractspectrograph.h"
+
+#include <QElapsedTimer>
+#include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLWidget>
+#include <QVector>
+
+/**
+ * @brief The GLSpectrumView class draws the spectrum bars and the level
+ * meters with OpenGL
+ * @details The whole picture is a single quad. A fragment shader finds the
+ * band under each pixel in a NUM_BANDS x 1 texture and decides whether the
+ * pixel belongs to a bar, to a level meter or to the background.
+ *
+ * Each texel holds the peak height of a band and the time since it was
+ * reached (16 bits each). The shader applies gravity to them, so the decay
+ * costs no cpu and the texture only changes when a new spectrum arrives.
+ *
+ * Only OpenGL ES 2.0 level features are used (no float or 1D textures, no
+ * instancing), so it also runs on Mesa llvmpipe. A headless run can use
+ * QT_QPA_PLATFORM=offscreen with LIBGL_ALWAYS_SOFTWARE=1.
+ */
+class GLSpectrumView : public QOpenGLWidget, protected QOpenGLFunctions{
+  Q_OBJECT
+public:
+  explicit GLSpectrumView(QWidget *parent = 0);
+  ~GLSpectrumView();
+
+  /**
+   * @brief setBands replaces the band texture
+   * @param texels holds 4 bytes for each band: peak height and age, high
+   * byte first. It is uploaded on the next paint
+   */
+  void setBands(const QVector<uchar> &texels);
+
+  /**
+   * @brief setFrame sets what changes on every frame
+   * @param elapsed is the time since the bands were set, in seconds
+   * @param gravity is the fall acceleration, in widget heights per second squared
+   * @param left and right are the level meter sizes, in pixels
+   */
+  void setFrame(float elapsed, float gravity, float left, float right);
+
+protected:
+  void initializeGL();
+  void paintGL();
+
+private:
+  QOpenGLShaderProgram program;
+  QOpenGLBuffer quad;
+  GLuint texture;
+
+  /**
+   * @brief The band texels, and whether they changed since the last upload
+   */
+  QVector<uchar> bands;
+  bool bandsChanged;
+
+  float elapsed, gravity, leftLevel, rightLevel;
+};
+
+/**
+ * @brief The GLSpectrograph class is a spectrograph drawn by the gpu
+ * @details It looks like Spectrograph, but the cpu only does work per band
+ * (peak tracking and one texture upload per new spectrum), never per pixel.
+ * The bars are drawn by a GLSpectrumView that fills the widget.
+ *
+ * Like Spectrograph, it polls the spectrum source once per frame while
+ * something moves and sleeps otherwise.
+ */
+class GLSpectrograph : public AbstractSpectrograph{
+  Q_OBJECT
+public:
+  explicit GLSpectrograph(QWidget *parent = 0);
+
+public slots:
+  /**
+   * @brief loadSamples keeps the peak of each band
+   * @param _spectrum stores the spectrum, with values within [0,1]
+   */
+  void loadSamples(QVector<SpectrumReal> &_spectrum);
+
+  /**
+   * @brief loadLevels loads the left and right audio levels
+   */
+  void loadLevels(double left, double right);
+
+  /**
+   * @brief Restarts the animation when a spectrum arrives while idle
+   */
+  void spectrumReady();
+
+protected:
+  void timerEvent(QTimerEvent *e);
+  void showEvent(QShowEvent *e);
+  void hideEvent(QHideEvent *e);
+
+private:
+  void startAnimation();
+  void stopAnimation();
+
+  /**
+   * @brief setBandCount resizes the band arrays to a new number of bands
+   */
+  void setBandCount(int count);
+
+  /**
+   * @brief height returns the height of a band at a given time, in widget heights
+   */
+  float bandHeight(int band, qint64 now) const;
+
+  /**
+   * @brief seconds converts a time difference of the clock to seconds
+   * @details Times are kept in nanoseconds. Only differences are made
+   * float, so they stay precise however long the widget lives
+   */
+  static float seconds(qint64 nsecs) { return nsecs*1e-9f; }
+
+  /**
+   * @brief The view that draws everything
+   */
+  GLSpectrumView *view;
+
+  /**
+   * @brief Number of bands drawn. It follows the size of the spectra
+   */
+  int NUM_BANDS;
+
+  /**
+   * @brief The peak height of each band (in widget heights), and the time
+   * it was reached (in nanoseconds since the widget was created)
+   */
+  QVector<float> peak;
+  QVector<qint64> peakTime;
+
+  /**
+   * @brief The texels handed to the view
+   */
+  QVector<uchar> texels;
+
+  /**
+   * @brief When the texels were built, in nanoseconds
+   */
+  qint64 texelTime;
+
+  /**
+   * @brief Left and right level bar size, in pixels
+   */
+  float leftLevel, rightLevel;
+
+  /**
+   * @brief Id of the frame timer, 0 while the animation is stopped
+   */
+  int timerId;
+
+  /**
+   * @brief clock measures the time since the widget was created, and lastFrame
+   * is the time of the last frame, in nanoseconds
+   */
+  QElapsedTimer clock;
+  qint64 lastFrame;
+};
+
+#endif // GLSPECTROGRAPH_H
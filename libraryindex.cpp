@@ -0,0 +1,703 @@
+#include "libraryindex.h"
+#include <QDataStream>
+#include <QSaveFile>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+#include <cstring>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+// reads back as another number with the other byte order
+#define BYTE_ORDER_MARK 0x01020304u
+
+// the journal starts with its own magic and version. each entry
+// is its payload length, a checksum of the rest, the operation
+// and the payload
+#define JOURNAL_HEADER 16
+#define ENTRY_HEADER 9
+
+static const char INDEX_MAGIC[8] = {'P','F','L','I','B','I','D','X'};
+static const char JOURNAL_MAGIC[8] = {'P','F','L','I','B','J','N','L'};
+
+// the journal operations
+static const char PUT = 'P';
+static const char REMOVE = 'R';
+
+// the flags of a record
+static const quint32 TAGS_READ = 1;
+
+// the snapshot file: this header, the records, the table and the
+// strings. every offset is from the start of the file
+struct LibraryIndexHeader{
+  char magic[8];
+  quint32 byteOrder, version;
+  quint32 count, buckets;
+  quint64 records, table, strings, stringsSize;
+  quint64 reserved[2];
+};
+
+// strings are offsets into the string pool, where each one is
+// its utf-8 length followed by its bytes. 72 bytes per track
+struct LibraryIndexRecord{
+  quint64 inode;
+  qint64 modified, size, duration;
+  quint32 path, mimeType, title, artist, album;
+  quint32 pathHash;
+  float loudness, truePeak;
+  quint32 flags, reserved;
+};
+
+// fnv-1a. it hashes the paths and checks the journal entries
+static quint32 hashBytes(const char *data, int size){
+  quint32 hash = 2166136261u;
+  for(int i=0; i<size; i++){
+    hash ^= uchar(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static QByteArray encodeTrack(const LibraryTrack &track){
+  QByteArray payload;
+  QDataStream stream(&payload, QIODevice::WriteOnly);
+  stream.setVersion(QDataStream::Qt_5_0);
+  stream << track.path << track.inode << track.modified << track.size
+         << track.mimeType << track.title << track.artist << track.album
+         << track.duration << track.loudness << track.truePeak << track.tagsRead;
+  return payload;
+}
+
+static bool decodeTrack(const QByteArray &payload, LibraryTrack *track){
+  QDataStream stream(payload);
+  stream.setVersion(QDataStream::Qt_5_0);
+  stream >> track->path >> track->inode >> track->modified >> track->size
+         >> track->mimeType >> track->title >> track->artist >> track->album
+         >> track->duration >> track->loudness >> track->truePeak >> track->tagsRead;
+  return stream.status() == QDataStream::Ok;
+}
+
+static void appendEntry(QByteArray &entries, char op, const QByteArray &payload){
+  quint32 length, checksum;
+  int start;
+
+  start = entries.size();
+  length = payload.size();
+  entries.append(reinterpret_cast<const char*>(&length), 4);
+  entries.append(4, 0);
+  entries.append(op);
+  entries.append(payload);
+  checksum = hashBytes(entries.constData() + start + 8, payload.size() + 1);
+  memcpy(entries.data() + start + 4, &checksum, 4);
+}
+
+// strings that repeat, as artists and albums do, are pooled once
+static quint32 poolString(QByteArray &pool, QHash<QString, quint32> *pooled, const QString &string){
+  QHash<QString, quint32>::const_iterator it;
+  QByteArray utf8;
+  quint32 offset, length;
+
+  if(string.isEmpty())
+    return 0;
+  if(pooled){
+    it = pooled->constFind(string);
+    if(it != pooled->constEnd())
+      return *it;
+  }
+  utf8 = string.toUtf8();
+  offset = pool.size();
+  length = utf8.size();
+  pool.append(reinterpret_cast<const char*>(&length), 4);
+  pool.append(utf8);
+  if(pooled)
+    pooled->insert(string, offset);
+  return offset;
+}
+
+// writes the journal entries queued by the changes, so
+// whoever makes them never waits for the disk
+class LibraryJournalWriter : public QThread{
+public:
+  explicit LibraryJournalWriter(LibraryIndex *_index) : index(_index){}
+
+protected:
+  void run(){ index->writeQueued(); }
+
+private:
+  LibraryIndex *index;
+};
+
+LibraryIndex::LibraryIndex(){
+  map = 0;
+  header = 0;
+  records = 0;
+  table = 0;
+  strings = 0;
+  count = 0;
+  stopping = false;
+  writer = new LibraryJournalWriter(this);
+}
+
+LibraryIndex::~LibraryIndex(){
+  close();
+  delete writer;
+}
+
+bool LibraryIndex::open(const QString &name){
+  close();
+
+  QWriteLocker locker(&lock);
+  fileName = name;
+  mapSnapshot();
+  count = map ? header->count : 0;
+
+  // the journal holds whatever changed after the
+  // snapshot was written
+  journal.setFileName(fileName + ".journal");
+  if(!journal.open(QIODevice::ReadWrite))
+    return false;
+  replayJournal();
+  stopping = false;
+  writer->start();
+  return true;
+}
+
+void LibraryIndex::close(){
+  // whatever is queued is written before the
+  // journal is folded into the snapshot
+  stopWriter();
+  if(journal.isOpen() && journal.size() > JOURNAL_HEADER)
+    compact();
+
+  QWriteLocker locker(&lock);
+  QMutexLocker writing(&journalLock);
+  unmap();
+  journal.close();
+  added.clear();
+  removed.clear();
+  addedOrder.clear();
+  count = 0;
+}
+
+bool LibraryIndex::isOpen() const{
+  QReadLocker locker(&lock);
+  return journal.isOpen();
+}
+
+int LibraryIndex::size() const{
+  QReadLocker locker(&lock);
+  return count;
+}
+
+void LibraryIndex::mapSnapshot(){
+  qint64 size;
+
+  snapshot.setFileName(fileName);
+  if(!snapshot.open(QIODevice::ReadOnly))
+    return;
+  size = snapshot.size();
+  if(size < qint64(sizeof(LibraryIndexHeader)) || !(map = snapshot.map(0, size))){
+    snapshot.close();
+    return;
+  }
+
+  // everything is checked once, so lookups
+  // need not check offsets again
+  header = reinterpret_cast<const LibraryIndexHeader*>(map);
+  if(memcmp(header->magic, INDEX_MAGIC, 8) != 0 ||
+     header->byteOrder != BYTE_ORDER_MARK ||
+     header->version != LIBRARY_INDEX_VERSION ||
+     header->buckets < 2 || (header->buckets & (header->buckets - 1)) != 0 ||
+     header->count >= header->buckets ||
+     header->records != sizeof(LibraryIndexHeader) ||
+     header->table != header->records + quint64(header->count)*sizeof(LibraryIndexRecord) ||
+     header->strings != header->table + quint64(header->buckets)*sizeof(quint32) ||
+     header->strings + header->stringsSize > quint64(size)){
+    unmap();
+    return;
+  }
+  records = reinterpret_cast<const LibraryIndexRecord*>(map + header->records);
+  table = reinterpret_cast<const quint32*>(map + header->table);
+  strings = map + header->strings;
+}
+
+void LibraryIndex::unmap(){
+  if(map)
+    snapshot.unmap(map);
+  snapshot.close();
+  map = 0;
+  header = 0;
+  records = 0;
+  table = 0;
+  strings = 0;
+}
+
+int LibraryIndex::snapshotFind(const QString &path) const{
+  QByteArray utf8;
+  quint32 hash, mask, i, slot, length;
+
+  if(!map)
+    return -1;
+
+  // linear probing. the table is at most half full,
+  // so an empty slot ends every search
+  utf8 = path.toUtf8();
+  hash = hashBytes(utf8.constData(), utf8.size());
+  mask = header->buckets - 1;
+  for(i = hash & mask; (slot = table[i]) != 0; i = (i + 1) & mask){
+    if(slot > header->count)
+      break;
+    const LibraryIndexRecord &record = records[slot - 1];
+    if(record.pathHash != hash || quint64(record.path) + 4 > header->stringsSize)
+      continue;
+    memcpy(&length, strings + record.path, 4);
+    if(length == quint32(utf8.size()) && quint64(record.path) + 4 + length <= header->stringsSize &&
+       memcmp(strings + record.path + 4, utf8.constData(), length) == 0)
+      return slot - 1;
+  }
+  return -1;
+}
+
+QString LibraryIndex::snapshotString(quint32 offset) const{
+  quint32 length;
+
+  if(quint64(offset) + 4 > header->stringsSize)
+    return QString();
+  memcpy(&length, strings + offset, 4);
+  if(quint64(offset) + 4 + length > header->stringsSize)
+    return QString();
+  return QString::fromUtf8(reinterpret_cast<const char*>(strings + offset + 4), length);
+}
+
+LibraryTrack LibraryIndex::snapshotTrack(int i) const{
+  const LibraryIndexRecord &record = records[i];
+  LibraryTrack track;
+
+  track.path = snapshotString(record.path);
+  track.inode = record.inode;
+  track.modified = record.modified;
+  track.size = record.size;
+  track.mimeType = snapshotString(record.mimeType);
+  track.title = snapshotString(record.title);
+  track.artist = snapshotString(record.artist);
+  track.album = snapshotString(record.album);
+  track.duration = record.duration;
+  track.loudness = record.loudness;
+  track.truePeak = record.truePeak;
+  track.tagsRead = (record.flags & TAGS_READ) != 0;
+  return track;
+}
+
+bool LibraryIndex::find(const QString &path, LibraryTrack *track) const{
+  QReadLocker locker(&lock);
+  return findLocked(path, track);
+}
+
+bool LibraryIndex::findLocked(const QString &path, LibraryTrack *track) const{
+  QHash<QString, LibraryTrack>::const_iterator it;
+  int i;
+
+  // what changed since the snapshot comes first
+  it = added.constFind(path);
+  if(it != added.constEnd()){
+    if(track)
+      *track = *it;
+    return true;
+  }
+  if(removed.contains(path))
+    return false;
+  i = snapshotFind(path);
+  if(i < 0)
+    return false;
+  if(track)
+    *track = snapshotTrack(i);
+  return true;
+}
+
+LibraryTrackList LibraryIndex::tracks() const{
+  QReadLocker locker(&lock);
+  return tracksLocked();
+}
+
+LibraryTrackList LibraryIndex::tracksLocked() const{
+  QHash<QString, LibraryTrack>::const_iterator it;
+  QSet<QString> listed;
+  LibraryTrackList list;
+  LibraryTrack track;
+
+  // the snapshot keeps the order of the last run. tracks that
+  // changed since then keep their place, new ones go last
+  list.reserve(count);
+  for(quint32 i=0; map && i<header->count; i++){
+    track = snapshotTrack(i);
+    if(removed.contains(track.path))
+      continue;
+    it = added.constFind(track.path);
+    list.append(it != added.constEnd() ? *it : track);
+  }
+  for(int i=0; i<addedOrder.size(); i++){
+    it = added.constFind(addedOrder[i]);
+    if(it == added.constEnd() || listed.contains(addedOrder[i]) || snapshotFind(addedOrder[i]) >= 0)
+      continue;
+    listed.insert(addedOrder[i]);
+    list.append(*it);
+  }
+  return list;
+}
+
+int LibraryIndex::snapshotSize() const{
+  QReadLocker locker(&lock);
+  return map ? int(header->count) : 0;
+}
+
+bool LibraryIndex::record(int number, LibraryTrack *track) const{
+  QReadLocker locker(&lock);
+  QHash<QString, LibraryTrack>::const_iterator it;
+  QString path;
+
+  if(!map || number < 0 || quint32(number) >= header->count)
+    return false;
+
+  // the records that did not change since the
+  // snapshot are read where they lie
+  if(added.isEmpty() && removed.isEmpty()){
+    *track = snapshotTrack(number);
+    return true;
+  }
+  path = snapshotString(records[number].path);
+  if(removed.contains(path))
+    return false;
+  it = added.constFind(path);
+  *track = it != added.constEnd() ? *it : snapshotTrack(number);
+  return true;
+}
+
+QString LibraryIndex::recordPath(int number) const{
+  QReadLocker locker(&lock);
+
+  if(!map || number < 0 || quint32(number) >= header->count)
+    return QString();
+  return snapshotString(records[number].path);
+}
+
+int LibraryIndex::recordOf(const QString &path) const{
+  QReadLocker locker(&lock);
+  return snapshotFind(path);
+}
+
+QVector<int> LibraryIndex::removedRecords() const{
+  QReadLocker locker(&lock);
+  QVector<int> numbers;
+  int number;
+
+  for(QSet<QString>::const_iterator it = removed.constBegin(); it != removed.constEnd(); ++it){
+    number = snapshotFind(*it);
+    if(number >= 0)
+      numbers.append(number);
+  }
+  std::sort(numbers.begin(), numbers.end());
+  return numbers;
+}
+
+QStringList LibraryIndex::newPaths() const{
+  QReadLocker locker(&lock);
+  QSet<QString> listed;
+  QStringList list;
+
+  for(int i=0; i<addedOrder.size(); i++){
+    const QString &path = addedOrder[i];
+    if(!added.contains(path) || listed.contains(path) || snapshotFind(path) >= 0)
+      continue;
+    listed.insert(path);
+    list.append(path);
+  }
+  return list;
+}
+
+QStringList LibraryIndex::paths(const QString &prefix) const{
+  QReadLocker locker(&lock);
+  QSet<QString> listed;
+  QStringList list;
+  QString path;
+
+  for(quint32 i=0; map && i<header->count; i++){
+    path = snapshotString(records[i].path);
+    if(path.startsWith(prefix) && !removed.contains(path))
+      list.append(path);
+  }
+  for(int i=0; i<addedOrder.size(); i++){
+    path = addedOrder[i];
+    if(!path.startsWith(prefix) || !added.contains(path) ||
+       listed.contains(path) || snapshotFind(path) >= 0)
+      continue;
+    listed.insert(path);
+    list.append(path);
+  }
+  return list;
+}
+
+void LibraryIndex::put(const LibraryTrackList &tracks){
+  QWriteLocker locker(&lock);
+  QByteArray entries;
+
+  for(int i=0; i<tracks.size(); i++){
+    putLocked(tracks[i]);
+    appendEntry(entries, PUT, encodeTrack(tracks[i]));
+  }
+  // queued under the lock, so the entries keep
+  // the order of the changes
+  queueJournal(entries);
+}
+
+void LibraryIndex::remove(const QStringList &paths){
+  QWriteLocker locker(&lock);
+  QByteArray entries;
+  QByteArray payload;
+
+  for(int i=0; i<paths.size(); i++){
+    removeLocked(paths[i]);
+    payload = paths[i].toUtf8();
+    appendEntry(entries, REMOVE, payload);
+  }
+  queueJournal(entries);
+}
+
+bool LibraryIndex::setAnalysis(const QString &path, float loudness, float truePeak){
+  QWriteLocker locker(&lock);
+  QByteArray entries;
+  LibraryTrack track;
+
+  if(!findLocked(path, &track))
+    return false;
+  track.loudness = loudness;
+  track.truePeak = truePeak;
+  putLocked(track);
+  appendEntry(entries, PUT, encodeTrack(track));
+  queueJournal(entries);
+  return true;
+}
+
+void LibraryIndex::putLocked(const LibraryTrack &track){
+  if(!findLocked(track.path, 0))
+    count++;
+  if(!added.contains(track.path) && snapshotFind(track.path) < 0)
+    addedOrder.append(track.path);
+  added.insert(track.path, track);
+  removed.remove(track.path);
+}
+
+void LibraryIndex::removeLocked(const QString &path){
+  if(!findLocked(path, 0))
+    return;
+  count--;
+  added.remove(path);
+  if(snapshotFind(path) >= 0)
+    removed.insert(path);
+}
+
+void LibraryIndex::replayJournal(){
+  QByteArray data, payload;
+  LibraryTrack track;
+  quint32 length, checksum, version, byteOrder;
+  int position;
+
+  data = journal.readAll();
+  if(data.size() < JOURNAL_HEADER){
+    resetJournal();
+    return;
+  }
+  memcpy(&version, data.constData() + 8, 4);
+  memcpy(&byteOrder, data.constData() + 12, 4);
+  if(memcmp(data.constData(), JOURNAL_MAGIC, 8) != 0 ||
+     version != LIBRARY_INDEX_VERSION || byteOrder != BYTE_ORDER_MARK){
+    resetJournal();
+    return;
+  }
+
+  // entries are replayed up to the first one that is
+  // cut short or does not match its checksum
+  position = JOURNAL_HEADER;
+  while(data.size() - position >= ENTRY_HEADER){
+    memcpy(&length, data.constData() + position, 4);
+    memcpy(&checksum, data.constData() + position + 4, 4);
+    if(length > quint32(data.size() - position - ENTRY_HEADER) ||
+       hashBytes(data.constData() + position + 8, length + 1) != checksum)
+      break;
+    payload = QByteArray::fromRawData(data.constData() + position + ENTRY_HEADER, length);
+    if(data[position + 8] == PUT){
+      if(!decodeTrack(payload, &track))
+        break;
+      putLocked(track);
+    }
+    else if(data[position + 8] == REMOVE){
+      removeLocked(QString::fromUtf8(payload));
+    }
+    else{
+      break;
+    }
+    position += ENTRY_HEADER + length;
+  }
+
+  // new entries go right after the last good one
+  if(position < data.size())
+    journal.resize(position);
+  journal.seek(position);
+}
+
+void LibraryIndex::resetJournal(){
+  QByteArray start;
+  quint32 value;
+
+  start.append(JOURNAL_MAGIC, 8);
+  value = LIBRARY_INDEX_VERSION;
+  start.append(reinterpret_cast<const char*>(&value), 4);
+  value = BYTE_ORDER_MARK;
+  start.append(reinterpret_cast<const char*>(&value), 4);
+  journal.resize(0);
+  journal.seek(0);
+  writeJournal(start);
+}
+
+void LibraryIndex::queueJournal(const QByteArray &entries){
+  if(!journal.isOpen() || entries.isEmpty())
+    return;
+  QMutexLocker locker(&queueLock);
+  queued.append(entries);
+  queueChanged.wakeOne();
+}
+
+void LibraryIndex::writeQueued(){
+  QByteArray entries;
+
+  for(;;){
+    queueLock.lock();
+    while(queued.isEmpty() && !stopping)
+      queueChanged.wait(&queueLock);
+    if(queued.isEmpty()){
+      queueLock.unlock();
+      return;
+    }
+    queueLock.unlock();
+
+    // the entries are taken with the journal lock held, so
+    // compact() either sees them written or drops them from
+    // the queue, never both. whatever piled up while the
+    // last entries were synced goes in a single write
+    QMutexLocker writing(&journalLock);
+    queueLock.lock();
+    entries.swap(queued);
+    queued.clear();
+    queueLock.unlock();
+    writeJournal(entries);
+  }
+}
+
+void LibraryIndex::stopWriter(){
+  queueLock.lock();
+  stopping = true;
+  queueChanged.wakeAll();
+  queueLock.unlock();
+  writer->wait();
+}
+
+void LibraryIndex::writeJournal(const QByteArray &entries){
+  if(!journal.isOpen() || entries.isEmpty())
+    return;
+  journal.write(entries);
+  journal.flush();
+#ifdef Q_OS_UNIX
+  fsync(journal.handle());
+#endif
+}
+
+bool LibraryIndex::compact(){
+  QWriteLocker locker(&lock);
+  QMutexLocker writing(&journalLock);
+  QHash<QString, quint32> pooled;
+  QVector<LibraryIndexRecord> newRecords;
+  QVector<quint32> newTable;
+  LibraryIndexHeader newHeader;
+  LibraryTrackList all;
+  QByteArray pool, path;
+  QSaveFile out(fileName);
+  quint32 buckets, mask, slot;
+
+  if(!journal.isOpen())
+    return false;
+
+  // the table is kept at most half full
+  all = tracksLocked();
+  buckets = 2;
+  while(buckets < 2*quint32(all.size()))
+    buckets *= 2;
+  mask = buckets - 1;
+
+  // offset 0 of the pool is the empty string
+  pool.fill(0, 4);
+  newRecords.resize(all.size());
+  newTable.fill(0, buckets);
+  for(int i=0; i<all.size(); i++){
+    const LibraryTrack &track = all[i];
+    LibraryIndexRecord &record = newRecords[i];
+    memset(&record, 0, sizeof(record));
+    path = track.path.toUtf8();
+    record.pathHash = hashBytes(path.constData(), path.size());
+    record.path = poolString(pool, 0, track.path);
+    record.inode = track.inode;
+    record.modified = track.modified;
+    record.size = track.size;
+    record.duration = track.duration;
+    record.mimeType = poolString(pool, &pooled, track.mimeType);
+    record.title = poolString(pool, &pooled, track.title);
+    record.artist = poolString(pool, &pooled, track.artist);
+    record.album = poolString(pool, &pooled, track.album);
+    record.loudness = track.loudness;
+    record.truePeak = track.truePeak;
+    record.flags = track.tagsRead ? TAGS_READ : 0;
+    for(slot = record.pathHash & mask; newTable[slot] != 0; slot = (slot + 1) & mask);
+    newTable[slot] = i + 1;
+  }
+
+  memset(&newHeader, 0, sizeof(newHeader));
+  memcpy(newHeader.magic, INDEX_MAGIC, 8);
+  newHeader.byteOrder = BYTE_ORDER_MARK;
+  newHeader.version = LIBRARY_INDEX_VERSION;
+  newHeader.count = all.size();
+  newHeader.buckets = buckets;
+  newHeader.records = sizeof(LibraryIndexHeader);
+  newHeader.table = newHeader.records + quint64(all.size())*sizeof(LibraryIndexRecord);
+  newHeader.strings = newHeader.table + quint64(buckets)*sizeof(quint32);
+  newHeader.stringsSize = pool.size();
+
+  // the new snapshot is written aside and renamed over the old one
+  // when complete. the old one is unmapped first, as some systems
+  // do not replace files that are mapped
+  if(!out.open(QIODevice::WriteOnly))
+    return false;
+  out.write(reinterpret_cast<const char*>(&newHeader), sizeof(newHeader));
+  out.write(reinterpret_cast<const char*>(newRecords.constData()),
+            newRecords.size()*sizeof(LibraryIndexRecord));
+  out.write(reinterpret_cast<const char*>(newTable.constData()), buckets*sizeof(quint32));
+  out.write(pool);
+  unmap();
+  if(!out.commit()){
+    mapSnapshot();
+    return false;
+  }
+
+  // the journal is emptied only once the snapshot is safe. a crash
+  // in between replays entries the snapshot already has
+  mapSnapshot();
+  added.clear();
+  removed.clear();
+  addedOrder.clear();
+  count = all.size();
+
+  // the snapshot has the changes still queued too
+  queueLock.lock();
+  queued.clear();
+  queueLock.unlock();
+  resetJournal();
+  return true;
+}
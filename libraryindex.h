@@ -0,0 +1,245 @@
+#ifndef LIBRARYINDEX_H
+#define LIBRARYINDEX_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+#include "librarytrack.h"
+
+// the layout of the snapshot file. indexes of another version are ignored
+#define LIBRARY_INDEX_VERSION 2
+
+struct LibraryIndexHeader;
+struct LibraryIndexRecord;
+class LibraryJournalWriter;
+
+/**
+ * @brief The LibraryIndex class keeps the music library on disk, from one
+ * run to the next
+ * @details The index is a snapshot file and a journal beside it.
+ *
+ * The snapshot holds fixed size records, an open addressing table that
+ * finds them by path, and a pool of the strings they point to. It is
+ * mapped into memory and read where it lies, so opening it costs the same
+ * for ten tracks or for a million, and a lookup touches a few pages only.
+ *
+ * Changes are appended to the journal, and kept in memory on top of the
+ * snapshot. Every journal entry carries its length and a checksum: an
+ * entry torn by a crash is dropped, with whatever follows it, the next
+ * time the index is opened. close() folds both into a new snapshot and
+ * empties the journal. The snapshot is replaced atomically, and replaying
+ * a journal over the snapshot it was folded into changes nothing, so a
+ * crash at any point loses at most the entry being written.
+ *
+ * Snapshots of another version, or written with another byte order, are
+ * ignored and the library starts over.
+ *
+ * Lookups and changes may come from any thread. Changes are made in
+ * memory and their journal entries queued for a writer thread of the
+ * index, which writes and syncs whatever is queued at once. Neither
+ * lookups nor changes wait for the disk, so the gui thread may make
+ * changes too. close() waits for the queued entries to be written.
+ */
+class LibraryIndex{
+public:
+  /**
+   * @brief Creates an empty index. It lives in memory only until open()
+   */
+  LibraryIndex();
+
+  /**
+   * @brief Closes the index, as close() does
+   */
+  ~LibraryIndex();
+
+  /**
+   * @brief open reads an index back from disk
+   * @param fileName is the snapshot file. The journal is the same file
+   * name with ".journal" appended. Both are created when missing
+   * @return false when the journal could not be opened for writing. The
+   * index then still works, in memory
+   */
+  bool open(const QString &fileName);
+
+  /**
+   * @brief close writes what changed into a new snapshot and lets go of
+   * the files. The index is empty afterwards
+   */
+  void close();
+
+  /**
+   * @brief isOpen tells whether changes reach the disk
+   */
+  bool isOpen() const;
+
+  /**
+   * @brief size returns the number of tracks in the library
+   */
+  int size() const;
+
+  /**
+   * @brief find looks a track up by its absolute path
+   * @param track receives the record, when it is not null
+   * @return false when the path is not in the library
+   */
+  bool find(const QString &path, LibraryTrack *track = 0) const;
+
+  /**
+   * @brief contains tells whether a path is in the library
+   */
+  bool contains(const QString &path) const { return find(path); }
+
+  /**
+   * @brief tracks returns every track, in the order they were added
+   */
+  LibraryTrackList tracks() const;
+
+  /**
+   * @brief paths returns the paths of the tracks that start with a prefix
+   */
+  QStringList paths(const QString &prefix = QString()) const;
+
+  /**
+   * @brief snapshotSize returns the number of records in the snapshot
+   * @details The records are numbered from 0, in the order of the library
+   * when the snapshot was written, and keep their numbers until compact()
+   * writes the next one. Reading the library through them costs nothing
+   * until a record is asked for
+   */
+  int snapshotSize() const;
+
+  /**
+   * @brief record reads a snapshot record, with the changes made since
+   * @return false when the number is out of range or the track was taken
+   * out of the library since. The track is then left alone
+   */
+  bool record(int number, LibraryTrack *track) const;
+
+  /**
+   * @brief recordPath returns the path of a snapshot record, taken out of
+   * the library since or not
+   */
+  QString recordPath(int number) const;
+
+  /**
+   * @brief recordOf returns the number of the snapshot record of a path,
+   * taken out of the library since or not, or -1 when there is none
+   */
+  int recordOf(const QString &path) const;
+
+  /**
+   * @brief removedRecords returns the numbers of the snapshot records
+   * taken out of the library since, in increasing order
+   */
+  QVector<int> removedRecords() const;
+
+  /**
+   * @brief newPaths returns the paths of the tracks added since the
+   * snapshot was written, in the order they were added
+   */
+  QStringList newPaths() const;
+
+  /**
+   * @brief put adds tracks to the library, or replaces their records
+   */
+  void put(const LibraryTrackList &tracks);
+
+  /**
+   * @brief remove takes tracks out of the library
+   */
+  void remove(const QStringList &paths);
+
+  /**
+   * @brief setAnalysis stores the analysis summary of a track
+   * @return false when the path is not in the library
+   */
+  bool setAnalysis(const QString &path, float loudness, float truePeak);
+
+  /**
+   * @brief compact writes a new snapshot with everything in the library and
+   * empties the journal
+   * @return false when the index is not open or the snapshot could not
+   * be written. Nothing is lost then: the journal is kept
+   */
+  bool compact();
+
+private:
+  // these expect the lock to be held
+  void mapSnapshot();
+  void unmap();
+  int snapshotFind(const QString &path) const;
+  QString snapshotString(quint32 offset) const;
+  LibraryTrack snapshotTrack(int record) const;
+  bool findLocked(const QString &path, LibraryTrack *track) const;
+  LibraryTrackList tracksLocked() const;
+  void putLocked(const LibraryTrack &track);
+  void removeLocked(const QString &path);
+  void replayJournal();
+  void resetJournal();
+  void writeJournal(const QByteArray &entries);
+  void queueJournal(const QByteArray &entries);
+  void stopWriter();
+
+  friend class LibraryJournalWriter;
+  /**
+   * @brief writeQueued writes the queued entries until stopWriter() is
+   * called. The writer thread runs it
+   */
+  void writeQueued();
+
+  QString fileName;
+
+  /**
+   * @brief snapshot is mapped at map, which is null when there is no
+   * valid snapshot
+   */
+  QFile snapshot;
+  uchar *map;
+  const LibraryIndexHeader *header;
+  const LibraryIndexRecord *records;
+  const quint32 *table;
+  const uchar *strings;
+
+  /**
+   * @brief journal takes every change. Entries are written whole, with a
+   * single write each
+   */
+  QFile journal;
+
+  /**
+   * @brief added holds the tracks put since the snapshot was written, and
+   * removed the snapshot tracks taken out since. addedOrder keeps the order
+   * tracks new to the library came in
+   */
+  QHash<QString, LibraryTrack> added;
+  QSet<QString> removed;
+  QStringList addedOrder;
+
+  int count;
+
+  /**
+   * @brief lock guards everything but the journal file, which journalLock
+   * guards, and the queue, which queueLock guards. Whoever needs several
+   * takes them in that order
+   */
+  mutable QReadWriteLock lock;
+  QMutex journalLock;
+
+  /**
+   * @brief queued holds the journal entries waiting for the writer, in
+   * the order of the changes. queueChanged wakes the writer up
+   */
+  QByteArray queued;
+  QMutex queueLock;
+  QWaitCondition queueChanged;
+  bool stopping;
+  LibraryJournalWriter *writer;
+};
+
+#endif // LIBRARYINDEX_H
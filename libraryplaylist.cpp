@@ -0,0 +1,223 @@
+#include "libraryplaylist.h"
+#include <QSet>
+
+LibraryPlaylist::LibraryPlaylist(QObject *parent) : QObject(parent){
+  library = 0;
+  base = 0;
+  current = -1;
+}
+
+void LibraryPlaylist::setLibrary(const LibraryIndex *_library){
+  library = _library;
+  if(mediaCount() > 0)
+    emit mediaChanged(0, mediaCount() - 1);
+}
+
+void LibraryPlaylist::loadLibrary(){
+  QVector<int> removed;
+  QStringList added;
+  int size, count, next;
+
+  if(mediaCount() > 0)
+    removeMedia(0, mediaCount() - 1);
+  if(!library)
+    return;
+  size = library->snapshotSize();
+  removed = library->removedRecords();
+  added = library->newPaths();
+  count = size - removed.size() + added.size();
+  if(count == 0)
+    return;
+
+  emit mediaAboutToBeInserted(0, count - 1);
+  base = size;
+
+  // the journal of a run that did not write its snapshot may
+  // have taken records out. only then is the list copied
+  if(!removed.isEmpty()){
+    base = 0;
+    entries.reserve(size - removed.size());
+    next = 0;
+    for(int number=0; number<size; number++){
+      if(next < removed.size() && removed[next] == number)
+        next++;
+      else
+        entries.append(number);
+    }
+  }
+  for(int i=0; i<added.size(); i++){
+    extra.append(added[i]);
+    entries.append(-1 - i);
+  }
+  emit mediaInserted(0, count - 1);
+}
+
+int LibraryPlaylist::mediaCount() const{
+  return base + entries.size();
+}
+
+qint32 LibraryPlaylist::entry(int position) const{
+  return position < base ? position : entries[position - base];
+}
+
+QString LibraryPlaylist::path(int position) const{
+  qint32 found;
+
+  if(position < 0 || position >= mediaCount())
+    return QString();
+  found = entry(position);
+  if(found < 0)
+    return extra[-1 - found];
+  return library ? library->recordPath(found) : QString();
+}
+
+void LibraryPlaylist::track(int position, LibraryTrack *track) const{
+  qint32 found;
+
+  *track = LibraryTrack();
+  if(position < 0 || position >= mediaCount())
+    return;
+  found = entry(position);
+  if(found < 0){
+    track->path = extra[-1 - found];
+    if(library)
+      library->find(track->path, track);
+  }
+  else if(library && !library->record(found, track)){
+    track->path = library->recordPath(found);
+  }
+}
+
+void LibraryPlaylist::addMedia(const QString &path){
+  addMedia(QStringList(path));
+}
+
+void LibraryPlaylist::addMedia(const QStringList &paths){
+  int start;
+
+  if(paths.isEmpty())
+    return;
+  start = mediaCount();
+  emit mediaAboutToBeInserted(start, start + paths.size() - 1);
+  for(int i=0; i<paths.size(); i++){
+    extra.append(paths[i]);
+    entries.append(-extra.size());
+  }
+  emit mediaInserted(start, start + paths.size() - 1);
+}
+
+void LibraryPlaylist::expand(){
+  QVector<qint32> all;
+
+  if(base == 0)
+    return;
+  all.reserve(base + entries.size());
+  for(int number=0; number<base; number++)
+    all.append(number);
+  all += entries;
+  entries.swap(all);
+  base = 0;
+}
+
+bool LibraryPlaylist::removeMedia(int first, int last){
+  int count, previous;
+  bool gone;
+
+  count = mediaCount();
+  if(first < 0 || first > last || last >= count)
+    return false;
+  emit mediaAboutToBeRemoved(first, last);
+
+  // songs taken out at the end shorten the leading
+  // part, only those in the middle copy it
+  if(last == count - 1){
+    if(first <= base){
+      entries.clear();
+      base = first;
+    }
+    else{
+      entries.resize(first - base);
+    }
+  }
+  else{
+    if(first < base)
+      expand();
+    entries.remove(first - base, last - first + 1);
+  }
+  if(mediaCount() == 0)
+    extra.clear();
+
+  previous = current;
+  gone = current >= first && current <= last;
+  if(gone)
+    current = -1;
+  else if(current > last)
+    current -= last - first + 1;
+  emit mediaRemoved(first, last);
+  if(current != previous)
+    emit currentIndexChanged(current);
+  if(gone)
+    emit currentMediaChanged(QString());
+  return true;
+}
+
+void LibraryPlaylist::removePaths(const QStringList &paths){
+  QSet<QString> gone;
+  QSet<qint32> goneEntries;
+  int number, last;
+
+  // toSet() is deprecated since qt 5.14, which builds
+  // sets from ranges instead
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+  gone = QSet<QString>(paths.begin(), paths.end());
+#else
+  gone = paths.toSet();
+#endif
+
+  // the paths are turned into entries once, so the
+  // songs are found without reading their paths
+  for(int i=0; i<paths.size(); i++){
+    number = library ? library->recordOf(paths[i]) : -1;
+    if(number >= 0)
+      goneEntries.insert(number);
+  }
+  for(int i=0; i<extra.size(); i++){
+    if(gone.contains(extra[i]))
+      goneEntries.insert(-1 - i);
+  }
+  if(goneEntries.isEmpty())
+    return;
+
+  // runs of songs are taken out from the last one, so the
+  // positions before them stay where they are
+  for(int position=mediaCount()-1; position>=0; position--){
+    if(!goneEntries.contains(entry(position)))
+      continue;
+    last = position;
+    while(position > 0 && goneEntries.contains(entry(position - 1)))
+      position--;
+    removeMedia(position, last);
+  }
+}
+
+int LibraryPlaylist::currentIndex() const{
+  return current;
+}
+
+void LibraryPlaylist::setCurrentIndex(int position){
+  if(position < -1 || position >= mediaCount() || position == current)
+    return;
+  current = position;
+  emit currentIndexChanged(current);
+  emit currentMediaChanged(path(current));
+}
+
+void LibraryPlaylist::next(){
+  if(mediaCount() > 0)
+    setCurrentIndex((current + 1) % mediaCount());
+}
+
+void LibraryPlaylist::previous(){
+  if(mediaCount() > 0)
+    setCurrentIndex(current <= 0 ? mediaCount() - 1 : current - 1);
+}
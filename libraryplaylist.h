@@ -0,0 +1,149 @@
+#ifndef LIBRARYPLAYLIST_H
+#define LIBRARYPLAYLIST_H
+
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+#include "libraryindex.h"
+
+/**
+ * @brief The LibraryPlaylist class is the list of songs the player goes
+ * through, in a loop
+ * @details It takes the place of QMediaPlaylist, which keeps a media
+ * object per song: filling one with the library builds an url per track
+ * before the first song plays. Here the library is the leading part of the
+ * playlist without being copied. Its positions are the records of the
+ * snapshot the library index mapped, in the same order, and are read from
+ * the index when they are asked for. Songs added afterwards follow them.
+ *
+ * The leading part is copied into a list of record numbers, a few bytes
+ * per song, the first time a change falls inside it. Songs appended or
+ * taken out at the end never copy it.
+ *
+ * The signals are named after those of QMediaPlaylist, so views follow
+ * either one the same way.
+ */
+class LibraryPlaylist : public QObject{
+  Q_OBJECT
+public:
+  /**
+   * @brief Creates an empty playlist, with no current song
+   */
+  explicit LibraryPlaylist(QObject *parent = 0);
+
+  /**
+   * @brief setLibrary tells where the songs are looked up
+   * @param library must outlive the playlist, or the next call. compact()
+   * numbers its records anew, so the playlist is not read after it
+   */
+  void setLibrary(const LibraryIndex *library);
+
+  /**
+   * @brief loadLibrary replaces the songs with those of the library, in
+   * its order. It takes the same time for ten tracks or for a million
+   */
+  void loadLibrary();
+
+  /**
+   * @brief mediaCount returns the number of songs
+   */
+  int mediaCount() const;
+
+  /**
+   * @brief path returns the absolute path of the song at a position
+   */
+  QString path(int position) const;
+
+  /**
+   * @brief track fills the record of the song at a position from the
+   * library. Songs out of the library get their path only
+   */
+  void track(int position, LibraryTrack *track) const;
+
+  /**
+   * @brief addMedia appends songs to the playlist
+   */
+  void addMedia(const QString &path);
+  void addMedia(const QStringList &paths);
+
+  /**
+   * @brief removeMedia takes the songs between two positions out
+   * @return false when the positions are out of range
+   */
+  bool removeMedia(int first, int last);
+  bool removeMedia(int position) { return removeMedia(position, position); }
+
+  /**
+   * @brief removePaths takes every song with one of the paths out
+   */
+  void removePaths(const QStringList &paths);
+
+  /**
+   * @brief currentIndex returns the position of the current song, -1
+   * when there is none
+   */
+  int currentIndex() const;
+
+public slots:
+  /**
+   * @brief setCurrentIndex makes the song at a position the current one
+   */
+  void setCurrentIndex(int position);
+
+  /**
+   * @brief next and previous move to the song after or before the current
+   * one. The first song follows the last
+   */
+  void next();
+  void previous();
+
+signals:
+  void mediaAboutToBeInserted(int start, int end);
+  void mediaInserted(int start, int end);
+  void mediaAboutToBeRemoved(int start, int end);
+  void mediaRemoved(int start, int end);
+  void mediaChanged(int start, int end);
+
+  /**
+   * @brief currentIndexChanged tells the position of the current song
+   * changed, which happens when songs before it come or go too
+   */
+  void currentIndexChanged(int position);
+
+  /**
+   * @brief currentMediaChanged tells another song is the current one. The
+   * path is empty when there is none
+   */
+  void currentMediaChanged(QString path);
+
+private:
+  /**
+   * @brief expand copies the leading part into the entries
+   */
+  void expand();
+
+  /**
+   * @brief entry returns what the playlist holds at a position: a record
+   * number, or -1-i for the path extra[i]
+   */
+  qint32 entry(int position) const;
+
+  const LibraryIndex *library;
+
+  /**
+   * @brief base is the size of the leading part. Position i < base is
+   * record i of the snapshot. The entries come after it
+   */
+  int base;
+  QVector<qint32> entries;
+
+  /**
+   * @brief extra holds the paths of the songs added to the playlist. They
+   * are not taken out until the playlist is emptied
+   */
+  QStringList extra;
+
+  int current;
+};
+
+#endif // LIBRARYPLAYLIST_H
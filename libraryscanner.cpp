@@ -0,0 +1,241 @@
+#include "libraryscanner.h"
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMimeDatabase>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QThread>
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+// a task hands over what it found every this many files,
+// and when it is done with its folder
+#define SCAN_BATCH 512
+
+// what the tasks of a job share with each other
+struct LibraryScanShared{
+  int job, generation;
+  // the index may be read from any thread
+  const LibraryIndex *library;
+  // tasks queued or running. the last one to finish
+  // tells the scanner the job is over
+  QAtomicInt pending;
+};
+
+// a scan task walks one folder, or looks at a list of files
+class LibraryScanTask : public QRunnable{
+public:
+  LibraryScanTask(LibraryScanner *_scanner, QSharedPointer<LibraryScanShared> _shared,
+                  const QString &_folder, const QStringList &_files = QStringList())
+    : scanner(_scanner), shared(_shared), folder(_folder), files(_files){}
+  void run();
+
+private:
+  bool cancelled() const;
+  void look(const QString &path);
+  void flush();
+
+  LibraryScanner *scanner;
+  QSharedPointer<LibraryScanShared> shared;
+  QString folder;
+  QStringList files;
+  QMimeDatabase mimes;
+  LibraryScanBatch batch;
+};
+
+bool LibraryScanTask::cancelled() const{
+  return scanner->generation.loadAcquire() != shared->generation;
+}
+
+void LibraryScanTask::run(){
+  QString path;
+
+  batch.job = shared->job;
+  if(!folder.isEmpty()){
+    // subfolders are queued as tasks of their own, so
+    // any idle thread may take them
+    QDirIterator it(folder, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Readable);
+    while(it.hasNext() && !cancelled()){
+      path = it.next();
+      if(it.fileInfo().isDir()){
+        if(it.fileInfo().isSymLink())
+          continue;
+        shared->pending.ref();
+        scanner->pool.start(new LibraryScanTask(scanner, shared, path));
+      }
+      else{
+        look(path);
+      }
+    }
+  }
+  for(int i=0; i<files.size() && !cancelled(); i++)
+    look(QFileInfo(files[i]).absoluteFilePath());
+  flush();
+
+  if(!shared->pending.deref())
+    QMetaObject::invokeMethod(scanner, "finishJob", Qt::QueuedConnection,
+                              Q_ARG(int, shared->job));
+}
+
+void LibraryScanTask::look(const QString &path){
+  LibraryTrack track, known;
+  QMimeType type;
+
+  // the identity of the file
+  track.path = path;
+#ifdef Q_OS_UNIX
+  struct stat info;
+  if(stat(QFile::encodeName(path).constData(), &info) != 0)
+    return;
+  track.inode = info.st_ino;
+  track.size = info.st_size;
+  track.modified = qint64(info.st_mtime)*1000;
+#else
+  QFileInfo info(path);
+  if(!info.exists())
+    return;
+  track.size = info.size();
+  track.modified = info.lastModified().toMSecsSinceEpoch();
+#endif
+
+  // the same version of a known file is not opened again
+  if(shared->library->find(path, &known) && known.sameFile(track)){
+    batch.unchanged.append(path);
+  }
+  else{
+    // the extension tells most files apart without
+    // opening them. the rest is sniffed
+    type = mimes.mimeTypeForFile(path, QMimeDatabase::MatchExtension);
+    if(!type.name().startsWith("audio"))
+      type = type.isDefault() ? mimes.mimeTypeForFile(path) : QMimeType();
+    if(!type.isValid() || !type.name().startsWith("audio"))
+      return;
+    track.mimeType = type.name();
+    batch.tracks.append(track);
+  }
+  if(batch.tracks.size() + batch.unchanged.size() >= SCAN_BATCH)
+    flush();
+}
+
+void LibraryScanTask::flush(){
+  if(batch.tracks.isEmpty() && batch.unchanged.isEmpty())
+    return;
+  QMetaObject::invokeMethod(scanner, "takeBatch", Qt::QueuedConnection,
+                            Q_ARG(LibraryScanBatch, batch));
+  batch.tracks.clear();
+  batch.unchanged.clear();
+}
+
+LibraryScanner::LibraryScanner(QObject *parent) : QObject(parent){
+  qRegisterMetaType<LibraryScanBatch>();
+  qRegisterMetaType<LibraryTrackList>();
+  nextJob = 0;
+  generation.storeRelease(0);
+  library = &memoryIndex;
+
+  // the tasks mostly wait for the disk (or the network, for
+  // shared volumes), so there are more of them than cores
+  pool.setMaxThreadCount(2*qMax(2, QThread::idealThreadCount()));
+}
+
+LibraryScanner::~LibraryScanner(){
+  // the tasks use this object until they finish
+  cancel();
+  pool.waitForDone();
+}
+
+void LibraryScanner::setIndex(LibraryIndex *index){
+  library = index ? index : &memoryIndex;
+}
+
+void LibraryScanner::scan(QString folder){
+  if(!QFileInfo(folder).isDir())
+    return;
+  start(QDir(folder).absolutePath(), QStringList());
+}
+
+void LibraryScanner::addFiles(QStringList files){
+  if(!files.isEmpty())
+    start(QString(), files);
+}
+
+void LibraryScanner::start(const QString &folder, const QStringList &files){
+  QSharedPointer<LibraryScanShared> shared(new LibraryScanShared);
+  Job job;
+
+  job.folder = folder;
+  job.found = job.unchanged = 0;
+  job.cancelled = false;
+  jobs.insert(nextJob, job);
+
+  shared->job = nextJob++;
+  shared->generation = generation.loadAcquire();
+  shared->library = library;
+  shared->pending.storeRelease(1);
+  pool.start(new LibraryScanTask(this, shared, folder, files));
+}
+
+void LibraryScanner::cancel(){
+  generation.ref();
+  for(QMap<int, Job>::iterator it = jobs.begin(); it != jobs.end(); it++)
+    it->cancelled = true;
+}
+
+void LibraryScanner::takeBatch(LibraryScanBatch batch){
+  LibraryTrackList found, changed;
+  QMap<int, Job>::iterator job;
+
+  job = jobs.find(batch.job);
+  if(job == jobs.end())
+    return;
+
+  // a file may have been found by another job since
+  // the task looked it up
+  for(int i=0; i<batch.tracks.size(); i++){
+    const LibraryTrack &track = batch.tracks[i];
+    if(library->contains(track.path))
+      changed.append(track);
+    else
+      found.append(track);
+    job->seen.insert(track.path);
+  }
+  // the whole batch goes to the journal at once
+  library->put(batch.tracks);
+  for(int i=0; i<batch.unchanged.size(); i++)
+    job->seen.insert(batch.unchanged[i]);
+  job->found += batch.tracks.size();
+  job->unchanged += batch.unchanged.size();
+
+  if(!found.isEmpty())
+    emit tracksFound(found);
+  if(!changed.isEmpty())
+    emit tracksChanged(changed);
+}
+
+void LibraryScanner::finishJob(int id){
+  QStringList known, removed;
+  QString prefix;
+  Job job;
+
+  job = jobs.take(id);
+
+  // known files of a completely scanned folder that
+  // were not seen this time are gone
+  if(!job.folder.isEmpty() && !job.cancelled){
+    prefix = job.folder.endsWith('/') ? job.folder : job.folder + '/';
+    known = library->paths(prefix);
+    for(int i=0; i<known.size(); i++){
+      if(!job.seen.contains(known[i]))
+        removed.append(known[i]);
+    }
+    if(!removed.isEmpty()){
+      library->remove(removed);
+      emit tracksRemoved(removed);
+    }
+  }
+  emit scanFinished(job.found, job.unchanged, removed.size());
+}
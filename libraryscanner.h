@@ -0,0 +1,166 @@
+#ifndef LIBRARYSCANNER_H
+#define LIBRARYSCANNER_H
+
+#include <QAtomicInt>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include "libraryindex.h"
+
+/**
+ * @brief The LibraryScanBatch struct carries what a scan task found to the
+ * scanner
+ */
+struct LibraryScanBatch{
+  int job;
+  /**
+   * @brief tracks holds the new and changed audio files
+   */
+  LibraryTrackList tracks;
+  /**
+   * @brief unchanged holds the files that were known already
+   */
+  QStringList unchanged;
+};
+
+Q_DECLARE_METATYPE(LibraryScanBatch)
+
+/**
+ * @brief The LibraryScanner class finds the audio files of folders without
+ * blocking the gui thread
+ * @details Each folder is walked by a task of a thread pool. Every
+ * subfolder becomes a task of its own, so idle threads always find a
+ * folder to take and deep or uneven trees keep every thread busy.
+ *
+ * Files are identified by inode, modification time and size. Files that
+ * the library index holds with the same identity are not opened again. The others
+ * are first looked up by extension, and only those that may be audio are
+ * sniffed from their contents.
+ *
+ * Results arrive in batches, through tracksFound() and tracksChanged(),
+ * while the scan goes on, and are put into the index as they arrive. Files
+ * that disappeared from a scanned folder are taken out of the index and
+ * told by tracksRemoved() when its scan is over.
+ *
+ * The scanner lives in the gui thread. Its signals are emitted there.
+ */
+class LibraryScanner : public QObject{
+  Q_OBJECT
+public:
+  /**
+   * @brief Creates an idle scanner. It keeps what it finds in an index of
+   * its own, in memory, until setIndex() is called
+   */
+  explicit LibraryScanner(QObject *parent = 0);
+
+  /**
+   * @brief Cancels the scans and waits for their tasks to finish
+   */
+  ~LibraryScanner();
+
+  /**
+   * @brief setIndex tells where the library is kept, so scans only look at
+   * what changed. It is set while no scan runs
+   * @param index must outlive the scanner, or the next setIndex()
+   */
+  void setIndex(LibraryIndex *index);
+
+  /**
+   * @brief index returns the index the scanner works on
+   */
+  LibraryIndex *index() const { return library; }
+
+  /**
+   * @brief isScanning tells whether some scan is still running
+   */
+  bool isScanning() const { return !jobs.isEmpty(); }
+
+public slots:
+  /**
+   * @brief scan walks a folder and all of its subfolders
+   */
+  void scan(QString folder);
+
+  /**
+   * @brief addFiles looks at a list of files, as a scan does
+   */
+  void addFiles(QStringList files);
+
+  /**
+   * @brief cancel stops every running scan. Batches already found are
+   * still delivered, but no file is told to be removed
+   */
+  void cancel();
+
+signals:
+  /**
+   * @brief tracksFound tells about audio files that were not known
+   */
+  void tracksFound(LibraryTrackList tracks);
+
+  /**
+   * @brief tracksChanged tells about known files that changed
+   */
+  void tracksChanged(LibraryTrackList tracks);
+
+  /**
+   * @brief tracksRemoved tells about known files that are gone
+   */
+  void tracksRemoved(QStringList paths);
+
+  /**
+   * @brief scanFinished tells that a scan is over
+   * @param found counts new and changed files
+   * @param unchanged counts files that were not opened again
+   * @param removed counts files that are gone
+   */
+  void scanFinished(int found, int unchanged, int removed);
+
+private slots:
+  void takeBatch(LibraryScanBatch batch);
+  void finishJob(int job);
+
+private:
+  friend class LibraryScanTask;
+
+  /**
+   * @brief The Job struct holds the gui side of a scan
+   */
+  struct Job{
+    QString folder;
+    QSet<QString> seen;
+    int found, unchanged;
+    bool cancelled;
+  };
+
+  /**
+   * @brief start queues the first task of a new job
+   */
+  void start(const QString &folder, const QStringList &files);
+
+  /**
+   * @brief pool runs the scan tasks. It is not the global pool, so the
+   * destructor waits for these tasks only
+   */
+  QThreadPool pool;
+
+  /**
+   * @brief library is the index scans look files up in, and put them
+   * into. The tasks read it from their threads
+   */
+  LibraryIndex *library;
+  LibraryIndex memoryIndex;
+
+  QMap<int, Job> jobs;
+  int nextJob;
+
+  /**
+   * @brief generation grows with each cancel(). Tasks of an older
+   * generation stop as soon as they notice it
+   */
+  QAtomicInt generation;
+};
+
+#endif // LIBRARYSCANNER_H
@@ -0,0 +1,98 @@
+#ifndef LIBRARYTRACK_H
+#define LIBRARYTRACK_H
+
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+#include <QtNumeric>
+
+/**
+ * @brief The LibraryTrack struct describes one audio file of the music library
+ * @details The inode, modification time and size identify the version of
+ * the file that was looked at. When any of them changes, the file is
+ * looked at again; otherwise everything else here is still valid.
+ */
+struct LibraryTrack{
+  /**
+   * @brief path is the absolute path of the file
+   */
+  QString path;
+
+  /**
+   * @brief inode is the file serial number (0 where the platform has none)
+   */
+  quint64 inode;
+
+  /**
+   * @brief modified is the last modification time, in milliseconds since
+   * the epoch
+   */
+  qint64 modified;
+
+  /**
+   * @brief size is the file size in bytes
+   */
+  qint64 size;
+
+  /**
+   * @brief mimeType is the name of the sniffed mime type
+   */
+  QString mimeType;
+
+  /**
+   * @brief title, artist and album come from the tags. They are empty
+   * until the tags are read
+   */
+  QString title, artist, album;
+
+  /**
+   * @brief duration is the length in milliseconds, 0 while unknown
+   */
+  qint64 duration;
+
+  /**
+   * @brief loudness and truePeak summarize the last complete analysis of
+   * the track: its integrated loudness in LUFS and its largest true peak
+   * in dBTP. They are NaN until the track was played to its end
+   */
+  float loudness, truePeak;
+
+  /**
+   * @brief tagsRead tells the tags of this version of the file were read,
+   * whether it had any or not
+   */
+  bool tagsRead;
+
+  LibraryTrack(): inode(0), modified(0), size(0), duration(0),
+    loudness(qQNaN()), truePeak(qQNaN()), tagsRead(false){}
+
+  /**
+   * @brief sameFile tells whether two records describe the same version
+   * of a file
+   */
+  bool sameFile(const LibraryTrack &other) const{
+    return inode == other.inode && modified == other.modified && size == other.size;
+  }
+
+  /**
+   * @brief isTagged tells whether the record has tags
+   */
+  bool isTagged() const{
+    return !title.isEmpty() || !artist.isEmpty() || !album.isEmpty() || duration > 0;
+  }
+
+  /**
+   * @brief needsTags tells whether the tags of the file are still to be
+   * read. Files without tags are read once per version, not once per run
+   */
+  bool needsTags() const{
+    return !tagsRead && !isTagged();
+  }
+};
+
+typedef QVector<LibraryTrack> LibraryTrackList;
+
+Q_DECLARE_METATYPE(LibraryTrack)
+Q_DECLARE_METATYPE(LibraryTrackList)
+
+#endif // LIBRARYTRACK_H
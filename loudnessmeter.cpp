@@ -0,0 +1,314 @@
+#include "loudnessmeter.h"
+#include <cmath>
+#include <limits>
+
+// blocks are this long, in milliseconds
+#define BLOCK_MS 10
+
+// the absolute gate of ebu r128, and how far below the
+// ungated mean the relative gate is
+#define ABSOLUTE_GATE -70.0
+#define RELATIVE_GATE -10.0
+
+// kaiser window of the true peak filter
+#define TRUE_PEAK_BETA 6.0
+
+static const float SILENCE = -std::numeric_limits<float>::infinity();
+
+// the loudness of a mean square, weighted as bs.1770 says
+static float loudness(double energy){
+  return energy > 0 ? float(-0.691 + 10*log10(energy)) : SILENCE;
+}
+
+static float decibels(double amplitude){
+  return amplitude > 0 ? float(20*log10(amplitude)) : SILENCE;
+}
+
+// modified bessel function of the first kind, order zero
+static double besselI0(double x){
+  double sum = 1, term = 1;
+  for(int k=1; k<64 && term > 1e-12*sum; k++){
+    term *= (x/(2*k))*(x/(2*k));
+    sum += term;
+  }
+  return sum;
+}
+
+LoudnessMeter::LoudnessMeter(){
+  double t, x, h, sum;
+  const int taps = PHASES*PHASE_TAPS;
+
+  rate = 0;
+  channelCount = 0;
+  rmsBlocksWanted = DEFAULT_RMS_WINDOW/BLOCK_MS;
+
+  // the true peak filter is a kaiser windowed sinc with its cutoff
+  // at the nyquist frequency of the stream. phase p of output sample
+  // m interpolates at m + p/4. each phase is normalized, so a constant
+  // signal reads the same on all of them
+  for(int p=0; p<PHASES; p++){
+    sum = 0;
+    for(int k=0; k<PHASE_TAPS; k++){
+      t = (p + PHASES*k - (taps - 1)/2.0)/PHASES;
+      x = 2.0*(p + PHASES*k)/(taps - 1) - 1;
+      h = (t == 0 ? 1 : sin(PI*t)/(PI*t))*besselI0(TRUE_PEAK_BETA*sqrt(1 - x*x));
+      phaseTaps[k][p] = SpectrumReal(h);
+      sum += h;
+    }
+    for(int k=0; k<PHASE_TAPS; k++)
+      phaseTaps[k][p] = SpectrumReal(phaseTaps[k][p]/sum);
+  }
+
+  // the energy each histogram bin stands for. blocks
+  // go to the bin of their loudness rounded to 0.1 LU
+  histogram.fill(0, HISTOGRAM_BINS);
+  binEnergy.resize(HISTOGRAM_BINS);
+  for(int i=0; i<HISTOGRAM_BINS; i++)
+    binEnergy[i] = pow(10, (ABSOLUTE_GATE + i/10.0 + 0.691)/10);
+
+  configure(44100, 2);
+}
+
+void LoudnessMeter::configure(int sampleRate, int channels){
+  double k, q, vh, vb, a0;
+
+  channels = qBound(1, channels, PCM_MAX_CHANNELS);
+  if(sampleRate <= 0 || (sampleRate == rate && channels == channelCount))
+    return;
+  rate = sampleRate;
+  channelCount = channels;
+  blockFrames = qMax(1, rate*BLOCK_MS/1000);
+
+  // the k-weighting filters of bs.1770, designed for any sample
+  // rate from their analog prototypes. the first one is a high
+  // shelf of about +4 dB, the second one a high pass at 38 Hz
+  k = tan(PI*1681.974450955533/rate);
+  q = 0.7071752369554196;
+  vh = pow(10, 3.999843853973347/20);
+  vb = pow(vh, 0.4996667741545416);
+  a0 = 1 + k/q + k*k;
+  shelfB[0] = (vh + vb*k/q + k*k)/a0;
+  shelfB[1] = 2*(k*k - vh)/a0;
+  shelfB[2] = (vh - vb*k/q + k*k)/a0;
+  shelfA[0] = 1;
+  shelfA[1] = 2*(k*k - 1)/a0;
+  shelfA[2] = (1 - k/q + k*k)/a0;
+
+  k = tan(PI*38.13547087602444/rate);
+  q = 0.5003270373238773;
+  a0 = 1 + k/q + k*k;
+  passB[0] = 1;
+  passB[1] = -2;
+  passB[2] = 1;
+  passA[0] = 1;
+  passA[1] = 2*(k*k - 1)/a0;
+  passA[2] = (1 - k/q + k*k)/a0;
+
+  channelState.resize(channelCount);
+  for(int c=0; c<channelCount; c++){
+    // surround channels count a bit more, the lfe not at all
+    if(channelCount > 4 && c == 3)
+      channelState[c].weight = 0;
+    else if(channelCount > 4 && c >= 4)
+      channelState[c].weight = 1.41;
+    else
+      channelState[c].weight = 1;
+  }
+  loudnessBlocks.resize(BLOCKS);
+  rmsBlocks.resize(BLOCKS*channelCount);
+  reset();
+}
+
+void LoudnessMeter::setRmsWindow(int ms){
+  rmsBlocksWanted = qBound(1, ms/BLOCK_MS, int(BLOCKS));
+}
+
+void LoudnessMeter::reset(){
+  for(int c=0; c<channelCount; c++){
+    Channel &channel = channelState[c];
+    for(int i=0; i<4; i++)
+      channel.z[i] = 0;
+    for(int i=0; i<2*PHASE_TAPS; i++)
+      channel.history[i] = 0;
+    channel.position = 0;
+    channel.squares = 0;
+    channel.peak = channel.truePeak = 0;
+  }
+  loudnessBlocks.fill(0);
+  rmsBlocks.fill(0);
+  loudnessSum = 0;
+  framesInBlock = 0;
+  blockIndex = 0;
+  blocksFilled = 0;
+  sinceGate = 0;
+  histogram.fill(0);
+  integratedValid = false;
+  maxTruePeak = 0;
+}
+
+void LoudnessMeter::process(const SpectrumReal *samples, int frames){
+  const int channels = channelCount;
+  double x, y, weighted;
+  SpectrumReal v, *window, phase[PHASES];
+  float peak;
+
+  for(int i=0; i<frames; i++){
+    weighted = 0;
+    for(int c=0; c<channels; c++){
+      Channel &channel = channelState[c];
+      v = *samples++;
+
+      // sample peak and rms
+      channel.peak = qMax(channel.peak, float(std::fabs(v)));
+      channel.squares += double(v)*v;
+
+      // k-weighting, two biquads in transposed direct form
+      x = v;
+      y = shelfB[0]*x + channel.z[0];
+      channel.z[0] = shelfB[1]*x - shelfA[1]*y + channel.z[1];
+      channel.z[1] = shelfB[2]*x - shelfA[2]*y;
+      x = y;
+      y = passB[0]*x + channel.z[2];
+      channel.z[2] = passB[1]*x - passA[1]*y + channel.z[3];
+      channel.z[3] = passB[2]*x - passA[2]*y;
+      weighted += channel.weight*y*y;
+
+      // true peak: the newest samples, newest first, run through
+      // the interpolation filter. the phases are summed side by
+      // side, which the compiler turns into vector products
+      channel.position = channel.position == 0 ? PHASE_TAPS-1 : channel.position-1;
+      channel.history[channel.position] = v;
+      channel.history[channel.position + PHASE_TAPS] = v;
+      window = channel.history + channel.position;
+      for(int p=0; p<PHASES; p++)
+        phase[p] = 0;
+      for(int k=0; k<PHASE_TAPS; k++){
+        for(int p=0; p<PHASES; p++)
+          phase[p] += phaseTaps[k][p]*window[k];
+      }
+      peak = channel.truePeak;
+      for(int p=0; p<PHASES; p++)
+        peak = qMax(peak, float(std::fabs(phase[p])));
+      channel.truePeak = peak;
+    }
+    loudnessSum += weighted;
+
+    if(++framesInBlock == blockFrames)
+      closeBlock();
+  }
+}
+
+void LoudnessMeter::closeBlock(){
+  double energy;
+  int bin;
+
+  // the history is a ring of blocks
+  loudnessBlocks[blockIndex] = loudnessSum;
+  loudnessSum = 0;
+  for(int c=0; c<channelCount; c++){
+    rmsBlocks[c*BLOCKS + blockIndex] = channelState[c].squares;
+    channelState[c].squares = 0;
+  }
+  blockIndex = (blockIndex + 1) % BLOCKS;
+  blocksFilled = qMin(blocksFilled + 1, int(BLOCKS));
+  framesInBlock = 0;
+
+  // every 100ms, the last 400ms make a gating block. blocks
+  // below the absolute gate never count, so they are not kept
+  if(++sinceGate < GATE_STEP || blocksFilled < GATE_BLOCKS)
+    return;
+  sinceGate = 0;
+  energy = blockSum(loudnessBlocks.constData(), GATE_BLOCKS)/(GATE_BLOCKS*blockFrames);
+  if(energy <= 0 || loudness(energy) < ABSOLUTE_GATE)
+    return;
+  bin = qMin(int((loudness(energy) - ABSOLUTE_GATE)*10 + 0.5), HISTOGRAM_BINS-1);
+  histogram[bin]++;
+  integratedValid = false;
+}
+
+double LoudnessMeter::blockSum(const double *blocks, int count) const{
+  double sum;
+  int i;
+
+  // the newest block is just behind blockIndex
+  sum = 0;
+  count = qMin(count, blocksFilled);
+  i = blockIndex;
+  while(count-- > 0){
+    i = i == 0 ? BLOCKS-1 : i-1;
+    sum += blocks[i];
+  }
+  return sum;
+}
+
+float LoudnessMeter::integratedLoudness() const{
+  double energy;
+  quint64 blocks;
+  int first;
+
+  if(integratedValid)
+    return integrated;
+
+  // the mean of every block above the absolute gate
+  // sets the relative gate
+  energy = 0;
+  blocks = 0;
+  for(int i=0; i<HISTOGRAM_BINS; i++){
+    energy += histogram[i]*binEnergy[i];
+    blocks += histogram[i];
+  }
+  integrated = SILENCE;
+  if(blocks > 0){
+    // the integrated loudness is the mean of the
+    // blocks above both gates
+    first = qMax(0, int(ceil((loudness(energy/blocks) + RELATIVE_GATE - ABSOLUTE_GATE)*10)));
+    energy = 0;
+    blocks = 0;
+    for(int i=first; i<HISTOGRAM_BINS; i++){
+      energy += histogram[i]*binEnergy[i];
+      blocks += histogram[i];
+    }
+    if(blocks > 0)
+      integrated = loudness(energy/blocks);
+  }
+  integratedValid = true;
+  return integrated;
+}
+
+LoudnessReading LoudnessMeter::reading(){
+  LoudnessReading r;
+  int rmsBlocksUsed;
+
+  r.channels = channelCount;
+  rmsBlocksUsed = qMin(rmsBlocksWanted, blocksFilled);
+  for(int c=0; c<channelCount; c++){
+    Channel &channel = channelState[c];
+    // the filter rolls off a bit near nyquist. a true
+    // peak is never below the samples it goes through
+    channel.truePeak = qMax(channel.truePeak, channel.peak);
+    r.peak[c] = decibels(channel.peak);
+    r.truePeak[c] = decibels(channel.truePeak);
+    r.rms[c] = rmsBlocksUsed > 0 ?
+          decibels(sqrt(blockSum(rmsBlocks.constData() + c*BLOCKS, rmsBlocksUsed)
+                        /(rmsBlocksUsed*blockFrames))) : SILENCE;
+
+    // the peaks start over with each reading
+    maxTruePeak = qMax(maxTruePeak, channel.truePeak);
+    channel.peak = channel.truePeak = 0;
+  }
+  for(int c=channelCount; c<PCM_MAX_CHANNELS; c++){
+    r.peak[c] = r.truePeak[c] = r.rms[c] = SILENCE;
+  }
+
+  // the short-term loudness is taken over whatever
+  // there is until 3 seconds were measured
+  r.momentary = blocksFilled >= GATE_BLOCKS ?
+        loudness(blockSum(loudnessBlocks.constData(), GATE_BLOCKS)/(GATE_BLOCKS*blockFrames)) :
+        SILENCE;
+  r.shortTerm = blocksFilled >= GATE_BLOCKS ?
+        loudness(blockSum(loudnessBlocks.constData(), BLOCKS)/(blocksFilled*blockFrames)) :
+        SILENCE;
+  r.integrated = integratedLoudness();
+  r.maxTruePeak = decibels(maxTruePeak);
+  return r;
+}
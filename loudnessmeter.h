@@ -0,0 +1,213 @@
+#ifndef LOUDNESSMETER_H
+#define LOUDNESSMETER_H
+
+#include <QMetaType>
+#include <QVector>
+#include "fft.h"
+#include "pcmconvert.h"
+
+// the level bars span this many decibels below full scale
+#define METER_RANGE 60.0
+
+// the rms level is taken over this many milliseconds unless
+// told otherwise. any window from 10ms to 3s may be used
+#define DEFAULT_RMS_WINDOW 300
+
+/**
+ * @brief The LoudnessReading struct holds what the meter measured
+ * @details Levels are in decibels relative to full scale, loudness in
+ * LUFS. Silence reads -inf
+ */
+struct LoudnessReading{
+  /**
+   * @brief channels is the number of metered channels
+   */
+  int channels;
+
+  /**
+   * @brief peak is the largest sample of each channel since the last reading
+   */
+  float peak[PCM_MAX_CHANNELS];
+
+  /**
+   * @brief truePeak is the largest value of each channel since the last
+   * reading, 4x oversampled, so peaks between samples are seen too
+   */
+  float truePeak[PCM_MAX_CHANNELS];
+
+  /**
+   * @brief rms is the level of each channel over the rms window
+   */
+  float rms[PCM_MAX_CHANNELS];
+
+  /**
+   * @brief momentary, shortTerm and integrated are the EBU R128 loudness
+   * over the last 400ms, the last 3s and everything since reset()
+   */
+  float momentary, shortTerm, integrated;
+
+  /**
+   * @brief maxTruePeak is the largest true peak of any channel since reset()
+   */
+  float maxTruePeak;
+};
+
+Q_DECLARE_METATYPE(LoudnessReading)
+
+/**
+ * @brief meterPosition turns a level into a position on the level bars
+ * @return a value within [0,1]. 0 is METER_RANGE decibels below full scale
+ */
+inline double meterPosition(double db){
+  double position = 1 + db/METER_RANGE;
+  return position < 0 ? 0 : position > 1 ? 1 : position;
+}
+
+/**
+ * @brief The LoudnessMeter class measures peak, rms and loudness levels
+ * of a stream, as it is played
+ * @details Every sample goes through the K-weighting filters of ITU-R
+ * BS.1770 (a high shelf and a high pass biquad) and through a 4x
+ * oversampling polyphase filter for the true peak. Both cost the same for
+ * every sample, whatever the window lengths are.
+ *
+ * Squares are summed into blocks of 10ms. The rms level and the momentary
+ * and short-term loudness add up the last few blocks of a short history.
+ * Every 100ms the last 400ms form a gating block, which is counted in a
+ * histogram of 0.1 LU bins from -70 to +5 LUFS. The integrated loudness is
+ * read from the histogram with the absolute and relative gates of EBU R128,
+ * so it takes the same memory for a song or for a whole night.
+ *
+ * Channels 4 and 5 of streams with more than 4 channels are weighted as
+ * surround channels, and channel 3 as low frequency effects (left out),
+ * which is the usual 5.1 and 7.1 order. Only the first PCM_MAX_CHANNELS
+ * channels are metered.
+ */
+class LoudnessMeter{
+public:
+  /**
+   * @brief Creates a meter for stereo streams at 44100 Hz
+   */
+  LoudnessMeter();
+
+  /**
+   * @brief configure prepares the meter for a stream
+   * @details Nothing happens when the stream keeps its sample rate and
+   * channel count. Otherwise the meter starts over, as with reset()
+   */
+  void configure(int sampleRate, int channels);
+
+  /**
+   * @brief setRmsWindow changes the time the rms level is taken over
+   * @param ms is the window length in milliseconds. It is rounded to
+   * whole 10ms blocks
+   */
+  void setRmsWindow(int ms);
+
+  /**
+   * @brief reset forgets everything that was measured
+   */
+  void reset();
+
+  /**
+   * @brief process measures interleaved samples
+   * @param samples points to frames*channels samples within [-1,1]
+   * @param frames is the number of frames
+   */
+  void process(const SpectrumReal *samples, int frames);
+
+  /**
+   * @brief reading returns the current levels
+   * @details The sample and true peaks start over after each reading
+   */
+  LoudnessReading reading();
+
+private:
+  /**
+   * @brief BLOCKS is the length of the block history, enough for the
+   * short-term loudness. GATE_BLOCKS make a momentary (and gating) block,
+   * taken every GATE_STEP blocks
+   */
+  enum { BLOCKS = 300, GATE_BLOCKS = 40, GATE_STEP = 10 };
+
+  /**
+   * @brief The histogram spans -70 to +5 LUFS in bins of 0.1 LU
+   */
+  enum { HISTOGRAM_BINS = 750 };
+
+  /**
+   * @brief The true peak filter has PHASES phases of PHASE_TAPS taps
+   */
+  enum { PHASES = 4, PHASE_TAPS = 12 };
+
+  /**
+   * @brief The Channel struct holds the running state of one channel
+   */
+  struct Channel{
+    // the state of the two k-weighting biquads
+    double z[4];
+    // the last samples, twice, so the newest PHASE_TAPS are contiguous
+    SpectrumReal history[2*PHASE_TAPS];
+    int position;
+    // squares of the block being summed
+    double squares;
+    float peak, truePeak;
+    double weight;
+  };
+
+  /**
+   * @brief closeBlock stores the sums of a finished block
+   */
+  void closeBlock();
+
+  /**
+   * @brief blockSum adds up the last count blocks of a history
+   */
+  double blockSum(const double *blocks, int count) const;
+
+  /**
+   * @brief integratedLoudness reads the gated loudness from the histogram
+   */
+  float integratedLoudness() const;
+
+  int rate, channelCount, blockFrames, framesInBlock;
+
+  QVector<Channel> channelState;
+
+  /**
+   * @brief The coefficients of the shelf and high pass biquads
+   */
+  double shelfB[3], shelfA[3], passB[3], passA[3];
+
+  /**
+   * @brief phaseTaps holds the true peak filter, tap by tap. The taps of
+   * the four phases are side by side, so they are applied together
+   */
+  SpectrumReal phaseTaps[PHASE_TAPS][PHASES];
+
+  /**
+   * @brief loudnessBlocks holds the weighted energy of the last blocks
+   * and rmsBlocks the squares of each channel, BLOCKS apart
+   */
+  QVector<double> loudnessBlocks, rmsBlocks;
+  double loudnessSum;
+  int blockIndex, blocksFilled, sinceGate, rmsBlocksWanted;
+
+  /**
+   * @brief histogram counts the gating blocks that fell into each bin.
+   * binEnergy holds the energy at the center of each bin
+   */
+  QVector<quint32> histogram;
+  QVector<double> binEnergy;
+
+  /**
+   * @brief integrated caches the integrated loudness until the
+   * histogram changes
+   */
+  mutable float integrated;
+  mutable bool integratedValid;
+
+  float maxTruePeak;
+};
+
+#endif // LOUDNESSMETER_H
@@ -1,6 +1,18 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include <QResource>
+#include <QScrollBar>
+#include <QStandardPaths>
+#include <QActionGroup>
+#include "waterfall.h"
+#ifdef HAVE_GL_SPECTROGRAPH
+#include "glspectrograph.h"
+#endif
+
+// the channel modes, as stored in the settings
+static const char *channelModeNames[PCM_CHANNEL_MODES] = {
+  "left", "right", "mid", "side", "mid-side", "all"
+};
 
 // constructor: warm up all stuff
 MainWindow::MainWindow(QWidget *parent) :
@@ -11,13 +23,15 @@ MainWindow::MainWindow(QWidget *parent) :
   // draws the ui
   ui->setupUi(this);
 
-  // test for saving settings
+  // settings and the library index are kept under this name
   QCoreApplication::setOrganizationName("PlayerFlat");
   QSettings settings;
-  settings.setValue("alo","maria");
-
-  // defines sample size equals to spectrum size
-  sample.resize(SPECSIZE);
+  QString style, scale;
+  QActionGroup *fftSizes, *windows, *channelModes;
+  QString channels;
+  QAction *action;
+  QMenu *spectrumMenu, *menu;
+  WindowType window;
 
   // threads are as separate processes running within the same
   // program. for fft calculation, it is better to move it
@@ -32,7 +46,7 @@ MainWindow::MainWindow(QWidget *parent) :
   player = new QMediaPlayer();
 
   // starts a new playlist
-  playlist = new QMediaPlaylist();
+  playlist = new LibraryPlaylist(this);
 
   // starts the playlist model
   playlistModel = new PlaylistModel(this);
@@ -40,19 +54,74 @@ MainWindow::MainWindow(QWidget *parent) :
   // tell playlistmodel where is the playlist
   playlistModel->setPlaylist(playlist);
 
-  // attach the listView to the playlistModel
+  // attach the listView to the playlistModel. all rows have
+  // the same height, so the view does not measure each one
+  ui->listViewPlaylist->setUniformItemSizes(true);
   ui->listViewPlaylist->setModel(playlistModel);
 
   // set current index to the first element
   ui->listViewPlaylist->setCurrentIndex(playlistModel->index(playlist->currentIndex(), 0));
 
-  loadPlaylist();
+  // the library scanner looks at files in a thread pool and
+  // hands over what it finds in batches. folders come through
+  // the addFolderToLibrary signal
+  library = new LibraryIndex();
+  playlist->setLibrary(library);
+  scanner = new LibraryScanner(this);
+  connect(this, SIGNAL(addFolderToLibrary(QString)),
+          scanner, SLOT(scan(QString)));
+  connect(scanner, SIGNAL(tracksFound(LibraryTrackList)),
+          this, SLOT(addTracks(LibraryTrackList)));
+  connect(scanner, SIGNAL(tracksChanged(LibraryTrackList)),
+          this, SLOT(changeTracks(LibraryTrackList)));
+  connect(scanner, SIGNAL(tracksRemoved(QStringList)),
+          this, SLOT(removeTracks(QStringList)));
+  connect(scanner, SIGNAL(scanFinished(int,int,int)),
+          this, SLOT(scanFinished(int,int,int)));
+
+  // tags are read away from the gui thread and shown as they
+  // arrive. the rows on screen are read before anything else
+  tagReader = new TagReader(this);
+  tagReader->setIndex(library);
+  connect(tagReader, SIGNAL(tagsRead(LibraryTrackList)),
+          playlistModel, SLOT(updateTracks(LibraryTrackList)));
+  visibleTimer = new QTimer(this);
+  visibleTimer->setSingleShot(true);
+  visibleTimer->setInterval(50);
+  connect(visibleTimer, SIGNAL(timeout()), this, SLOT(readVisibleTags()));
+  connect(ui->listViewPlaylist->verticalScrollBar(), SIGNAL(valueChanged(int)),
+          visibleTimer, SLOT(start()));
+  connect(playlistModel, SIGNAL(rowsInserted(QModelIndex,int,int)),
+          visibleTimer, SLOT(start()));
+  connect(playlistModel, SIGNAL(modelReset()), visibleTimer, SLOT(start()));
+
+  // the playlist model searches and sorts the songs itself. the
+  // search runs as the user types, the sort from the playlist menu
+  connect(ui->lineEditSearch, SIGNAL(textChanged(QString)),
+          this, SLOT(search(QString)));
+  menu = ui->menuBar->addMenu(tr("Playlist"));
+  sortColumns = new QActionGroup(this);
+  for(int column=-1; column<PlaylistModel::ColumnCount; column++){
+    action = sortColumns->addAction(column < 0 ? tr("Playlist order") :
+                                    playlistModel->headerData(column, Qt::Horizontal).toString());
+    action->setCheckable(true);
+    action->setChecked(column < 0);
+    action->setData(column);
+  }
+  menu->addSection(tr("Sort by"));
+  menu->addActions(sortColumns->actions());
+  menu->addSeparator();
+  sortDescending = menu->addAction(tr("Descending"));
+  sortDescending->setCheckable(true);
+  connect(sortColumns, SIGNAL(triggered(QAction*)), this, SLOT(sortPlaylist()));
+  connect(sortDescending, SIGNAL(toggled(bool)), this, SLOT(sortPlaylist()));
 
-  // attachs the playlist to the player
-  player->setPlaylist(playlist);
+  loadPlaylist();
 
-  // playlist plays in loop mode. It restarts after last song has finished playing.
-  playlist->setPlaybackMode(QMediaPlaylist::Loop);
+  // the player plays the current song of the playlist. the
+  // playlist loops: the first song follows the last one
+  connect(playlist, SIGNAL(currentMediaChanged(QString)),
+          this, SLOT(currentMediaChanged(QString)));
 
   // this allow the user to select the media it wants to play
   connect(ui->listViewPlaylist, SIGNAL(doubleClicked(QModelIndex)),
@@ -74,6 +143,13 @@ MainWindow::MainWindow(QWidget *parent) :
   connect(player, SIGNAL(metaDataAvailableChanged(bool)),
           this, SLOT(metaDataAvailableChanged(bool)));
 
+  // the spectrum is shown when its audio is heard, so the
+  // calculator follows the position and state of the player
+  connect(player, SIGNAL(positionChanged(qint64)),
+          calculator, SLOT(setPlaybackPosition(qint64)));
+  connect(player, SIGNAL(stateChanged(QMediaPlayer::State)),
+          this, SLOT(stateChanged(QMediaPlayer::State)));
+
   // the media status changed (new stream has arrived)
   connect(player, SIGNAL(mediaStatusChanged(QMediaPlayer::MediaStatus)),
           this, SLOT(mediaStatusChanged(QMediaPlayer::MediaStatus)));
@@ -90,11 +166,6 @@ MainWindow::MainWindow(QWidget *parent) :
   // the music. It will help with fft stuff
   probe = new QAudioProbe();
 
-  // fft is delivered using a QVector<double> but
-  // signal/slot scheme does not recognizes this type by default
-  // therefore, we have to register it
-  qRegisterMetaType< QVector<double> >("QVector<double>");
-
   // here goes the control unit event handlers
   connect(ui->control, SIGNAL(playPause()), this, SLOT(playPause()));
   connect(ui->control, SIGNAL(prev()), this, SLOT(prev()));
@@ -108,18 +179,116 @@ MainWindow::MainWindow(QWidget *parent) :
   // fft goes here...
   // if a new audio buffer is ok, we have to make some
   // calcs (fft) to display the spectrum
+  // the buffers are converted and metered in a worker thread,
+  // so the gui thread only receives finished spectra and levels
   connect(probe, SIGNAL(audioBufferProbed(QAudioBuffer)),
-          this, SLOT(processBuffer(QAudioBuffer)));
+          calculator->bufferConverter(), SLOT(processBuffer(QAudioBuffer)),
+          Qt::QueuedConnection);
+
+  // the spectrum is drawn by the raster spectrograph of the
+  // ui, unless another style is selected in the settings:
+  // "waterfall" or, when built with it, "opengl"
+  visualizer = ui->visualizer;
+  style = settings.value("spectrograph/style", "bars").toString();
+  if(style == "waterfall"){
+    visualizer = new Waterfall(ui->centralWidget);
+  }
+#ifdef HAVE_GL_SPECTROGRAPH
+  else if(style == "opengl"){
+    visualizer = new GLSpectrograph(ui->centralWidget);
+  }
+#endif
+  if(visualizer != ui->visualizer){
+    ui->verticalLayout_2->replaceWidget(ui->visualizer, visualizer);
+    ui->visualizer->hide();
+  }
 
-  // when fft is available, we deliver it to
-  // the visualization widget
-  connect(this,  SIGNAL(spectrumChanged(QVector<double>&)),
-          ui->visualizer,SLOT(loadSamples(QVector<double>&)));
+  // the analyzer folds the spectrum into the bands the widget
+  // draws. scales: "log", "linear", "mel", "bark" or "third-octave"
+  scale = settings.value("spectrograph/scale", "log").toString();
+  calculator->setBands(settings.value("spectrograph/bands", NUMBANDS).toInt(),
+                       scale == "linear" ? SCALE_LINEAR :
+                       scale == "mel" ? SCALE_MEL :
+                       scale == "bark" ? SCALE_BARK :
+                       scale == "third-octave" ? SCALE_THIRD_OCTAVE : SCALE_LOG);
+
+  // the fft size trades frequency resolution for time
+  // resolution. it is kept in the settings and may be changed
+  // from the spectrum menu while playing
+  calculator->setFftSize(settings.value("spectrum/fftSize", DEFAULTFFTSIZE).toInt());
+  spectrumMenu = ui->menuBar->addMenu(tr("Spectrum"));
+  menu = spectrumMenu->addMenu(tr("FFT size"));
+  fftSizes = new QActionGroup(this);
+  for(int size=MINFFTSIZE; size<=MAXFFTSIZE; size*=2){
+    action = fftSizes->addAction(QString::number(size));
+    action->setCheckable(true);
+    action->setChecked(size == calculator->fftSize());
+    action->setData(size);
+  }
+  menu->addActions(fftSizes->actions());
+  connect(fftSizes, SIGNAL(triggered(QAction*)),
+          this, SLOT(setFftSize(QAction*)));
+
+  // so is the window function
+  window = windowType(settings.value("spectrum/window", "hann").toString());
+  calculator->setWindow(window);
+  menu = spectrumMenu->addMenu(tr("Window"));
+  windows = new QActionGroup(this);
+  for(int i=0; i<WINDOW_TYPES; i++){
+    action = windows->addAction(windowName(WindowType(i)));
+    action->setCheckable(true);
+    action->setChecked(i == window);
+    action->setData(i);
+  }
+  menu->addActions(windows->actions());
+  connect(windows, SIGNAL(triggered(QAction*)),
+          this, SLOT(setWindowFunction(QAction*)));
+
+  // and so are the analyzed channels. two streams (left and
+  // right, or mid and side) are drawn apart by the spectrograph
+  channels = settings.value("spectrum/channels", "left").toString();
+  menu = spectrumMenu->addMenu(tr("Channels"));
+  channelModes = new QActionGroup(this);
+  for(int i=0; i<PCM_CHANNEL_MODES; i++){
+    action = channelModes->addAction(channelModeNames[i]);
+    action->setCheckable(true);
+    action->setChecked(channels == channelModeNames[i]);
+    action->setData(i);
+    if(action->isChecked())
+      calculator->setChannelMode(PcmChannelMode(i));
+  }
+  menu->addActions(channelModes->actions());
+  connect(channelModes, SIGNAL(triggered(QAction*)),
+          this, SLOT(setChannelMode(QAction*)));
+
+  // the decibels are approximated unless the exact ones are asked for
+  action = spectrumMenu->addAction(tr("Fast decibels"));
+  action->setCheckable(true);
+  action->setChecked(settings.value("spectrum/approximate", true).toBool());
+  calculator->setApproximate(action->isChecked());
+  connect(action, SIGNAL(toggled(bool)), this, SLOT(setApproximate(bool)));
+
+  // the visualization widget reads each new spectrum straight
+  // from the calculator. no signal carries the data
+  visualizer->setSpectrumSource(calculator->spectrumFrames());
+
+  // the widget stops polling when there is nothing to animate.
+  // this signal wakes it up when the next spectrum arrives
+  connect(calculator, SIGNAL(spectrumReady()),
+          visualizer, SLOT(spectrumReady()));
 
   // communicate the left and right audio levels...
-  // ...mean levels
-  connect(this,  SIGNAL(levels(double,double)),
-          ui->visualizer,SLOT(loadLevels(double,double)));
+  // ...rms levels and true peaks
+  connect(calculator,  SIGNAL(levels(double,double)),
+          visualizer,SLOT(loadLevels(double,double)));
+  connect(calculator,  SIGNAL(peaks(double,double)),
+          visualizer,SLOT(loadPeaks(double,double)));
+
+  // the loudness goes to the status bar. the rms window
+  // may be changed in the settings, in milliseconds
+  calculator->setRmsWindow(settings.value("meter/rmsWindow", DEFAULT_RMS_WINDOW).toInt());
+  connect(calculator, SIGNAL(loudness(LoudnessReading)),
+          this, SLOT(showLoudness(LoudnessReading)));
 
   // if the user selected a new position on stream to play
   // we have to tell it to the player
@@ -130,12 +299,6 @@ MainWindow::MainWindow(QWidget *parent) :
   connect(ui->control, SIGNAL(volumeSelected(int)),
           player, SLOT(setVolume(int)));
 
-  // calculator is the thead that calcs the ffts we need to display
-  // every time a new spectrum is available, the calculator
-  // emits a calculatedSpectrum signal
-  connect(calculator, SIGNAL(calculatedSpectrum(QVector<double>)),
-          this, SLOT(spectrumAvailable(QVector<double>)));
-
   // tells the probe what to probe
   probe->setSource(player);
   QDirIterator it(":", QDirIterator::Subdirectories);
@@ -151,7 +314,9 @@ MainWindow::MainWindow(QWidget *parent) :
   QFile::copy(":/resources/audiosample.mp3" , defaultAudioFile);
 
   // adds the audio file to playlist
-  playlist->addMedia(QUrl::fromLocalFile(defaultAudioFile));
+  playlist->addMedia(defaultAudioFile);
+  if(playlist->currentIndex() < 0)
+    playlist->setCurrentIndex(0);
   player->play();
 
 }
@@ -159,107 +324,41 @@ MainWindow::MainWindow(QWidget *parent) :
 // what to do when user select a new song to play
 void MainWindow::goToItem(const QModelIndex &index){
   if (index.isValid()) {
-    playlist->setCurrentIndex(index.row());
+    playlist->setCurrentIndex(playlistModel->playlistPosition(index.row()));
     player->play();
   }
 }
 
-// prepares the playlist to display the media to be played
-// it should be stored into a file with settings.
-// I will let this to a far future
+// prepares the playlist to display the media to be played.
+// the library of the last run is read back from its index,
+// in the application data folder. the index is mapped, not
+// parsed, and the playlist reads the songs from it as they
+// are shown, so this is quick however large the library is
 void MainWindow::loadPlaylist(void){
+  QString folder;
+
+  // AppDataLocation came with qt 5.4. DataLocation, which
+  // it replaces, is the same folder before that
+#if QT_VERSION >= QT_VERSION_CHECK(5, 4, 0)
+  folder = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+#else
+  folder = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
+#endif
+  QDir().mkpath(folder);
+  if(!library->open(folder + "/library.index"))
+    ui->statusBar->showMessage(tr("The library index could not be opened. "
+                                  "Changes will not be kept"), 5000);
+
+  // scans only open the files that changed since
+  scanner->setIndex(library);
+  playlist->loadLibrary();
+
+  // the songs without tags are read when nothing is on screen to read
+  tagReader->readLibrary();
 }
 
 void MainWindow::onAddMediaToPlayList(QString media){
-  playlist->addMedia(QUrl::fromLocalFile(media));
-}
-
-// process audio buffer for fft calculations
-void MainWindow::processBuffer(QAudioBuffer buffer){
-  qreal peakValue;
-  int duration;
-
-  if(buffer.frameCount() < 512)
-    return;
-
-  // return left and right audio mean levels
-  levelLeft = levelRight = 0;
-  // It only knows how to process stereo audio frames
-  // mono frames = :P
-  if(buffer.format().channelCount() != 2)
-    return;
-
-  sample.resize(buffer.frameCount());
-  // audio is signed int
-  if(buffer.format().sampleType() == QAudioFormat::SignedInt){
-    QAudioBuffer::S16S *data = buffer.data<QAudioBuffer::S16S>();
-    // peak value changes according to sample size.
-    if (buffer.format().sampleSize() == 32)
-      peakValue=INT_MAX;
-    else if (buffer.format().sampleSize() == 16)
-      peakValue=SHRT_MAX;
-    else
-      peakValue=CHAR_MAX;
-
-    // scale everything to [0,1]
-    for(int i=0; i<buffer.frameCount(); i++){
-      // for visualization purposes, we only need one of the
-      // left/right channels
-      sample[i] = data[i].left/peakValue;
-      levelLeft+= abs(data[i].left)/peakValue;
-      levelRight+= abs(data[i].right)/peakValue;
-    }
-  }
-
-  // audio is unsigned int
-  else if(buffer.format().sampleType() == QAudioFormat::UnSignedInt){
-    QAudioBuffer::S16U *data = buffer.data<QAudioBuffer::S16U>();
-    if (buffer.format().sampleSize() == 32)
-      peakValue=UINT_MAX;
-    else if (buffer.format().sampleSize() == 16)
-      peakValue=USHRT_MAX;
-    else
-      peakValue=UCHAR_MAX;
-    for(int i=0; i<buffer.frameCount(); i++){
-      sample[i] = data[i].left/peakValue;
-      levelLeft+= abs(data[i].left)/peakValue;
-      levelRight+= abs(data[i].right)/peakValue;
-    }
-  }
-
-  // audio is float type
-  else if(buffer.format().sampleType() == QAudioFormat::Float){
-    QAudioBuffer::S32F *data = buffer.data<QAudioBuffer::S32F>();
-    peakValue = 1.00003;
-    for(int i=0; i<buffer.frameCount(); i++){
-      sample[i] = data[i].left/peakValue;
-      // test if sample[i] is infinity (it works)
-      // some tests produced infinity values :p
-      if(sample[i] != sample[i]){
-        sample[i] = 0;
-      }
-      else{
-        levelLeft+= abs(data[i].left)/peakValue;
-        levelRight+= abs(data[i].right)/peakValue;
-      }
-    }
-  }
-  // if the probe is listening to the audio
-  // do fft calculations
-  // when it is done, calculator will tell us
-  if(probe->isActive()){
-    duration = buffer.format().durationForBytes(buffer.frameCount())/1000;
-    calculator->calc(sample, duration);
-  }
-  // tells anyone interested about left and right mean levels
-  emit levels(levelLeft/buffer.frameCount(),levelRight/buffer.frameCount());
-}
-
-// what to do when fft spectrum is available
-void MainWindow::spectrumAvailable(QVector<double> spectrum){
-  // just tell the spectrum
-  // the visualization widget will catch the signal...
-  emit spectrumChanged(spectrum);
+  playlist->addMedia(media);
 }
 
 // destructor... clear all mess
@@ -267,6 +366,12 @@ MainWindow::~MainWindow(){
   //stops the player
   player->stop();
 
+  // the scan and tag tasks use the index until they stop.
+  // then the index writes what changed into its snapshot
+  delete scanner;
+  delete tagReader;
+  delete library;
+
   // wait for the calculator to stop
   delete calculator;
 
@@ -276,12 +381,6 @@ MainWindow::~MainWindow(){
 
 // load a new media selected by the user
 void MainWindow::loadMedia(){
-  // mime database to detect file type
-  QMimeDatabase db;
-
-  // the mime type (to test if it is an audio file
-  QMimeType type;
-
   // file list to be inserted into playlist
   QStringList filelist;
 
@@ -291,22 +390,99 @@ void MainWindow::loadMedia(){
                                 "/home",
                                 tr("Audio (*.wav *.mp3 *.ogg *.flac)"));
 
-  // retrieve mime type
-  for(QList<QString>::const_iterator it=filelist.begin(); it!= filelist.end(); it++){
-    type = db.mimeTypeForFile(*it);
-    // test if the file is an audio file
-    // if yes, send it to the playlist
-    if(type.name().startsWith("audio")){
-      playlist->addMedia(QUrl::fromLocalFile(*it));
-    }
+  // the scanner tells which ones are audio files, away from
+  // the gui thread. they arrive through addTracks()
+  scanner->addFiles(filelist);
+}
+
+// the user wants a whole folder in the library
+void MainWindow::addFolder(){
+  QString folder;
+
+  folder = QFileDialog::getExistingDirectory(this, tr("Add folder"), QDir::homePath());
+  if(!folder.isEmpty())
+    emit addFolderToLibrary(folder);
+}
+
+// the scanner found new audio files. each batch
+// is inserted into the playlist at once
+void MainWindow::addTracks(LibraryTrackList tracks){
+  QStringList paths;
+
+  for(int i=0; i<tracks.size(); i++)
+    paths.append(tracks[i].path);
+  playlist->addMedia(paths);
+  readTagsLater(tracks);
+}
+
+// files of the library changed. their records start over,
+// without tags, so the tags are read again
+void MainWindow::changeTracks(LibraryTrackList tracks){
+  playlistModel->updateTracks(tracks);
+  readTagsLater(tracks);
+}
+
+// the tags of new or changed songs are read when
+// nothing is on screen to read
+void MainWindow::readTagsLater(const LibraryTrackList &tracks){
+  QStringList untagged;
+
+  for(int i=0; i<tracks.size(); i++){
+    if(tracks[i].needsTags())
+      untagged.append(tracks[i].path);
   }
+  if(!untagged.isEmpty())
+    tagReader->readLater(untagged);
+}
+
+// the user scrolled the playlist, or rows came in. the tags
+// of the rows on screen are read before any other
+void MainWindow::readVisibleTags(){
+  QListView *view = ui->listViewPlaylist;
+  QModelIndex first, last;
+  QStringList paths;
+  int lastRow;
+
+  first = view->indexAt(QPoint(0, 0));
+  if(!first.isValid())
+    return;
+  last = view->indexAt(QPoint(0, view->viewport()->height() - 1));
+  lastRow = last.isValid() ? last.row() : playlistModel->rowCount() - 1;
+  for(int row=first.row(); row<=lastRow; row++)
+    paths.append(playlistModel->data(playlistModel->index(row, PlaylistModel::Path)).toString());
+  tagReader->readNow(paths);
+}
+
+// the user typed in the search box. the song playing
+// stays selected when it is among the songs found
+void MainWindow::search(QString text){
+  playlistModel->setFilter(text);
+  ui->listViewPlaylist->setCurrentIndex(playlistModel->indexOfPosition(playlist->currentIndex()));
+}
+
+// the user picked a sort column, or a direction
+void MainWindow::sortPlaylist(){
+  playlistModel->sort(sortColumns->checkedAction()->data().toInt(),
+                      sortDescending->isChecked() ? Qt::DescendingOrder : Qt::AscendingOrder);
+  ui->listViewPlaylist->setCurrentIndex(playlistModel->indexOfPosition(playlist->currentIndex()));
+}
+
+// files of the library are gone
+void MainWindow::removeTracks(QStringList paths){
+  playlist->removePaths(paths);
+}
+
+// a scan is over
+void MainWindow::scanFinished(int found, int unchanged, int removed){
+  ui->statusBar->showMessage(tr("%1 new or changed, %2 unchanged, %3 removed")
+                             .arg(found).arg(unchanged).arg(removed), 5000);
 }
 
 // play the previous song
 void MainWindow::prev(){
     playlist->previous();
     // adjust the current music playing on listview
-    ui->listViewPlaylist->setCurrentIndex(playlistModel->index(playlist->currentIndex(), 0));
+    ui->listViewPlaylist->setCurrentIndex(playlistModel->indexOfPosition(playlist->currentIndex()));
 
 }
 
@@ -314,7 +490,7 @@ void MainWindow::prev(){
 void MainWindow::next(){
     playlist->next();
     // adjust the current music playing on listview
-    ui->listViewPlaylist->setCurrentIndex(playlistModel->index(playlist->currentIndex(), 0));
+    ui->listViewPlaylist->setCurrentIndex(playlistModel->indexOfPosition(playlist->currentIndex()));
 }
 
 // forward/rewind the song within mainwindow
@@ -336,10 +512,87 @@ void MainWindow::slotPositionChanged(qint64 e){
   ui->control->onElapsedChanged(100*e/player->duration());
 }
 
+// the user picked a new fft size in the spectrum menu
+void MainWindow::setFftSize(QAction *action){
+  QSettings settings;
+  calculator->setFftSize(action->data().toInt());
+  settings.setValue("spectrum/fftSize", calculator->fftSize());
+}
+
+// the user picked a new window function in the spectrum menu
+void MainWindow::setWindowFunction(QAction *action){
+  QSettings settings;
+  calculator->setWindow(WindowType(action->data().toInt()));
+  settings.setValue("spectrum/window", windowName(WindowType(action->data().toInt())));
+}
+
+// the user switched between approximate and exact decibels
+void MainWindow::setApproximate(bool approximate){
+  QSettings settings;
+  calculator->setApproximate(approximate);
+  settings.setValue("spectrum/approximate", approximate);
+}
+
+// the user picked the channels to analyze in the spectrum menu
+void MainWindow::setChannelMode(QAction *action){
+  QSettings settings;
+  calculator->setChannelMode(PcmChannelMode(action->data().toInt()));
+  settings.setValue("spectrum/channels", channelModeNames[action->data().toInt()]);
+}
+
+// the meter sent a new reading
+void MainWindow::showLoudness(LoudnessReading reading){
+  lastLoudness = reading;
+  ui->statusBar->showMessage(tr("M %1  S %2  I %3 LUFS   true peak %4 dBTP")
+                             .arg(reading.momentary, 0, 'f', 1)
+                             .arg(reading.shortTerm, 0, 'f', 1)
+                             .arg(reading.integrated, 0, 'f', 1)
+                             .arg(reading.maxTruePeak, 0, 'f', 1));
+}
+
+// the player started, paused or stopped
+void MainWindow::stateChanged(QMediaPlayer::State state){
+  calculator->setPlaying(state == QMediaPlayer::PlayingState);
+}
+
 // new song arriving
 void MainWindow::mediaStatusChanged(QMediaPlayer::MediaStatus status){
-  Q_UNUSED(status);
   ui->control->onDurationChanged(player->duration());
+
+  // the integrated loudness is measured song by song.
+  // songs played to their end keep it in the library
+  if(status == QMediaPlayer::LoadedMedia){
+    calculator->resetLoudness();
+    lastLoudness.integrated = lastLoudness.maxTruePeak = qQNaN();
+    analyzedPath = player->currentMedia().canonicalUrl().toLocalFile();
+  }
+  if(status == QMediaPlayer::EndOfMedia && !analyzedPath.isEmpty() &&
+     !qIsNaN(lastLoudness.integrated)){
+    library->setAnalysis(analyzedPath, lastLoudness.integrated, lastLoudness.maxTruePeak);
+    analyzedPath.clear();
+  }
+
+  // then the next song plays. a playlist of one song
+  // plays it again
+  if(status == QMediaPlayer::EndOfMedia){
+    playlist->next();
+    player->play();
+  }
+}
+
+// another song of the playlist is the current one. it
+// plays if the last one was playing
+void MainWindow::currentMediaChanged(QString path){
+  bool playing;
+
+  playing = player->state() == QMediaPlayer::PlayingState;
+  if(path.isEmpty()){
+    player->setMedia(QMediaContent());
+    return;
+  }
+  player->setMedia(QUrl::fromLocalFile(path));
+  if(playing)
+    player->play();
 }
 
 // this is for windows compilations
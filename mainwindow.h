@@ -2,6 +2,7 @@
 #define MAINWINDOW_H
 
 //#include <climits>
+#include <QActionGroup>
 #include <QAudioBuffer>
 #include <QAudioDeviceInfo>
 #include <QAudioInput>
@@ -14,19 +15,22 @@
 #include <QIODevice>
 #include <QMainWindow>
 #include <QMediaMetaData>
-#include <QMediaPlaylist>
 #include <QMessageBox>
 #include <QMimeDatabase>
 #include <QSettings>
 #include <QStandardItemModel>
 #include <QString>
+#include <QTimer>
 #include <QtMultimedia>
 #include <QtMultimedia/QMediaPlayer>
 #include <QUrl>
 #include <QVector>
 
+#include "abstractspectrograph.h"
 #include "fftcalc.h"
 #include "playlistmodel.h"
+#include "libraryscanner.h"
+#include "tagreader.h"
 
 namespace Ui {
 class MainWindow;
@@ -52,18 +56,31 @@ public slots:
   //
     void goToItem(const QModelIndex &index);
     void loadMedia();
+    void addFolder();
     void loadPlaylist();
     void onAddMediaToPlayList(QString media);
     void mediaStatusChanged(QMediaPlayer::MediaStatus status);
+    void currentMediaChanged(QString path);
     void metaDataChanged();
     void next();
     void playPause();
     void slotPositionChanged(qint64 e);
+    void stateChanged(QMediaPlayer::State state);
     void prev();
-    void processBuffer(QAudioBuffer buffer);
     void setMediaAt(qint32 percent);
     void setVolume(int volume);
-    void spectrumAvailable(QVector<double> spectrum);
+    void setFftSize(QAction *action);
+    void setWindowFunction(QAction *action);
+    void setApproximate(bool approximate);
+    void setChannelMode(QAction *action);
+    void showLoudness(LoudnessReading reading);
+    void addTracks(LibraryTrackList tracks);
+    void changeTracks(LibraryTrackList tracks);
+    void removeTracks(QStringList paths);
+    void scanFinished(int found, int unchanged, int removed);
+    void readVisibleTags();
+    void search(QString text);
+    void sortPlaylist();
     void metaDataAvailableChanged(bool);
 private:
     // User interface widget
@@ -73,7 +90,7 @@ private:
     QMediaPlayer *player;
 
     // stores the playlist
-    QMediaPlaylist *playlist;
+    LibraryPlaylist *playlist;
 
     // audio info... we do not use it
     QAudioDeviceInfo audioInfo;
@@ -87,33 +104,44 @@ private:
     // a fft calculator object
     FFTCalc *calculator;
 
+    // the widget that displays the spectrum
+    AbstractSpectrograph *visualizer;
+
     // item model to design the playlist into mainwindow
     QStandardItemModel *model;
 
     // each item to be displayed in playlist
     QStandardItem *item;
 
-    // input sample to fft calc
-    QVector<double> sample;
+    PlaylistModel *playlistModel;
 
-    // output vector with spectrum
-    QVector<double> spectrum;
+    // finds the audio files of the library folders
+    LibraryScanner *scanner;
 
-    PlaylistModel *playlistModel;
+    // keeps the library between runs
+    LibraryIndex *library;
 
-    // left and right mean levels
-    double levelLeft, levelRight;
-signals:
-    // telle a new buffer from audio prober
-    int spectrumChanged(QVector<double> &sample);
+    // reads the tags of the songs, the ones on screen first.
+    // the timer gathers scrolling into a single request
+    TagReader *tagReader;
+    QTimer *visibleTimer;
 
+    // the column the playlist is sorted by, and its direction
+    QActionGroup *sortColumns;
+    QAction *sortDescending;
+
+    // the last loudness reading of the current song, and its file.
+    // it goes to the library when the song plays to its end
+    LoudnessReading lastLoudness;
+    QString analyzedPath;
+
+    // queues the songs whose tags were never read
+    void readTagsLater(const LibraryTrackList &tracks);
+signals:
     // music position changed by user. Tell
     // new position to the player
     int positionChanged(qint64 position);
 
-    // tells the new left and right mean audio levels
-    int levels(double left, double right);
-
     // tells the duration of media
     // when a new media is played
     int elapsedTimeChanged(qint64 elapsed);
@@ -0,0 +1,374 @@
+#include "pcmconvert.h"
+#include <cstring>
+
+// same rules as the fft kernels: vector code is only built for
+// x86 with gcc or clang, and each function picks its own
+// instruction set through the target attribute
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+PcmSampleFormat pcmSampleFormat(const QAudioFormat &format){
+  if(format.byteOrder() != QAudioFormat::LittleEndian)
+    return PCM_UNSUPPORTED;
+
+  switch(format.sampleType()){
+  case QAudioFormat::SignedInt:
+    switch(format.sampleSize()){
+    case 8: return PCM_S8;
+    case 16: return PCM_S16;
+    case 24: return PCM_S24;
+    case 32: return PCM_S32;
+    }
+    break;
+  case QAudioFormat::UnSignedInt:
+    switch(format.sampleSize()){
+    case 8: return PCM_U8;
+    case 16: return PCM_U16;
+    case 32: return PCM_U32;
+    }
+    break;
+  case QAudioFormat::Float:
+    if(format.sampleSize() == 32)
+      return PCM_F32;
+    break;
+  default:
+    break;
+  }
+  return PCM_UNSUPPORTED;
+}
+
+// bytes taken by one sample of each format
+static const int sampleBytes[PCM_FORMATS] = { 1, 1, 2, 2, 3, 4, 4, 4 };
+
+/*
+ * scalar kernels: they read any format, and are the
+ * reference for the vector ones
+ */
+
+// reads sample i and scales it to [-1,1]. F is a
+// constant, so only one branch is left in each kernel
+template <int F>
+static inline float readSample(const uchar *p, int i){
+  if(F == PCM_U8)
+    return (int(p[i]) - 128) * (1.0f/128);
+  if(F == PCM_S8)
+    return qint8(p[i]) * (1.0f/128);
+  if(F == PCM_U16)
+    return (int(reinterpret_cast<const quint16*>(p)[i]) - 32768) * (1.0f/32768);
+  if(F == PCM_S16)
+    return reinterpret_cast<const qint16*>(p)[i] * (1.0f/32768);
+  if(F == PCM_S24){
+    // packed in 3 bytes. the sign is extended by the shift
+    const uchar *s = p + 3*i;
+    return (qint32(quint32(s[0]) << 8 | quint32(s[1]) << 16 | quint32(s[2]) << 24) >> 8)
+        * (1.0f/8388608);
+  }
+  if(F == PCM_U32)
+    return qint32(reinterpret_cast<const quint32*>(p)[i] ^ 0x80000000u) * (1.0f/2147483648.0f);
+  if(F == PCM_S32)
+    return reinterpret_cast<const qint32*>(p)[i] * (1.0f/2147483648.0f);
+
+  // x-x is not zero for infinities and nans. some
+  // decoders produce them, they are muted here
+  float x = reinterpret_cast<const float*>(p)[i];
+  return (x - x == 0) ? x : 0;
+}
+
+template <int F>
+static void convertScalar(const void *in, int count, SpectrumReal *out){
+  const uchar *p = static_cast<const uchar*>(in);
+
+  for(int i=0; i<count; i++)
+    out[i] = readSample<F>(p, i);
+}
+
+#ifdef SIMD_X86
+
+/*
+ * sse2 kernels: four samples per register. the samples are
+ * converted in the order they come, so every format is
+ * vectorized whatever the channel count
+ */
+
+// loads samples i to i+3 scaled to [-1,1]
+template <int F>
+__attribute__((target("sse2")))
+static inline __m128 loadSSE2(const uchar *p, int i){
+  if(F == PCM_U8){
+    qint32 bytes;
+    memcpy(&bytes, p + i, 4);
+    __m128i v = _mm_cvtsi32_si128(bytes);
+    v = _mm_unpacklo_epi8(v, _mm_setzero_si128());
+    v = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+    v = _mm_sub_epi32(v, _mm_set1_epi32(128));
+    return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f/128));
+  }
+  if(F == PCM_S8){
+    qint32 bytes;
+    memcpy(&bytes, p + i, 4);
+    __m128i v = _mm_cvtsi32_si128(bytes);
+    // each byte goes to the top of a 32 bit lane,
+    // the arithmetic shift extends its sign
+    v = _mm_unpacklo_epi8(v, v);
+    v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 24);
+    return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f/128));
+  }
+  if(F == PCM_U16){
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 2*i));
+    v = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+    v = _mm_sub_epi32(v, _mm_set1_epi32(32768));
+    return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f/32768));
+  }
+  if(F == PCM_S16){
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 2*i));
+    // each sample goes to the upper half of a 32 bit lane,
+    // the arithmetic shift extends its sign
+    v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f/32768));
+  }
+  if(F == PCM_S24){
+    // sse2 cannot shuffle bytes. the samples are put
+    // together in general registers, on top of the lanes
+    const uchar *s = p + 3*i;
+    __m128i v = _mm_setr_epi32(
+          qint32(quint32(s[0]) << 8 | quint32(s[1]) << 16 | quint32(s[2]) << 24),
+          qint32(quint32(s[3]) << 8 | quint32(s[4]) << 16 | quint32(s[5]) << 24),
+          qint32(quint32(s[6]) << 8 | quint32(s[7]) << 16 | quint32(s[8]) << 24),
+          qint32(quint32(s[9]) << 8 | quint32(s[10]) << 16 | quint32(s[11]) << 24));
+    v = _mm_srai_epi32(v, 8);
+    return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f/8388608));
+  }
+  if(F == PCM_U32 || F == PCM_S32){
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 4*i));
+    // flipping the top bit makes unsigned samples signed
+    if(F == PCM_U32)
+      v = _mm_xor_si128(v, _mm_set1_epi32(qint32(0x80000000u)));
+    return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f/2147483648.0f));
+  }
+  // float: infinities and nans are muted
+  __m128 x = _mm_loadu_ps(reinterpret_cast<const float*>(p) + i);
+  return _mm_and_ps(x, _mm_cmpeq_ps(_mm_sub_ps(x, x), _mm_setzero_ps()));
+}
+
+__attribute__((target("sse2")))
+static inline void storeSSE2(float *out, __m128 x){
+  _mm_storeu_ps(out, x);
+}
+
+__attribute__((target("sse2")))
+static inline void storeSSE2(double *out, __m128 x){
+  _mm_storeu_pd(out, _mm_cvtps_pd(x));
+  _mm_storeu_pd(out+2, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+}
+
+template <int F>
+__attribute__((target("sse2")))
+static void convertSSE2(const void *in, int count, SpectrumReal *out){
+  const uchar *p = static_cast<const uchar*>(in);
+  int i = 0;
+
+  for(; i+4<=count; i+=4)
+    storeSSE2(out+i, loadSSE2<F>(p, i));
+
+  // the last samples
+  convertScalar<F>(p + i*sampleBytes[F], count-i, out+i);
+}
+
+/*
+ * avx2 kernels: eight samples per register
+ */
+
+// loads samples i to i+7 scaled to [-1,1]
+template <int F>
+__attribute__((target("avx2")))
+static inline __m256 loadAVX2(const uchar *p, int i){
+  if(F == PCM_U8){
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + i));
+    __m256i w = _mm256_sub_epi32(_mm256_cvtepu8_epi32(v), _mm256_set1_epi32(128));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(w), _mm256_set1_ps(1.0f/128));
+  }
+  if(F == PCM_S8){
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + i));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(v)),
+                         _mm256_set1_ps(1.0f/128));
+  }
+  if(F == PCM_U16){
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2*i));
+    __m256i w = _mm256_sub_epi32(_mm256_cvtepu16_epi32(v), _mm256_set1_epi32(32768));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(w), _mm256_set1_ps(1.0f/32768));
+  }
+  if(F == PCM_S16){
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2*i));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)),
+                         _mm256_set1_ps(1.0f/32768));
+  }
+  if(F == PCM_S24){
+    // four samples take 12 bytes of each half. the shuffle
+    // puts each one on top of its lane, the shift extends
+    // the sign. the loads read 4 bytes past the 8 samples
+    const __m128i *s = reinterpret_cast<const __m128i*>(p + 3*i);
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(s)),
+                                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 3*i + 12)), 1);
+    const __m256i order = _mm256_setr_epi8(
+          -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+          -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    v = _mm256_srai_epi32(_mm256_shuffle_epi8(v, order), 8);
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(1.0f/8388608));
+  }
+  if(F == PCM_U32 || F == PCM_S32){
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 4*i));
+    if(F == PCM_U32)
+      v = _mm256_xor_si256(v, _mm256_set1_epi32(qint32(0x80000000u)));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(1.0f/2147483648.0f));
+  }
+  __m256 x = _mm256_loadu_ps(reinterpret_cast<const float*>(p) + i);
+  return _mm256_and_ps(x, _mm256_cmp_ps(_mm256_sub_ps(x, x), _mm256_setzero_ps(), _CMP_EQ_OQ));
+}
+
+__attribute__((target("avx2")))
+static inline void storeAVX2(float *out, __m256 x){
+  _mm256_storeu_ps(out, x);
+}
+
+__attribute__((target("avx2")))
+static inline void storeAVX2(double *out, __m256 x){
+  _mm256_storeu_pd(out, _mm256_cvtps_pd(_mm256_castps256_ps128(x)));
+  _mm256_storeu_pd(out+4, _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)));
+}
+
+template <int F>
+__attribute__((target("avx2")))
+static void convertAVX2(const void *in, int count, SpectrumReal *out){
+  const uchar *p = static_cast<const uchar*>(in);
+  int i = 0;
+
+  // packed 24 bit samples are read past the last one,
+  // so the loop stops two samples earlier for them
+  const int over = F == PCM_S24 ? 2 : 0;
+
+  for(; i+8+over<=count; i+=8)
+    storeAVX2(out+i, loadAVX2<F>(p, i));
+
+  // the sse2 kernel takes the last samples
+  convertSSE2<F>(p + i*sampleBytes[F], count-i, out+i);
+}
+
+#endif // SIMD_X86
+
+static const PcmKernels kernelTable[] = {
+  { SIMD_SCALAR, "scalar",
+    { convertScalar<PCM_U8>, convertScalar<PCM_S8>, convertScalar<PCM_U16>,
+      convertScalar<PCM_S16>, convertScalar<PCM_S24>, convertScalar<PCM_U32>,
+      convertScalar<PCM_S32>, convertScalar<PCM_F32> } },
+#ifdef SIMD_X86
+  { SIMD_SSE2, "sse2",
+    { convertSSE2<PCM_U8>, convertSSE2<PCM_S8>, convertSSE2<PCM_U16>,
+      convertSSE2<PCM_S16>, convertSSE2<PCM_S24>, convertSSE2<PCM_U32>,
+      convertSSE2<PCM_S32>, convertSSE2<PCM_F32> } },
+  { SIMD_AVX2, "avx2",
+    { convertAVX2<PCM_U8>, convertAVX2<PCM_S8>, convertAVX2<PCM_U16>,
+      convertAVX2<PCM_S16>, convertAVX2<PCM_S24>, convertAVX2<PCM_U32>,
+      convertAVX2<PCM_S32>, convertAVX2<PCM_F32> } },
+  // conversion is bound by memory. avx2 is good enough for it
+  { SIMD_AVX512, "avx512",
+    { convertAVX2<PCM_U8>, convertAVX2<PCM_S8>, convertAVX2<PCM_U16>,
+      convertAVX2<PCM_S16>, convertAVX2<PCM_S24>, convertAVX2<PCM_U32>,
+      convertAVX2<PCM_S32>, convertAVX2<PCM_F32> } },
+#endif
+};
+
+const PcmKernels &pcmKernels(SimdLevel level){
+  if(level > simdLevel())
+    level = simdLevel();
+  return kernelTable[level];
+}
+
+const PcmKernels &pcmKernels(){
+  static const PcmKernels &kernels = pcmKernels(simdLevel());
+  return kernels;
+}
+
+int pcmStreams(PcmChannelMode mode, int channels){
+  switch(mode){
+  case PCM_MID_SIDE:
+    return 2;
+  case PCM_ALL_CHANNELS:
+    return qBound(1, channels, PCM_MAX_CHANNELS);
+  default:
+    return 1;
+  }
+}
+
+bool pcmConvertChannels(const QAudioFormat &format, const void *data, int frames,
+                        SpectrumReal *out){
+  const uchar *p = static_cast<const uchar*>(data);
+  PcmSampleFormat sampleFormat;
+  PcmConvertKernel convert;
+  int channels, stride;
+
+  sampleFormat = pcmSampleFormat(format);
+  channels = format.channelCount();
+  if(sampleFormat == PCM_UNSUPPORTED || channels < 1)
+    return false;
+
+  // the samples are kept as they are interleaved, so
+  // the whole buffer is one run of the kernel
+  convert = pcmKernels().convert[sampleFormat];
+  if(channels <= PCM_MAX_CHANNELS){
+    convert(data, frames*channels, out);
+    return true;
+  }
+
+  // the channels past the first PCM_MAX_CHANNELS are
+  // dropped, so each frame is a run of its own
+  stride = channels*sampleBytes[sampleFormat];
+  for(int i=0; i<frames; i++)
+    convert(p + i*stride, PCM_MAX_CHANNELS, out + i*PCM_MAX_CHANNELS);
+  return true;
+}
+
+void pcmSelectStreams(const SpectrumReal *channels, int frames, int channelCount,
+                      PcmChannelMode mode, SpectrumReal *out){
+  const SpectrumReal mix = SpectrumReal(1)/channelCount;
+  const SpectrumReal *x = channels;
+  SpectrumReal sum;
+  int i, c;
+
+  switch(mode){
+  case PCM_RIGHT:
+    // a single channel is its own right channel
+    if(channelCount > 1)
+      x++;
+    // fall through
+  case PCM_LEFT:
+    for(i=0; i<frames; i++)
+      out[i] = x[i*channelCount];
+    break;
+  case PCM_MID:
+    for(i=0; i<frames; i++, x+=channelCount){
+      for(sum=0, c=0; c<channelCount; c++)
+        sum += x[c];
+      out[i] = sum*mix;
+    }
+    break;
+  case PCM_SIDE:
+    for(i=0; i<frames; i++, x+=channelCount)
+      out[i] = channelCount > 1 ? SpectrumReal(0.5)*(x[0] - x[1]) : 0;
+    break;
+  case PCM_MID_SIDE:
+    // mono stays two streams, the side silent, so the
+    // layout does not depend on the channel count
+    for(i=0; i<frames; i++, x+=channelCount){
+      for(sum=0, c=0; c<channelCount; c++)
+        sum += x[c];
+      out[2*i] = sum*mix;
+      out[2*i+1] = channelCount > 1 ? SpectrumReal(0.5)*(x[0] - x[1]) : 0;
+    }
+    break;
+  default:
+    memcpy(out, channels, size_t(frames)*channelCount*sizeof(SpectrumReal));
+    break;
+  }
+}
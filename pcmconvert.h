@@ -0,0 +1,136 @@
+#ifndef PCMCONVERT_H
+#define PCMCONVERT_H
+
+#include <QAudioFormat>
+#include "fft.h"
+#include "simdkernels.h"
+
+// channels converted from each buffer. streams may have
+// more channels, the ones past these are dropped
+#define PCM_MAX_CHANNELS 8
+
+/**
+ * @brief PcmSampleFormat lists the sample encodings the converter reads
+ * @details Every format is little endian, the byte order decoders deliver
+ * on the platforms the player runs on. 24 bit samples are packed in 3 bytes
+ */
+enum PcmSampleFormat{
+  PCM_UNSUPPORTED = -1,
+  PCM_U8 = 0,
+  PCM_S8,
+  PCM_U16,
+  PCM_S16,
+  PCM_S24,
+  PCM_U32,
+  PCM_S32,
+  PCM_F32,
+  PCM_FORMATS
+};
+
+/**
+ * @brief PcmChannelMode tells which streams are taken from the channels
+ * @details Streams with a single channel read it in every mode; it is its
+ * own right channel and its side is silent
+ */
+enum PcmChannelMode{
+  /**
+   * @brief PCM_LEFT analyzes the first channel
+   */
+  PCM_LEFT = 0,
+  /**
+   * @brief PCM_RIGHT analyzes the second channel
+   */
+  PCM_RIGHT,
+  /**
+   * @brief PCM_MID analyzes the mean of the first PCM_MAX_CHANNELS channels
+   */
+  PCM_MID,
+  /**
+   * @brief PCM_SIDE analyzes half the difference of the first two channels
+   */
+  PCM_SIDE,
+  /**
+   * @brief PCM_MID_SIDE analyzes mid and side, as two streams
+   */
+  PCM_MID_SIDE,
+  /**
+   * @brief PCM_ALL_CHANNELS analyzes each of the first PCM_MAX_CHANNELS
+   * channels as a stream of its own
+   */
+  PCM_ALL_CHANNELS,
+  PCM_CHANNEL_MODES
+};
+
+/**
+ * @brief pcmStreams tells how many streams a channel mode takes from a
+ * number of channels
+ */
+int pcmStreams(PcmChannelMode mode, int channels);
+
+/**
+ * @brief pcmSampleFormat tells which encoding an audio format uses
+ * @return the encoding, or PCM_UNSUPPORTED
+ */
+PcmSampleFormat pcmSampleFormat(const QAudioFormat &format);
+
+/**
+ * @brief PcmConvertKernel converts pcm samples to [-1,1]
+ * @details The samples are converted in the order they come, so the
+ * channels stay interleaved. Non finite float samples are replaced by zero
+ * @param in points to the samples
+ * @param count is the number of samples, counting every channel
+ * @param out receives count values
+ */
+typedef void (*PcmConvertKernel)(const void *in, int count, SpectrumReal *out);
+
+/**
+ * @brief The PcmKernels struct holds one conversion kernel for each sample format
+ * @details As with FFTKernels, one set exists for each SimdLevel. The scalar
+ * kernels read every format too, and the vector ones are checked against
+ * them
+ */
+struct PcmKernels{
+  SimdLevel level;
+  const char *name;
+  PcmConvertKernel convert[PCM_FORMATS];
+};
+
+/**
+ * @brief pcmKernels returns the kernels for the detected instruction set
+ */
+const PcmKernels &pcmKernels();
+
+/**
+ * @brief pcmKernels returns the kernels for a given instruction set
+ * @details Asking for a level the cpu does not support returns the
+ * best supported one instead
+ */
+const PcmKernels &pcmKernels(SimdLevel level);
+
+/**
+ * @brief pcmConvertChannels converts the channels of a buffer
+ * @param format is the format of the buffer
+ * @param data points to the interleaved samples
+ * @param frames is the number of frames (one sample of each channel)
+ * @param out receives frames*pcmStreams(PCM_ALL_CHANNELS, channels)
+ * values: the first PCM_MAX_CHANNELS channels, interleaved
+ * @return false when the format is not supported. Nothing is written then
+ */
+bool pcmConvertChannels(const QAudioFormat &format, const void *data, int frames,
+                        SpectrumReal *out);
+
+/**
+ * @brief pcmSelectStreams takes the streams of a channel mode from
+ * converted channels
+ * @param channels holds the interleaved channels, as pcmConvertChannels()
+ * leaves them
+ * @param frames is the number of frames
+ * @param channelCount is the number of channels, within [1,PCM_MAX_CHANNELS]
+ * @param mode selects the streams
+ * @param out receives frames*pcmStreams(mode, channelCount) values, the
+ * streams interleaved like the channels were
+ */
+void pcmSelectStreams(const SpectrumReal *channels, int frames, int channelCount,
+                      PcmChannelMode mode, SpectrumReal *out);
+
+#endif // PCMCONVERT_H
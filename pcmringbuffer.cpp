@@ -0,0 +1,161 @@
+#include "pcmringbuffer.h"
+#include <cstring>
+
+PcmRingBuffer::PcmRingBuffer(int capacity){
+  resize(capacity);
+}
+
+void PcmRingBuffer::resize(int capacity){
+  int size;
+
+  // the size is a power of two, so the positions
+  // are wrapped with a simple mask
+  size = 1;
+  while(size < capacity)
+    size *= 2;
+  buffer.fill(0, size);
+  samples = buffer.data();
+  mask = size-1;
+
+  readPos.storeRelease(0);
+  writePos.storeRelease(0);
+  idle.storeRelease(1);
+  dropped.storeRelease(0);
+  skipped.storeRelease(0);
+
+  markRead.storeRelease(0);
+  markWrite.storeRelease(0);
+  anchor.position = 0;
+  anchor.time = -1;
+}
+
+int PcmRingBuffer::write(const SpectrumReal *data, int count, qint64 timestamp, int granularity){
+  quint32 w, r, start, first;
+  int space, n;
+  quint32 mw;
+
+  // only the producer changes writePos. readPos is loaded with
+  // acquire semantics, so the consumer is done with the samples
+  // before they are overwritten
+  w = writePos.loadAcquire();
+  r = readPos.loadAcquire();
+  space = buffer.size() - int(w - r);
+
+  // the ring is full: the samples that do not fit are dropped
+  n = qMin(count, space);
+  if(granularity > 1)
+    n -= n % granularity;
+  if(n < count)
+    dropped.fetchAndAddRelaxed(count - n);
+
+  // copy in (at most) two pieces, before and after the wrap point
+  start = w & mask;
+  first = qMin(quint32(n), quint32(buffer.size()) - start);
+  memcpy(samples + start, data, first*sizeof(SpectrumReal));
+  memcpy(samples, data + first, (n - first)*sizeof(SpectrumReal));
+
+  // the mark goes before the samples, so the consumer finds it
+  // as soon as it can read them. a full queue loses the mark
+  mw = markWrite.loadAcquire();
+  if(timestamp >= 0 && n > 0 && mw - quint32(markRead.loadAcquire()) < MARKS){
+    marks[mw % MARKS].position = w;
+    marks[mw % MARKS].time = timestamp;
+    markWrite.storeRelease(mw + 1);
+  }
+
+  // publish the samples to the consumer
+  writePos.storeRelease(w + n);
+  return n;
+}
+
+bool PcmRingBuffer::wakeup(){
+  return idle.testAndSetOrdered(1, 0);
+}
+
+int PcmRingBuffer::available() const{
+  return int(quint32(writePos.loadAcquire()) - quint32(readPos.loadAcquire()));
+}
+
+void PcmRingBuffer::peek(SpectrumReal *out, int count) const{
+  quint32 start, first;
+
+  start = quint32(readPos.loadAcquire()) & mask;
+  first = qMin(quint32(count), quint32(buffer.size()) - start);
+  memcpy(out, samples + start, first*sizeof(SpectrumReal));
+  memcpy(out + first, samples, (count - first)*sizeof(SpectrumReal));
+}
+
+void PcmRingBuffer::peek(SpectrumReal *out, int count, const SpectrumReal *window) const{
+  quint32 start, first;
+  const SpectrumReal *in;
+
+  // the same two pieces as a plain peek, each one multiplied
+  // by its part of the window
+  start = quint32(readPos.loadAcquire()) & mask;
+  first = qMin(quint32(count), quint32(buffer.size()) - start);
+  in = samples + start;
+  for(quint32 i=0; i<first; i++)
+    out[i] = in[i]*window[i];
+  for(int i=first; i<count; i++)
+    out[i] = samples[i-first]*window[i];
+}
+
+void PcmRingBuffer::peekStreams(SpectrumReal *out, int frames, int streams,
+                                const SpectrumReal *window) const{
+  quint32 r;
+
+  if(streams == 1){
+    peek(out, frames, window);
+    return;
+  }
+
+  // frames are read one at a time, each sample to the block of its
+  // stream. the wrap point is handled by the mask
+  r = readPos.loadAcquire();
+  for(int i=0; i<frames; i++){
+    for(int s=0; s<streams; s++, r++)
+      out[s*frames + i] = samples[r & mask]*window[i];
+  }
+}
+
+qint64 PcmRingBuffer::readTimestamp(int sampleRate){
+  quint32 r, mr;
+
+  // take every mark the read position has already reached.
+  // the newest one is the best reference
+  r = readPos.loadAcquire();
+  for(mr = markRead.loadAcquire(); mr != quint32(markWrite.loadAcquire()); mr++){
+    const Mark &mark = marks[mr % MARKS];
+    if(int(mark.position - r) > 0)
+      break;
+    anchor = mark;
+  }
+  markRead.storeRelease(mr);
+
+  if(anchor.time < 0 || sampleRate <= 0)
+    return -1;
+  return anchor.time + qint64(r - anchor.position)*1000000/sampleRate;
+}
+
+void PcmRingBuffer::consume(int count){
+  // hands the space back to the producer
+  readPos.storeRelease(quint32(readPos.loadAcquire()) + count);
+}
+
+void PcmRingBuffer::skip(int count){
+  skipped.fetchAndAddRelaxed(count);
+  consume(count);
+}
+
+bool PcmRingBuffer::sleep(int minimum){
+  // a full barrier: the flag must be visible before the
+  // write position is looked at again
+  idle.fetchAndStoreOrdered(1);
+
+  // samples may have arrived after the consumer looked at the ring
+  // but before it was marked as idle. in that case the producer may
+  // have missed the flag, so the consumer wakes itself up
+  if(available() >= minimum && idle.testAndSetOrdered(1, 0))
+    return false;
+  return true;
+}
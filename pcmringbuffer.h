@@ -0,0 +1,220 @@
+#ifndef PCMRINGBUFFER_H
+#define PCMRINGBUFFER_H
+
+#include <QAtomicInt>
+#include <QVector>
+#include "fft.h"
+
+/**
+ * @brief The PcmRingBuffer class moves pcm samples from one thread to another
+ * without locks
+ * @details It is a single producer/single consumer ring: exactly one thread
+ * may call the producer functions (write(), wakeup()) and exactly one
+ * thread may call the consumer functions (available(), peek(), consume(),
+ * sleep()). Every call is wait-free.
+ *
+ * Overwrite policy: the producer never blocks and never touches samples
+ * that were not consumed yet. When the ring is full, the samples that do
+ * not fit are discarded and counted in droppedSamples(). The consumer is
+ * expected to keep the ring from filling up by skipping old samples with
+ * skip(), which are counted in skippedSamples().
+ *
+ * Read and write positions are free running 32 bit counters, so they may
+ * wrap around. Only their difference is meaningful.
+ *
+ * Each write may carry the media time of its first sample. The ring keeps
+ * these marks in a small queue of its own, so the consumer can tell when
+ * the samples it reads are meant to be heard.
+ */
+class PcmRingBuffer{
+public:
+  /**
+   * @brief Creates the ring
+   * @param capacity is the minimum number of samples the ring holds. It
+   * is rounded up to a power of two
+   */
+  explicit PcmRingBuffer(int capacity = 0);
+
+  /**
+   * @brief Changes the capacity and empties the ring
+   * @details This is not thread safe. Neither side may be using the ring
+   * @param capacity is the minimum number of samples the ring holds
+   */
+  void resize(int capacity);
+
+  /**
+   * @brief capacity returns the number of samples the ring holds
+   */
+  int capacity() const { return buffer.size(); }
+
+  /**
+   * @brief write appends samples to the ring (producer side)
+   * @param data points to the samples
+   * @param count is the number of samples
+   * @param timestamp is the media time of the first sample, in
+   * microseconds, or -1 when it is unknown
+   * @param granularity is the number of interleaved streams. When the
+   * ring is full only whole frames are written, so the streams stay aligned
+   * @return the number of samples written. The rest was dropped
+   */
+  int write(const SpectrumReal *data, int count, qint64 timestamp = -1, int granularity = 1);
+
+  /**
+   * @brief writePosition returns the free running position of the next
+   * sample to be written (producer side)
+   */
+  quint32 writePosition() const { return quint32(writePos.loadAcquire()); }
+
+  /**
+   * @brief wakeup tells whether the consumer went to sleep and must be
+   * woken up (producer side)
+   * @details Only one call returns true for each sleep() of the consumer
+   */
+  bool wakeup();
+
+  /**
+   * @brief available returns the number of samples ready to be read
+   * (consumer side)
+   */
+  int available() const;
+
+  /**
+   * @brief peek copies samples without consuming them (consumer side)
+   * @param out receives the samples
+   * @param count is the number of samples. It must not exceed available()
+   */
+  void peek(SpectrumReal *out, int count) const;
+
+  /**
+   * @brief peek copies samples multiplied by a window, without consuming
+   * them (consumer side)
+   * @details The window is applied while copying, so windowing a frame
+   * costs no extra pass over it
+   * @param out receives the windowed samples
+   * @param count is the number of samples. It must not exceed available()
+   * @param window holds count coefficients
+   */
+  void peek(SpectrumReal *out, int count, const SpectrumReal *window) const;
+
+  /**
+   * @brief peekStreams copies interleaved streams into one block each,
+   * multiplied by a window, without consuming them (consumer side)
+   * @param out receives stream s at out + s*frames
+   * @param frames is the number of samples of each stream. frames*streams
+   * must not exceed available()
+   * @param streams is the number of interleaved streams
+   * @param window holds frames coefficients
+   */
+  void peekStreams(SpectrumReal *out, int frames, int streams, const SpectrumReal *window) const;
+
+  /**
+   * @brief readPosition returns the free running position of the next
+   * sample to be read (consumer side)
+   */
+  quint32 readPosition() const { return quint32(readPos.loadAcquire()); }
+
+  /**
+   * @brief readTimestamp returns the media time of the next sample to be
+   * read (consumer side)
+   * @details The time is extrapolated from the last mark written at or
+   * before the read position
+   * @param sampleRate is the sample rate of the stream
+   * @return the time in microseconds, or -1 when no mark was written yet
+   */
+  qint64 readTimestamp(int sampleRate);
+
+  /**
+   * @brief consume releases samples to the producer (consumer side)
+   * @param count is the number of samples. It must not exceed available()
+   */
+  void consume(int count);
+
+  /**
+   * @brief skip consumes samples that will never be analyzed (consumer side)
+   * @details It works like consume() but counts the samples in skippedSamples()
+   * @param count is the number of samples. It must not exceed available()
+   */
+  void skip(int count);
+
+  /**
+   * @brief sleep marks the consumer as idle (consumer side)
+   * @param minimum is the number of samples the consumer needs to go on
+   * @return false when minimum samples arrived in the meantime. In that
+   * case the consumer is still awake and must go on working
+   */
+  bool sleep(int minimum);
+
+  /**
+   * @brief droppedSamples counts samples discarded because the ring was full
+   */
+  int droppedSamples() const { return dropped.loadAcquire(); }
+
+  /**
+   * @brief skippedSamples counts samples skipped by the consumer
+   */
+  int skippedSamples() const { return skipped.loadAcquire(); }
+
+private:
+  /**
+   * @brief buffer stores the samples. Its size is a power of two
+   */
+  QVector<SpectrumReal> buffer;
+
+  /**
+   * @brief samples points to the buffer data. Both threads use it
+   * directly, so the vector is never detached while in use
+   */
+  SpectrumReal *samples;
+
+  /**
+   * @brief mask is capacity()-1, to wrap the positions into the buffer
+   */
+  quint32 mask;
+
+  /**
+   * @brief readPos and writePos are the free running positions of each side
+   */
+  QAtomicInt readPos, writePos;
+
+  /**
+   * @brief idle is 1 while the consumer sleeps
+   */
+  QAtomicInt idle;
+
+  /**
+   * @brief dropped and skipped are the overwrite policy counters
+   */
+  QAtomicInt dropped, skipped;
+
+  /**
+   * @brief The Mark struct ties a write position to a media time
+   */
+  struct Mark{
+    quint32 position;
+    qint64 time;
+  };
+
+  /**
+   * @brief MARKS is the size of the mark queue. When it is full, new marks
+   * are not recorded and the time is extrapolated from older ones
+   */
+  enum { MARKS = 64 };
+
+  /**
+   * @brief marks is a single producer/single consumer queue of its own
+   */
+  Mark marks[MARKS];
+
+  /**
+   * @brief markRead and markWrite are the free running positions of the queue
+   */
+  QAtomicInt markRead, markWrite;
+
+  /**
+   * @brief anchor is the last mark taken by the consumer. Only the
+   * consumer touches it. Its time is -1 while there is none
+   */
+  Mark anchor;
+};
+
+#endif // PCMRINGBUFFER_H
@@ -0,0 +1,37 @@
+#include "playbackclock.h"
+#include <QMutexLocker>
+
+PlaybackClock::PlaybackClock(){
+  wall.start();
+  anchorMedia = anchorWall = 0;
+  running = false;
+}
+
+void PlaybackClock::setPosition(qint64 ms){
+  QMutexLocker locker(&mutex);
+  anchorMedia = ms*1000;
+  anchorWall = wall.nsecsElapsed()/1000;
+}
+
+void PlaybackClock::setRunning(bool _running){
+  QMutexLocker locker(&mutex);
+  qint64 now = wall.nsecsElapsed()/1000;
+
+  // freeze (or restart) the extrapolation at the current position
+  if(running)
+    anchorMedia += now - anchorWall;
+  anchorWall = now;
+  running = _running;
+}
+
+qint64 PlaybackClock::position() const{
+  QMutexLocker locker(&mutex);
+  if(!running)
+    return anchorMedia;
+  return anchorMedia + wall.nsecsElapsed()/1000 - anchorWall;
+}
+
+bool PlaybackClock::isRunning() const{
+  QMutexLocker locker(&mutex);
+  return running;
+}
@@ -0,0 +1,69 @@
+#ifndef PLAYBACKCLOCK_H
+#define PLAYBACKCLOCK_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+
+/**
+ * @brief The PlaybackClock class tells which part of the media is audible now
+ * @details The media player reports its position from time to time. Between
+ * reports, the clock extrapolates the position with a monotonic timer while
+ * the player is playing, and holds it still while it is paused.
+ *
+ * The player thread updates the clock and any thread may read it.
+ */
+class PlaybackClock{
+public:
+  /**
+   * @brief Creates a stopped clock at position zero
+   */
+  PlaybackClock();
+
+  /**
+   * @brief setPosition re-anchors the clock at a position reported by the player
+   * @param ms is the media position in milliseconds
+   */
+  void setPosition(qint64 ms);
+
+  /**
+   * @brief setRunning starts or stops the clock
+   * @param running is true while the media is playing
+   */
+  void setRunning(bool running);
+
+  /**
+   * @brief position returns the media position that is audible now
+   * @return the position in microseconds
+   */
+  qint64 position() const;
+
+  /**
+   * @brief isRunning tells whether the media is playing
+   */
+  bool isRunning() const;
+
+private:
+  /**
+   * @brief wall is the monotonic timer used to extrapolate the position
+   */
+  QElapsedTimer wall;
+
+  /**
+   * @brief anchorMedia and anchorWall are the last reported media position
+   * and the wall time it was reported at, both in microseconds
+   */
+  qint64 anchorMedia, anchorWall;
+
+  /**
+   * @brief running is true while the media is playing
+   */
+  bool running;
+
+  /**
+   * @brief mutex protects the anchor. It is taken for a few
+   * instructions, a few times per frame
+   */
+  mutable QMutex mutex;
+};
+
+#endif // PLAYBACKCLOCK_H
@@ -10,6 +10,10 @@ QMAKE_CXXFLAGS_WARN_OFF -= -Wunused-parameter
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
+# the spectrum analyzer runs in double precision by default.
+# run qmake CONFIG+=fft_float to build it in single precision
+fft_float: DEFINES += FFT_SINGLE_PRECISION
+
 TARGET = player-flat
 TEMPLATE = app
 
@@ -21,7 +25,23 @@ SOURCES += main.cpp\
     controls.cpp \
     fftcalc.cpp \
     mediainfo.cpp \
-    playlistmodel.cpp
+    playlistmodel.cpp \
+    simdkernels.cpp \
+    pcmringbuffer.cpp \
+    spectrumframestore.cpp \
+    playbackclock.cpp \
+    pcmconvert.cpp \
+    waterfall.cpp \
+    bandmapper.cpp \
+    windowfunction.cpp \
+    loudnessmeter.cpp \
+    libraryscanner.cpp \
+    libraryindex.cpp \
+    libraryplaylist.cpp \
+    stringpool.cpp \
+    tagparser.cpp \
+    tagreader.cpp \
+    searchindex.cpp
  
 HEADERS  += mainwindow.h \
     spectrograph.h \
@@ -32,9 +52,33 @@ HEADERS  += mainwindow.h \
     abstractcontrol.h \
     abstractspectrograph.h \
     abstractmediainfo.h \
-    playlistmodel.h
+    playlistmodel.h \
+    simdkernels.h \
+    pcmringbuffer.h \
+    spectrumframestore.h \
+    playbackclock.h \
+    pcmconvert.h \
+    waterfall.h \
+    bandmapper.h \
+    windowfunction.h \
+    loudnessmeter.h \
+    librarytrack.h \
+    libraryscanner.h \
+    libraryindex.h \
+    libraryplaylist.h \
+    stringpool.h \
+    tagparser.h \
+    tagreader.h \
+    searchindex.h
    fft.h
 
+# the opengl spectrograph needs QOpenGLWidget (qt 5.4)
+equals(QT_MAJOR_VERSION, 5):greaterThan(QT_MINOR_VERSION, 3) {
+    DEFINES += HAVE_GL_SPECTROGRAPH
+    SOURCES += glspectrograph.cpp
+    HEADERS += glspectrograph.h
+}
+
 FORMS    += mainwindow.ui \
     controls.ui \
     mediainfo.ui
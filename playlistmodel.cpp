@@ -1,8 +1,9 @@
 #include "playlistmodel.h"
 
 #include <QFileInfo>
-#include <QUrl>
-#include <QMediaPlaylist>
+#include <QHash>
+#include <QSet>
+#include <algorithm>
 
 // this file implements a model for playlist
 // each function performs actions that are needed
@@ -10,11 +11,24 @@
 
 PlaylistModel::PlaylistModel(QObject *parent)
     : QAbstractItemModel(parent)
-    , m_playlist(0){
+    , m_playlist(0)
+    , m_loaded(0)
+    , m_pendingFirst(-1)
+    , m_pendingLast(-1)
+    , m_arranged(false)
+    , m_sortColumn(-1)
+    , m_sortOrder(Qt::AscendingOrder){
+    // a batch per turn of the event loop, so the
+    // gui keeps answering while the rest loads
+    m_loader = new QTimer(this);
+    m_loader->setInterval(0);
+    connect(m_loader, SIGNAL(timeout()), this, SLOT(loadMore()));
 }
 
 int PlaylistModel::rowCount(const QModelIndex &parent) const {
-    return m_playlist && !parent.isValid() ? m_playlist->mediaCount() : 0;
+    if (parent.isValid())
+        return 0;
+    return m_arranged ? m_order.size() : m_loaded;
 }
 
 int PlaylistModel::columnCount(const QModelIndex &parent) const {
@@ -23,7 +37,7 @@ int PlaylistModel::columnCount(const QModelIndex &parent) const {
 
 QModelIndex PlaylistModel::index(int row, int column, const QModelIndex &parent) const {
     return m_playlist && !parent.isValid()
-            && row >= 0 && row < m_playlist->mediaCount()
+            && row >= 0 && row < rowCount()
             && column >= 0 && column < ColumnCount
         ? createIndex(row, column)
         : QModelIndex();
@@ -35,23 +49,393 @@ QModelIndex PlaylistModel::parent(const QModelIndex &child) const {
     return QModelIndex();
 }
 
+// every column is an array lookup. nothing is
+// computed when the views repaint
 QVariant PlaylistModel::data(const QModelIndex &index, int role) const {
-    if (index.isValid() && role == Qt::DisplayRole) {
-        QVariant value = m_data[index];
-        if (!value.isValid() && index.column() == Title) {
-            QUrl location = m_playlist->media(index.row()).canonicalUrl();
-            return QFileInfo(location.path()).fileName();
+    int row = index.row();
+    qint64 duration;
+
+    if (!index.isValid() || row >= rowCount())
+        return QVariant();
+    row = playlistPosition(row);
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case Title:
+            return m_strings.string(m_titles[row]);
+        case Artist:
+            return m_strings.string(m_artists[row]);
+        case Album:
+            return m_strings.string(m_albums[row]);
+        case Duration:
+            duration = m_durations[row]/1000;
+            if (duration <= 0)
+                return QVariant();
+            return QString("%1:%2").arg(duration/60).arg(duration%60, 2, 10, QChar('0'));
+        case Path:
+            return m_strings.string(m_paths[row]);
         }
-        return value;
+    }
+    if (role == Qt::ToolTipRole)
+        return m_strings.string(m_paths[row]);
+    return QVariant();
+}
+
+QVariant PlaylistModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+    switch (section) {
+    case Title:
+        return tr("Title");
+    case Artist:
+        return tr("Artist");
+    case Album:
+        return tr("Album");
+    case Duration:
+        return tr("Duration");
+    case Path:
+        return tr("Path");
     }
     return QVariant();
 }
 
-QMediaPlaylist *PlaylistModel::playlist() const {
+// while searching or sorting every row is loaded already
+bool PlaylistModel::canFetchMore(const QModelIndex &parent) const {
+    return m_playlist && !parent.isValid() && !m_arranged
+            && m_loaded < m_playlist->mediaCount();
+}
+
+void PlaylistModel::fetchMore(const QModelIndex &parent) {
+    int count;
+
+    if (!canFetchMore(parent))
+        return;
+    count = qMin(PLAYLIST_FETCH_BATCH, m_playlist->mediaCount() - m_loaded);
+    beginInsertRows(QModelIndex(), m_loaded, m_loaded + count - 1);
+    loadRows(m_loaded, m_loaded + count - 1);
+    endInsertRows();
+}
+
+void PlaylistModel::fetchUpTo(int row) {
+    while (row >= m_loaded && canFetchMore(QModelIndex()))
+        fetchMore(QModelIndex());
+}
+
+// the strings of each batch are sorted into the search index
+// and ranked right away, a few thousand at a time, instead of
+// all of them by the first search or sort
+void PlaylistModel::loadMore() {
+    if (canFetchMore(QModelIndex()))
+        fetchMore(QModelIndex());
+    m_search.prepare();
+    if (!canFetchMore(QModelIndex()))
+        m_loader->stop();
+}
+
+// makes room for the rows in the columns and fills them
+void PlaylistModel::loadRows(int first, int last) {
+    int count = last - first + 1;
+
+    m_titles.insert(first, count, 0);
+    m_artists.insert(first, count, 0);
+    m_albums.insert(first, count, 0);
+    m_paths.insert(first, count, 0);
+    m_durations.insert(first, count, 0);
+    m_loaded += count;
+
+    for (int row = first; row <= last; row++)
+        readRow(row);
+}
+
+void PlaylistModel::readRow(int row) {
+    LibraryTrack track;
+
+    m_playlist->track(row, &track);
+    storeRow(row, track);
+}
+
+void PlaylistModel::storeRow(int row, const LibraryTrack &track) {
+    // songs without tags are named after their files
+    m_titles[row] = intern(track.title.isEmpty()
+                           ? QFileInfo(track.path).fileName()
+                           : track.title);
+    m_artists[row] = intern(track.artist);
+    m_albums[row] = intern(track.album);
+    m_paths[row] = intern(track.path);
+    m_durations[row] = track.duration;
+}
+
+// the pool hands out consecutive ids, and the index takes
+// them in the same order. strings are indexed once however
+// many rows have them
+quint32 PlaylistModel::intern(const QString &string) {
+    quint32 id = m_strings.intern(string);
+
+    while (m_search.size() < m_strings.size())
+        m_search.add(m_search.size(), m_strings.string(m_search.size()));
+    return id;
+}
+
+bool PlaylistModel::matchWords(QList<QVector<quint64> > *matches) const {
+    QList<QByteArray> words = SearchIndex::words(SearchIndex::fold(m_filter));
+
+    matches->clear();
+    for (int i = 0; i < words.size(); i++) {
+        matches->append(QVector<quint64>());
+        if (m_search.match(words[i], &matches->last()) == 0)
+            return false;
+    }
+    return true;
+}
+
+bool PlaylistModel::rowMatches(int position, const QList<QVector<quint64> > &matches) const {
+    for (int i = 0; i < matches.size(); i++) {
+        const QVector<quint64> &found = matches[i];
+        if (!SearchIndex::contains(found, m_titles[position])
+                && !SearchIndex::contains(found, m_artists[position])
+                && !SearchIndex::contains(found, m_albums[position])
+                && !SearchIndex::contains(found, m_paths[position]))
+            return false;
+    }
+    return true;
+}
+
+// each position is sorted as one number: the rank of its
+// string, or its duration, on top of the position itself.
+// songs that compare equal keep their playlist order
+quint64 PlaylistModel::sortKey(int position) const {
+    const QVector<quint32> *texts;
+    quint32 key;
+
+    switch (m_sortColumn) {
+    case Title:
+        texts = &m_titles;
+        break;
+    case Artist:
+        texts = &m_artists;
+        break;
+    case Album:
+        texts = &m_albums;
+        break;
+    case Path:
+        texts = &m_paths;
+        break;
+    case Duration:
+        texts = 0;
+        break;
+    default:
+        return quint32(position);
+    }
+
+    key = texts ? m_search.ranks()[texts->at(position)]
+                : quint32(qBound(Q_INT64_C(0), m_durations[position], Q_INT64_C(0xffffffff)));
+    if (m_sortOrder == Qt::DescendingOrder)
+        key = ~key;
+    return quint64(key) << 32 | quint32(position);
+}
+
+void PlaylistModel::sortPositions(QVector<int> *positions) const {
+    QVector<quint64> keys;
+
+    if (m_sortColumn < 0)
+        return;
+    keys.resize(positions->size());
+    for (int i = 0; i < positions->size(); i++)
+        keys[i] = sortKey(positions->at(i));
+    std::sort(keys.begin(), keys.end());
+    for (int i = 0; i < keys.size(); i++)
+        (*positions)[i] = int(keys[i] & 0xffffffff);
+}
+
+// a search is a few bit sets, one per word typed, and a pass
+// over the columns that tests the bits of each row
+void PlaylistModel::arrange() {
+    QList<QVector<quint64> > matches;
+
+    beginResetModel();
+    m_order.clear();
+    m_arranged = m_playlist && (!m_filter.isEmpty() || m_sortColumn >= 0);
+    if (m_arranged) {
+        // searching and sorting look at every song. the loader
+        // has most often loaded them all by now. if not, what
+        // is left is loaded here
+        if (m_loaded < m_playlist->mediaCount())
+            loadRows(m_loaded, m_playlist->mediaCount() - 1);
+        if (matchWords(&matches)) {
+            m_order.reserve(m_loaded);
+            for (int position = 0; position < m_loaded; position++) {
+                if (rowMatches(position, matches))
+                    m_order.append(position);
+            }
+        }
+        sortPositions(&m_order);
+    }
+    endResetModel();
+}
+
+void PlaylistModel::insertArranged(int first, int last) {
+    QVector<int> positions;
+    int count = last - first + 1;
+
+    loadRows(first, last);
+
+    // the songs after the new ones moved down. their
+    // rows did not, so the views are not told
+    for (int row = 0; row < m_order.size(); row++) {
+        if (m_order[row] >= first)
+            m_order[row] += count;
+    }
+
+    for (int position = first; position <= last; position++)
+        positions.append(position);
+    placeArranged(positions);
+}
+
+// the rows that no longer match are taken out. the others
+// are moved, not taken out and put back, so the views keep
+// them selected: first to the end, unless they sort between
+// rows that did not change, then each to its place, among
+// the rows that stay, with the songs that match now
+void PlaylistModel::placeArranged(const QVector<int> &positions) {
+    QList<QVector<quint64> > matches;
+    QSet<int> changed, shown;
+    QVector<quint64> keys, others;
+    quint64 key;
+    bool matching;
+    int row, last, moved, target, end, firstRow, lastRow;
+
+    matching = matchWords(&matches);
+    for (int i = 0; i < positions.size(); i++)
+        changed.insert(positions[i]);
+
+    for (row = m_order.size() - 1; row >= 0; row--) {
+        if (!changed.contains(m_order[row])
+                || (matching && rowMatches(m_order[row], matches)))
+            continue;
+        last = row;
+        while (row > 0 && changed.contains(m_order[row - 1])
+               && !(matching && rowMatches(m_order[row - 1], matches)))
+            row--;
+        beginRemoveRows(QModelIndex(), row, last);
+        m_order.remove(row, last - row + 1);
+        endRemoveRows();
+    }
+    if (!matching)
+        return;
+
+    // the rows moved to the end are the last moved ones
+    moved = 0;
+    for (row = m_order.size() - 1; row >= 0; row--) {
+        int position = m_order[row];
+        if (!changed.contains(position))
+            continue;
+        shown.insert(position);
+        end = m_order.size() - moved;
+        key = sortKey(position);
+        if ((row == 0 || (!changed.contains(m_order[row - 1]) && sortKey(m_order[row - 1]) < key))
+                && (row == end - 1 || (!changed.contains(m_order[row + 1]) && key < sortKey(m_order[row + 1]))))
+            continue;
+        keys.append(key);
+        if (row < end - 1) {
+            beginMoveRows(QModelIndex(), row, row, QModelIndex(), m_order.size());
+            m_order.remove(row);
+            m_order.append(position);
+            endMoveRows();
+        }
+        moved++;
+    }
+    for (int i = 0; i < positions.size(); i++) {
+        if (!shown.contains(positions[i]) && rowMatches(positions[i], matches))
+            keys.append(sortKey(positions[i]));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    // the rows that stay are in order. each row placed lands
+    // after the ones placed before it, so the rows above it are
+    // where they belong, and its own row is never above its place
+    end = m_order.size() - moved;
+    others.resize(end);
+    for (row = 0; row < end; row++)
+        others[row] = sortKey(m_order[row]);
+    for (int i = 0; i < keys.size(); i++) {
+        int position = int(keys[i] & 0xffffffff);
+        target = i + int(std::lower_bound(others.constBegin(), others.constEnd(), keys[i])
+                         - others.constBegin());
+        row = m_order.indexOf(position, target);
+        if (row < 0) {
+            beginInsertRows(QModelIndex(), target, target);
+            m_order.insert(target, position);
+            endInsertRows();
+        }
+        else if (row != target) {
+            beginMoveRows(QModelIndex(), row, row, QModelIndex(), target);
+            m_order.remove(row);
+            m_order.insert(target, position);
+            endMoveRows();
+        }
+    }
+
+    // and their text changed
+    firstRow = m_order.size();
+    lastRow = -1;
+    for (row = 0; row < m_order.size(); row++) {
+        if (!changed.contains(m_order[row]))
+            continue;
+        firstRow = qMin(firstRow, row);
+        lastRow = row;
+    }
+    if (lastRow >= 0)
+        emit dataChanged(index(firstRow, 0), index(lastRow, ColumnCount - 1));
+}
+
+void PlaylistModel::positionsChanged(const QVector<int> &positions) {
+    if (positions.isEmpty())
+        return;
+    if (m_arranged)
+        placeArranged(positions);
+    else
+        emit dataChanged(index(positions.first(), 0), index(positions.last(), ColumnCount - 1));
+}
+
+void PlaylistModel::setFilter(const QString &text) {
+    if (text == m_filter)
+        return;
+    m_filter = text;
+    arrange();
+}
+
+QString PlaylistModel::filter() const {
+    return m_filter;
+}
+
+void PlaylistModel::sort(int column, Qt::SortOrder order) {
+    m_sortColumn = column >= 0 && column < ColumnCount ? column : -1;
+    m_sortOrder = order;
+    arrange();
+}
+
+int PlaylistModel::sortColumn() const {
+    return m_sortColumn;
+}
+
+int PlaylistModel::playlistPosition(int row) const {
+    if (!m_arranged)
+        return row;
+    return row >= 0 && row < m_order.size() ? m_order[row] : -1;
+}
+
+QModelIndex PlaylistModel::indexOfPosition(int position) {
+    if (!m_arranged) {
+        fetchUpTo(position);
+        return index(position, 0);
+    }
+    return index(m_order.indexOf(position), 0);
+}
+
+LibraryPlaylist *PlaylistModel::playlist() const {
     return m_playlist;
 }
 
-void PlaylistModel::setPlaylist(QMediaPlaylist *playlist) {
+void PlaylistModel::setPlaylist(LibraryPlaylist *playlist) {
     if (m_playlist) {
         disconnect(m_playlist, SIGNAL(mediaAboutToBeInserted(int,int)), this, SLOT(beginInsertItems(int,int)));
         disconnect(m_playlist, SIGNAL(mediaInserted(int,int)), this, SLOT(endInsertItems()));
@@ -63,6 +447,22 @@ void PlaylistModel::setPlaylist(QMediaPlaylist *playlist) {
     beginResetModel();
     m_playlist = playlist;
 
+    // the views fetch the first rows of the new playlist
+    m_titles.clear();
+    m_artists.clear();
+    m_albums.clear();
+    m_paths.clear();
+    m_durations.clear();
+    m_strings.clear();
+    m_search.clear();
+    m_loaded = 0;
+
+    // and all of them, in playlist order
+    m_order.clear();
+    m_arranged = false;
+    m_filter.clear();
+    m_sortColumn = -1;
+
     if (m_playlist) {
         connect(m_playlist, SIGNAL(mediaAboutToBeInserted(int,int)), this, SLOT(beginInsertItems(int,int)));
         connect(m_playlist, SIGNAL(mediaInserted(int,int)), this, SLOT(endInsertItems()));
@@ -72,34 +472,163 @@ void PlaylistModel::setPlaylist(QMediaPlaylist *playlist) {
     }
 
     endResetModel();
+    if (canFetchMore(QModelIndex()))
+        m_loader->start();
+}
+
+void PlaylistModel::updateTracks(LibraryTrackList tracks) {
+    QHash<quint32, int> changed;
+    QVector<int> positions;
+    int id;
+
+    // the paths not in the pool are in no row
+    for (int i = 0; i < tracks.size(); i++) {
+        id = m_strings.find(tracks[i].path);
+        if (id > 0)
+            changed.insert(id, i);
+    }
+    if (changed.isEmpty())
+        return;
+
+    // one pass over the path column finds every row, and
+    // the views are told about all of them at once
+    for (int row = 0; row < m_loaded; row++) {
+        QHash<quint32, int>::const_iterator it = changed.constFind(m_paths[row]);
+        if (it == changed.constEnd())
+            continue;
+        storeRow(row, tracks[*it]);
+        positions.append(row);
+    }
+    positionsChanged(positions);
 }
 
 bool PlaylistModel::setData(const QModelIndex &index, const QVariant &value, int role) {
+    int position;
+
     Q_UNUSED(role);
-    m_data[index] = value;
+    if (!index.isValid() || index.row() >= rowCount())
+        return false;
+    position = playlistPosition(index.row());
+    switch (index.column()) {
+    case Title:
+        m_titles[position] = intern(value.toString());
+        break;
+    case Artist:
+        m_artists[position] = intern(value.toString());
+        break;
+    case Album:
+        m_albums[position] = intern(value.toString());
+        break;
+    default:
+        return false;
+    }
     emit dataChanged(index, index);
     return true;
 }
 
+// rows inserted among the loaded ones are loaded right away. rows
+// appended to them are loaded up to a batch, the views fetch the
+// rest. rows further down wait until the views get there.
+// while searching or sorting, every row is loaded
 void PlaylistModel::beginInsertItems(int start, int end) {
-    m_data.clear();
-    beginInsertRows(QModelIndex(), start, end);
+    m_pendingFirst = -1;
+    if (m_arranged) {
+        m_pendingFirst = start;
+        m_pendingLast = end;
+        return;
+    }
+    if (start > m_loaded)
+        return;
+    m_pendingFirst = start;
+    m_pendingLast = start == m_loaded ? qMin(end, start + PLAYLIST_FETCH_BATCH - 1) : end;
+    beginInsertRows(QModelIndex(), m_pendingFirst, m_pendingLast);
 }
 
 void PlaylistModel::endInsertItems() {
-    endInsertRows();
+    if (m_pendingFirst >= 0 && m_arranged) {
+        insertArranged(m_pendingFirst, m_pendingLast);
+    }
+    else if (m_pendingFirst >= 0) {
+        loadRows(m_pendingFirst, m_pendingLast);
+        endInsertRows();
+    }
+    m_pendingFirst = -1;
+
+    // the rows the views did not get are loaded between events
+    if (canFetchMore(QModelIndex()))
+        m_loader->start();
 }
 
+// only the loaded rows are told to the views. while searching
+// or sorting, the rows shown go away run by run, while the
+// columns still hold their songs
 void PlaylistModel::beginRemoveItems(int start, int end) {
-    m_data.clear();
-    beginRemoveRows(QModelIndex(), start, end);
+    int last;
+
+    m_pendingFirst = -1;
+    if (m_arranged) {
+        m_pendingFirst = start;
+        m_pendingLast = end;
+        for (int row = m_order.size() - 1; row >= 0; row--) {
+            if (m_order[row] < start || m_order[row] > end)
+                continue;
+            last = row;
+            while (row > 0 && m_order[row - 1] >= start && m_order[row - 1] <= end)
+                row--;
+            beginRemoveRows(QModelIndex(), row, last);
+            m_order.remove(row, last - row + 1);
+            endRemoveRows();
+        }
+        return;
+    }
+    if (start >= m_loaded)
+        return;
+    m_pendingFirst = start;
+    m_pendingLast = qMin(end, m_loaded - 1);
+    beginRemoveRows(QModelIndex(), m_pendingFirst, m_pendingLast);
 }
 
 void PlaylistModel::endRemoveItems() {
-    endInsertRows();
+    int count;
+
+    if (m_pendingFirst < 0)
+        return;
+    count = m_pendingLast - m_pendingFirst + 1;
+    m_titles.remove(m_pendingFirst, count);
+    m_artists.remove(m_pendingFirst, count);
+    m_albums.remove(m_pendingFirst, count);
+    m_paths.remove(m_pendingFirst, count);
+    m_durations.remove(m_pendingFirst, count);
+    m_loaded -= count;
+
+    // the songs after the removed ones moved up
+    if (m_arranged) {
+        for (int row = 0; row < m_order.size(); row++) {
+            if (m_order[row] > m_pendingLast)
+                m_order[row] -= count;
+        }
+    }
+    m_pendingFirst = -1;
+
+    // strings are never taken out of the pool. it
+    // starts over when the playlist is emptied
+    if (m_loaded == 0) {
+        m_strings.clear();
+        m_search.clear();
+    }
+    if (!m_arranged)
+        endRemoveRows();
 }
 
 void PlaylistModel::changeItems(int start, int end) {
-    m_data.clear();
-    emit dataChanged(index(start,0), index(end,ColumnCount));
+    QVector<int> positions;
+
+    if (start >= m_loaded)
+        return;
+    end = qMin(end, m_loaded - 1);
+    for (int row = start; row <= end; row++) {
+        readRow(row);
+        positions.append(row);
+    }
+    positionsChanged(positions);
 }
@@ -2,7 +2,14 @@
 #define PLAYLISTMODEL_H
 
 #include <QAbstractItemModel>
-#include <QMediaPlaylist>
+#include <QTimer>
+#include <QVector>
+#include "libraryplaylist.h"
+#include "searchindex.h"
+#include "stringpool.h"
+
+// rows are handed to the views this many at a time
+#define PLAYLIST_FETCH_BATCH 2048
 
 /*
  * This class implements a playlist model to store songs to be played
@@ -14,6 +21,29 @@
  * path from such database. Therefore, where the data is extracted is
  * responsability only from this class, and the viewing component does
  * not have to know nothing about this.
+ *
+ * The rows are cached column by column: one array of string ids per
+ * text column, and one of durations. The strings themselves are kept
+ * once, in a pool, so a row costs a few integers however long its
+ * strings are, and data() is an array lookup. Tags come from the
+ * playlist, which looks them up in the library index. Rows without
+ * tags show their file name as title.
+ *
+ * Long playlists are not loaded at once. The views are given rows in
+ * batches, through canFetchMore() and fetchMore(), as they scroll down,
+ * and an idle timer fetches the rest a batch at a time between events.
+ * Each batch is folded into the search index and ranked as it comes, so
+ * by the time the user searches or sorts, nothing is left to load or to
+ * rank. Changes to the playlist touch only the rows they change.
+ *
+ * The model searches and sorts by itself. Every string of the pool goes
+ * into a search index as it comes in, so the index grows with the
+ * playlist and is never built again. A search shows the songs with a
+ * title, artist, album or path word starting with each word typed, case
+ * and accents aside. While searching or sorting, every row is loaded and
+ * the rows shown are a list of playlist positions. Songs inserted or
+ * changed then are tested again: they are moved to their sorted place if
+ * they match, and taken out if they no longer do.
 */
 
 class PlaylistModel : public QAbstractItemModel
@@ -21,19 +51,82 @@ class PlaylistModel : public QAbstractItemModel
   Q_OBJECT
 private:
   // store the media playlist
-  QMediaPlaylist *m_playlist;
-
-  // maps the data index->variant
-  // the index contains the playlist position the user
-  // selected. The variant is a chunck of bytes used
-  // to store some information. In this case, the song url
-  // to be played
-  QMap<QModelIndex, QVariant> m_data;
+  LibraryPlaylist *m_playlist;
+
+  // every string of the cached rows, and the words in them
+  StringPool m_strings;
+  SearchIndex m_search;
+
+  // the cached rows, one array per column. they hold
+  // the first m_loaded rows of the playlist
+  QVector<quint32> m_titles, m_artists, m_albums, m_paths;
+  QVector<qint64> m_durations;
+  int m_loaded;
+
+  // the rows told to the views by the last beginInsertItems()
+  // or beginRemoveItems(), -1 when they were past the loaded ones
+  int m_pendingFirst, m_pendingLast;
+
+  // while searching or sorting, the playlist positions of the
+  // rows shown, in the order they are shown
+  QVector<int> m_order;
+  bool m_arranged;
+  QString m_filter;
+  int m_sortColumn;
+  Qt::SortOrder m_sortOrder;
+
+  // fetches the rows the views did not ask for yet, between events
+  QTimer *m_loader;
+
+  // loads rows of the playlist into the columns
+  void loadRows(int first, int last);
+
+  // fills the columns of a row from the playlist and the library
+  void readRow(int row);
+
+  // fills the columns of a row from a library record
+  void storeRow(int row, const LibraryTrack &track);
+
+  // adds a string to the pool, and new strings to the search index
+  quint32 intern(const QString &string);
+
+  // finds the strings matching each word of the filter. it
+  // returns false when a word matches nothing
+  bool matchWords(QList<QVector<quint64> > *matches) const;
+
+  // tells whether a playlist position has a string
+  // matching each word of the filter
+  bool rowMatches(int position, const QList<QVector<quint64> > &matches) const;
+
+  // returns the place of a playlist position in the order of the
+  // sort column, as a number. every position has its own
+  quint64 sortKey(int position) const;
+
+  // sorts playlist positions by the sort column
+  void sortPositions(QVector<int> *positions) const;
+
+  // lists the rows to show for the filter and the sort column
+  void arrange();
+
+  // shows the songs inserted while searching or sorting
+  void insertArranged(int first, int last);
+
+  // tests playlist positions against the filter again, and moves
+  // their rows to their sorted place, while searching or sorting
+  void placeArranged(const QVector<int> &positions);
+
+  // tells the views the rows of some playlist positions changed.
+  // the positions are in increasing order
+  void positionsChanged(const QVector<int> &positions);
 public:
   // class constructor
   explicit PlaylistModel(QObject *parent = 0);
   enum Column {
       Title = 0,
+      Artist,
+      Album,
+      Duration,
+      Path,
       ColumnCount
   };
 
@@ -44,7 +137,9 @@ public slots:
   // some of the methods below MUST BE IMPLEMENTED so the
   // data to be retrieved may be accessed correctly
 
-  // returns the number of rows stored in model
+  // returns the number of rows stored in model. these are the
+  // rows loaded so far, not all the rows of the playlist, or
+  // the rows found while searching
   int rowCount(const QModelIndex &parent = QModelIndex()) const;
 
   // returns the number of columns stored in this model
@@ -62,16 +157,50 @@ public slots:
   // Qt::DisplayRole is usually associated to some text that is stored
   QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
 
+  // returns the names of the columns
+  QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+  // tells whether there are rows of the playlist still to be loaded
+  bool canFetchMore(const QModelIndex &parent) const;
+
+  // loads the next batch of rows
+  void fetchMore(const QModelIndex &parent);
+
+  // loads rows until the given playlist position is loaded,
+  // so the views can show it
+  void fetchUpTo(int row);
+
   // returns the playlist for the media player
-  QMediaPlaylist *playlist() const;
+  LibraryPlaylist *playlist() const;
 
   // tells what playlist shall be filled...
-  void setPlaylist(QMediaPlaylist *playlist);
+  void setPlaylist(LibraryPlaylist *playlist);
+
+  // shows only the songs with a title, artist, album or path word
+  // starting with each word of the text. an empty text shows them all
+  void setFilter(const QString &text);
+  QString filter() const;
+
+  // sorts the rows by a column. -1 gives back the playlist order
+  void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+  int sortColumn() const;
 
-  // A setData is used to insert itens into the playlist
-  bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::DisplayRole);
+  // returns the playlist position of a row, and the row of a
+  // playlist position. rows are loaded as needed to find it
+  int playlistPosition(int row) const;
+  QModelIndex indexOfPosition(int position);
+
+  // the tags of some songs changed. their rows are
+  // read again, and only those are repainted
+  void updateTracks(LibraryTrackList tracks);
+
+  // A setData changes the text of a title, artist or album
+  bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
 
 private slots:
+  // loads the next batch of rows, and ranks its strings
+  void loadMore();
+
   // some convenience functions to organize the internal structure of the list
   // they are used when a new playlist is to be defined
   // old playlist must be deleted an the new one has to be started up
@@ -0,0 +1,274 @@
+#include "searchindex.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// orders word ids by their words, and finds where a prefix would go
+class TermLess{
+public:
+  explicit TermLess(const QVector<QByteArray> &_terms) : terms(_terms){}
+  bool operator()(quint32 a, quint32 b) const {
+    return terms[a] < terms[b];
+  }
+  bool operator()(quint32 a, const QByteArray &b) const {
+    return terms[a] < b;
+  }
+
+private:
+  const QVector<QByteArray> &terms;
+};
+
+// orders string ids by their folded text
+class StringLess{
+public:
+  explicit StringLess(const SearchIndex *_index) : index(_index){}
+  bool operator()(quint32 a, quint32 b) const {
+    return index->lessThan(a, b);
+  }
+
+private:
+  const SearchIndex *index;
+};
+
+// a string to be sorted, with its sort key at hand
+struct RankEntry{
+  quint64 key;
+  quint32 id;
+};
+
+// orders the entries by key, and by folded text when the keys tie
+class RankEntryLess{
+public:
+  explicit RankEntryLess(const SearchIndex *_index) : index(_index){}
+  bool operator()(const RankEntry &a, const RankEntry &b) const {
+    if(a.key != b.key)
+      return a.key < b.key;
+    return index->lessThan(a.id, b.id);
+  }
+
+private:
+  const SearchIndex *index;
+};
+
+// letters of words are a-z, 0-9, and whatever is out of ascii
+static inline bool isWordByte(uchar c){
+  return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+// the first 8 bytes of a string, the first one on top,
+// so comparing keys compares strings
+static quint64 sortKey(const char *data, int size){
+  quint64 key = 0;
+  for(int i=0; i<8; i++){
+    key <<= 8;
+    if(i < size)
+      key |= uchar(data[i]);
+  }
+  return key;
+}
+
+SearchIndex::SearchIndex(){
+  starts.append(0);
+  sortedCount = 0;
+}
+
+QByteArray SearchIndex::fold(const QString &text){
+  const QChar *data = text.constData();
+  QByteArray result;
+  int i;
+
+  // ascii, most of a library, only needs lowering
+  result.reserve(text.size());
+  for(i=0; i<text.size(); i++){
+    ushort c = data[i].unicode();
+    if(c >= 0x80)
+      break;
+    result.append(char(c >= 'A' && c <= 'Z' ? c + 'a' - 'A' : c));
+  }
+  if(i == text.size())
+    return result;
+
+  // the rest is decomposed, so accents come apart from
+  // their letters and can be dropped
+  QString decomposed = text.mid(i).normalized(QString::NormalizationForm_KD);
+  QString stripped;
+  stripped.reserve(decomposed.size());
+  for(i=0; i<decomposed.size(); i++){
+    if(decomposed.at(i).category() != QChar::Mark_NonSpacing)
+      stripped.append(decomposed.at(i));
+  }
+  stripped = stripped.toCaseFolded();
+
+  // letters that do not decompose, but are written
+  // without their stroke when typed in a hurry
+  QString plain;
+  plain.reserve(stripped.size());
+  for(i=0; i<stripped.size(); i++){
+    switch(stripped.at(i).unicode()){
+    case 0x00df: plain.append(QLatin1String("ss")); break;
+    case 0x00e6: plain.append(QLatin1String("ae")); break;
+    case 0x00f8: plain.append(QLatin1Char('o')); break;
+    case 0x0111: plain.append(QLatin1Char('d')); break;
+    case 0x0142: plain.append(QLatin1Char('l')); break;
+    case 0x0153: plain.append(QLatin1String("oe")); break;
+    default: plain.append(stripped.at(i));
+    }
+  }
+  result.append(plain.toUtf8());
+  return result;
+}
+
+QList<QByteArray> SearchIndex::words(const QByteArray &folded){
+  QList<QByteArray> result;
+  int begin, end;
+
+  for(begin=0; begin<folded.size(); begin=end){
+    while(begin < folded.size() && !isWordByte(folded.at(begin)))
+      begin++;
+    for(end=begin; end<folded.size() && isWordByte(folded.at(end)); end++){}
+    if(end > begin)
+      result.append(folded.mid(begin, end - begin));
+  }
+  return result;
+}
+
+void SearchIndex::add(quint32 id, const QString &text){
+  Q_ASSERT(int(id) == size());
+  QByteArray string = fold(text);
+  const char *data = string.constData();
+  int begin, end;
+
+  folded.append(string);
+  starts.append(folded.size());
+  keys.append(sortKey(data, string.size()));
+
+  for(begin=0; begin<string.size(); begin=end){
+    while(begin < string.size() && !isWordByte(data[begin]))
+      begin++;
+    for(end=begin; end<string.size() && isWordByte(data[end]); end++){}
+    if(end == begin)
+      break;
+
+    // the word is looked up in place. it is only
+    // copied the first time it is seen
+    QByteArray word = QByteArray::fromRawData(data + begin, end - begin);
+    QHash<QByteArray, quint32>::const_iterator term = termIds.constFind(word);
+    quint32 termId;
+    if(term == termIds.constEnd()){
+      termId = terms.size();
+      terms.append(QByteArray(data + begin, end - begin));
+      termIds.insert(terms.last(), termId);
+      postings.append(QVector<quint32>());
+    }
+    else{
+      termId = term.value();
+    }
+
+    // a word repeated in a string is kept once
+    QVector<quint32> &ids = postings[termId];
+    if(ids.isEmpty() || ids.last() != id)
+      ids.append(id);
+  }
+}
+
+void SearchIndex::clear(){
+  folded.clear();
+  starts.clear();
+  starts.append(0);
+  keys.clear();
+  termIds.clear();
+  terms.clear();
+  postings.clear();
+  sortedTerms.clear();
+  sortedCount = 0;
+  sortedStrings.clear();
+  stringRanks.clear();
+}
+
+void SearchIndex::sortTerms() const{
+  if(sortedCount == terms.size())
+    return;
+
+  // the new words are sorted among themselves, then
+  // merged with the ones sorted before
+  TermLess less(terms);
+  int old = sortedTerms.size();
+  for(int i=sortedCount; i<terms.size(); i++)
+    sortedTerms.append(i);
+  std::sort(sortedTerms.begin() + old, sortedTerms.end(), less);
+  std::inplace_merge(sortedTerms.begin(), sortedTerms.begin() + old,
+                     sortedTerms.end(), less);
+  sortedCount = terms.size();
+}
+
+int SearchIndex::match(const QByteArray &prefix, QVector<quint64> *bits) const{
+  int count = 0;
+
+  sortTerms();
+  bits->fill(0, (size() + 63) / 64);
+  quint64 *set = bits->data();
+
+  // the words starting with the prefix sit together,
+  // from where the prefix itself would be
+  QVector<quint32>::const_iterator term =
+      std::lower_bound(sortedTerms.constBegin(), sortedTerms.constEnd(),
+                       prefix, TermLess(terms));
+  for(; term != sortedTerms.constEnd() && terms[*term].startsWith(prefix); ++term){
+    const QVector<quint32> &ids = postings[*term];
+    for(int i=0; i<ids.size(); i++)
+      set[ids[i] >> 6] |= quint64(1) << (ids[i] & 63);
+    count++;
+  }
+  return count;
+}
+
+bool SearchIndex::lessThan(quint32 a, quint32 b) const{
+  if(keys[a] != keys[b])
+    return keys[a] < keys[b];
+
+  // same first 8 bytes: the rest decides
+  int sizeA = starts[a+1] - starts[a];
+  int sizeB = starts[b+1] - starts[b];
+  if(sizeA <= 8 || sizeB <= 8)
+    return sizeA < sizeB;
+  int compared = memcmp(folded.constData() + starts[a] + 8,
+                        folded.constData() + starts[b] + 8,
+                        qMin(sizeA, sizeB) - 8);
+  return compared != 0 ? compared < 0 : sizeA < sizeB;
+}
+
+void SearchIndex::prepare() const{
+  sortTerms();
+  ranks();
+}
+
+const QVector<quint32> &SearchIndex::ranks() const{
+  if(sortedStrings.size() == size())
+    return stringRanks;
+
+  // the new strings are sorted among themselves, merged
+  // with the ones sorted before, and every rank is set
+  // again: one pass, no comparison of the old strings.
+  // the keys are sorted along with the ids, so most
+  // comparisons do not look anything up
+  std::vector<RankEntry> entries;
+  int old = sortedStrings.size();
+  quint32 rank = 0;
+  entries.resize(size() - old);
+  for(int i=old; i<size(); i++){
+    entries[i-old].key = keys[i];
+    entries[i-old].id = i;
+  }
+  std::sort(entries.begin(), entries.end(), RankEntryLess(this));
+  for(size_t i=0; i<entries.size(); i++)
+    sortedStrings.append(entries[i].id);
+  std::inplace_merge(sortedStrings.begin(), sortedStrings.begin() + old,
+                     sortedStrings.end(), StringLess(this));
+  stringRanks.fill(0, size());
+  for(int i=0; i<sortedStrings.size(); i++){
+    if(i > 0 && lessThan(sortedStrings[i-1], sortedStrings[i]))
+      rank++;
+    stringRanks[sortedStrings[i]] = rank;
+  }
+  return stringRanks;
+}
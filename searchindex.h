@@ -0,0 +1,136 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief The SearchIndex class finds strings by the words they contain
+ * @details Strings are added one by one, with consecutive ids starting at
+ * 0, as a StringPool hands them out. Each string is folded (case and
+ * diacritics are dropped, so "Björk" is found as "bjork") and split into
+ * words. Each word keeps the ids of the strings it appears in, in
+ * ascending order.
+ *
+ * A query word matches every indexed word it is a prefix of. The indexed
+ * words are kept sorted, so they are found by binary search, and the ids
+ * of all of them are gathered into a bit set, one bit per string. Adding
+ * strings costs the same however many there are; the words that are new
+ * since the last query are sorted into place by the next one.
+ *
+ * The folded strings are kept too, and so is their order, so sorting a
+ * table by a column of string ids compares integers. Like the words, the
+ * strings added since the last sort are merged into place by the next one.
+ */
+class SearchIndex{
+public:
+  /**
+   * @brief Creates an empty index
+   */
+  SearchIndex();
+
+  /**
+   * @brief fold drops the case and the diacritics of a text
+   * @return the folded text, in utf-8
+   */
+  static QByteArray fold(const QString &text);
+
+  /**
+   * @brief words splits a folded text into its words
+   */
+  static QList<QByteArray> words(const QByteArray &folded);
+
+  /**
+   * @brief add indexes a string
+   * @param id must be size(): ids are consecutive
+   */
+  void add(quint32 id, const QString &text);
+
+  /**
+   * @brief size returns the number of strings added
+   */
+  int size() const { return starts.size() - 1; }
+
+  /**
+   * @brief clear forgets every string
+   */
+  void clear();
+
+  /**
+   * @brief match finds the strings with a word that starts with a prefix
+   * @param prefix is a folded word
+   * @param bits receives one bit per string, set for the strings found.
+   * It is resized to hold size() bits
+   * @return the number of words the prefix matched
+   */
+  int match(const QByteArray &prefix, QVector<quint64> *bits) const;
+
+  /**
+   * @brief lessThan tells whether a string comes before another one, by
+   * their folded text
+   */
+  bool lessThan(quint32 a, quint32 b) const;
+
+  /**
+   * @brief ranks returns the place of each string in the order of their
+   * folded text, by id. Strings whose folded text is the same have the
+   * same rank
+   */
+  const QVector<quint32> &ranks() const;
+
+  /**
+   * @brief prepare sorts the words and the strings added since the last
+   * query or sort into place, so the next ones start right away. It is
+   * meant to be called as strings come in, a batch at a time
+   */
+  void prepare() const;
+
+  /**
+   * @brief contains tells whether the bit of a string is set in a bit set
+   * filled by match()
+   */
+  static bool contains(const QVector<quint64> &bits, quint32 id){
+    return int(id >> 6) < bits.size() && (bits[id >> 6] >> (id & 63)) & 1;
+  }
+
+private:
+  /**
+   * @brief sortTerms sorts the words added since the last query into place
+   */
+  void sortTerms() const;
+
+  /**
+   * @brief folded holds the folded strings one after another. String i
+   * spans starts[i] to starts[i+1]. keys holds their first 8 bytes as a
+   * number, so most comparisons need not read the strings
+   */
+  QByteArray folded;
+  QVector<quint32> starts;
+  QVector<quint64> keys;
+
+  /**
+   * @brief terms holds every word, and postings the ids of the strings
+   * each word appears in
+   */
+  QHash<QByteArray, quint32> termIds;
+  QVector<QByteArray> terms;
+  QVector<QVector<quint32> > postings;
+
+  /**
+   * @brief sortedTerms holds the first sortedCount words, in order
+   */
+  mutable QVector<quint32> sortedTerms;
+  mutable int sortedCount;
+
+  /**
+   * @brief sortedStrings holds the ids of the strings ranked so far, in
+   * order, and stringRanks their ranks
+   */
+  mutable QVector<quint32> sortedStrings;
+  mutable QVector<quint32> stringRanks;
+};
+
+#endif // SEARCHINDEX_H
@@ -0,0 +1,632 @@
+#include "simdkernels.h"
+#include <cmath>
+#include <cstring>
+
+// the vector kernels are only built for x86 with gcc or clang. each
+// function asks for its own instruction set through the target
+// attribute, so no extra compiler flags are needed and the program
+// still runs on cpus that lack them
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+#undef CLAMP
+#define CLAMP(a,min,max) ((a) < (min) ? (min) : (a) > (max) ? (max) : (a))
+
+/*
+ * scalar kernels: they work everywhere and are the reference
+ * for the vector ones
+ */
+
+template <typename T>
+static void radix4Scalar(std::complex<T> *x, size_t n, size_t m, const std::complex<T> *w){
+  std::complex<T> a0, p1, p2, p3, s0, d0, s1, d1, t;
+  for(size_t base=0; base<n; base+=4*m){
+    std::complex<T> *b = x+base;
+    for(size_t k=0; k<m; k++){
+      a0 = b[k];
+      p1 = w[m+k]*b[k+m];
+      p2 = w[k]*b[k+2*m];
+      p3 = w[2*m+k]*b[k+3*m];
+
+      s0 = a0 + p1;
+      d0 = a0 - p1;
+      s1 = p2 + p3;
+      // multiply (p2-p3) by -i
+      t = p2 - p3;
+      d1 = std::complex<T>(t.imag(), -t.real());
+
+      b[k]     = s0 + s1;
+      b[k+m]   = d0 + d1;
+      b[k+2*m] = s0 - s1;
+      b[k+3*m] = d0 - d1;
+    }
+  }
+}
+
+template <typename T>
+static void magnitudesScalar(const std::complex<T> *x, T *out, size_t n, T scale){
+  for(size_t i=0; i<n; i++){
+    T amplitude = scale*std::sqrt(x[i].real()*x[i].real() + x[i].imag()*x[i].imag());
+    out[i] = CLAMP(amplitude, T(0), T(1));
+  }
+}
+
+template <typename T>
+static T dotScalar(const T *a, const T *b, size_t n){
+  T sum = 0;
+  for(size_t i=0; i<n; i++)
+    sum += a[i]*b[i];
+  return sum;
+}
+
+// log2(1+m) for m in [0,1), least squares fit. the error
+// is below 1.2e-4 (0.0007 dB when turned into decibels)
+#define LOG2_C1 1.43863803f
+#define LOG2_C2 -0.677743267f
+#define LOG2_C3 0.321879707f
+#define LOG2_C4 -0.0828606982f
+
+// the exponent is read straight from the bits and the mantissa
+// goes through the polynomial. x must not be negative
+static inline float log2Approx(float x){
+  unsigned bits;
+  float e, m;
+  memcpy(&bits, &x, sizeof(bits));
+  e = float(int(bits >> 23) - 127);
+  bits = (bits & 0x007FFFFF) | 0x3F800000;
+  memcpy(&m, &bits, sizeof(m));
+  m -= 1;
+  return e + m*(LOG2_C1 + m*(LOG2_C2 + m*(LOG2_C3 + m*LOG2_C4)));
+}
+
+template <typename T>
+static void logScaleScalar(const T *in, T *out, size_t n, T slope, T offset){
+  for(size_t i=0; i<n; i++){
+    T value = offset + slope*log2Approx(float(in[i]));
+    out[i] = CLAMP(value, T(0), T(1));
+  }
+}
+
+#ifdef SIMD_X86
+
+/*
+ * sse2 kernels: one complex value per register
+ */
+
+// (a.re*w.re - a.im*w.im, a.re*w.im + a.im*w.re)
+__attribute__((target("sse2")))
+static inline __m128d cmulSSE2(__m128d a, __m128d w){
+  const __m128d sign = _mm_set_pd(0.0, -0.0);
+  __m128d wr = _mm_unpacklo_pd(w, w);
+  __m128d wi = _mm_unpackhi_pd(w, w);
+  __m128d swapped = _mm_shuffle_pd(a, a, 1);
+  return _mm_add_pd(_mm_mul_pd(a, wr), _mm_xor_pd(_mm_mul_pd(swapped, wi), sign));
+}
+
+__attribute__((target("sse2")))
+static void radix4SSE2(Complex *x, size_t n, size_t m, const Complex *w){
+  const __m128d sign = _mm_set_pd(-0.0, 0.0);
+  double *d = reinterpret_cast<double*>(x);
+  const double *tw = reinterpret_cast<const double*>(w);
+  for(size_t base=0; base<n; base+=4*m){
+    double *b0 = d+2*base;
+    double *b1 = b0+2*m;
+    double *b2 = b1+2*m;
+    double *b3 = b2+2*m;
+    for(size_t k=0; k<m; k++){
+      __m128d a0 = _mm_loadu_pd(b0+2*k);
+      __m128d p1 = cmulSSE2(_mm_loadu_pd(b1+2*k), _mm_loadu_pd(tw+2*(m+k)));
+      __m128d p2 = cmulSSE2(_mm_loadu_pd(b2+2*k), _mm_loadu_pd(tw+2*k));
+      __m128d p3 = cmulSSE2(_mm_loadu_pd(b3+2*k), _mm_loadu_pd(tw+2*(2*m+k)));
+      __m128d s0 = _mm_add_pd(a0, p1);
+      __m128d d0 = _mm_sub_pd(a0, p1);
+      __m128d s1 = _mm_add_pd(p2, p3);
+      __m128d t = _mm_sub_pd(p2, p3);
+      // multiply by -i: (re,im) -> (im,-re)
+      __m128d d1 = _mm_xor_pd(_mm_shuffle_pd(t, t, 1), sign);
+      _mm_storeu_pd(b0+2*k, _mm_add_pd(s0, s1));
+      _mm_storeu_pd(b1+2*k, _mm_add_pd(d0, d1));
+      _mm_storeu_pd(b2+2*k, _mm_sub_pd(s0, s1));
+      _mm_storeu_pd(b3+2*k, _mm_sub_pd(d0, d1));
+    }
+  }
+}
+
+__attribute__((target("sse2")))
+static void magnitudesSSE2(const Complex *x, double *out, size_t n, double scale){
+  const double *d = reinterpret_cast<const double*>(x);
+  const __m128d vscale = _mm_set1_pd(scale);
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d one = _mm_set1_pd(1.0);
+  size_t i = 0;
+  for(; i+2<=n; i+=2){
+    __m128d a = _mm_loadu_pd(d+2*i);
+    __m128d b = _mm_loadu_pd(d+2*i+2);
+    a = _mm_mul_pd(a, a);
+    b = _mm_mul_pd(b, b);
+    // (re0^2 + im0^2, re1^2 + im1^2)
+    __m128d power = _mm_add_pd(_mm_unpacklo_pd(a, b), _mm_unpackhi_pd(a, b));
+    __m128d amplitude = _mm_mul_pd(_mm_sqrt_pd(power), vscale);
+    _mm_storeu_pd(out+i, _mm_min_pd(_mm_max_pd(amplitude, zero), one));
+  }
+  magnitudesScalar<double>(x+i, out+i, n-i, scale);
+}
+
+/*
+ * avx2 kernels: two complex values per register
+ */
+
+__attribute__((target("avx2,fma")))
+static inline __m256d cmulAVX2(__m256d a, __m256d w){
+  __m256d wr = _mm256_movedup_pd(w);
+  __m256d wi = _mm256_permute_pd(w, 0xF);
+  __m256d swapped = _mm256_permute_pd(a, 0x5);
+  return _mm256_fmaddsub_pd(a, wr, _mm256_mul_pd(swapped, wi));
+}
+
+__attribute__((target("avx2,fma")))
+static void radix4AVX2(Complex *x, size_t n, size_t m, const Complex *w){
+  // the first pass merges single values. there is nothing to pair up
+  if(m < 2){
+    radix4SSE2(x, n, m, w);
+    return;
+  }
+  const __m256d sign = _mm256_set_pd(-0.0, 0.0, -0.0, 0.0);
+  double *d = reinterpret_cast<double*>(x);
+  const double *tw = reinterpret_cast<const double*>(w);
+  for(size_t base=0; base<n; base+=4*m){
+    double *b0 = d+2*base;
+    double *b1 = b0+2*m;
+    double *b2 = b1+2*m;
+    double *b3 = b2+2*m;
+    for(size_t k=0; k<m; k+=2){
+      __m256d a0 = _mm256_loadu_pd(b0+2*k);
+      __m256d p1 = cmulAVX2(_mm256_loadu_pd(b1+2*k), _mm256_loadu_pd(tw+2*(m+k)));
+      __m256d p2 = cmulAVX2(_mm256_loadu_pd(b2+2*k), _mm256_loadu_pd(tw+2*k));
+      __m256d p3 = cmulAVX2(_mm256_loadu_pd(b3+2*k), _mm256_loadu_pd(tw+2*(2*m+k)));
+      __m256d s0 = _mm256_add_pd(a0, p1);
+      __m256d d0 = _mm256_sub_pd(a0, p1);
+      __m256d s1 = _mm256_add_pd(p2, p3);
+      __m256d t = _mm256_sub_pd(p2, p3);
+      __m256d d1 = _mm256_xor_pd(_mm256_permute_pd(t, 0x5), sign);
+      _mm256_storeu_pd(b0+2*k, _mm256_add_pd(s0, s1));
+      _mm256_storeu_pd(b1+2*k, _mm256_add_pd(d0, d1));
+      _mm256_storeu_pd(b2+2*k, _mm256_sub_pd(s0, s1));
+      _mm256_storeu_pd(b3+2*k, _mm256_sub_pd(d0, d1));
+    }
+  }
+}
+
+__attribute__((target("avx2,fma")))
+static void magnitudesAVX2(const Complex *x, double *out, size_t n, double scale){
+  const double *d = reinterpret_cast<const double*>(x);
+  const __m256d vscale = _mm256_set1_pd(scale);
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d one = _mm256_set1_pd(1.0);
+  size_t i = 0;
+  for(; i+4<=n; i+=4){
+    __m256d a = _mm256_loadu_pd(d+2*i);
+    __m256d b = _mm256_loadu_pd(d+2*i+4);
+    a = _mm256_mul_pd(a, a);
+    b = _mm256_mul_pd(b, b);
+    // hadd gives (|0|^2, |2|^2, |1|^2, |3|^2). put them back in order
+    __m256d power = _mm256_permute4x64_pd(_mm256_hadd_pd(a, b), 0xD8);
+    __m256d amplitude = _mm256_mul_pd(_mm256_sqrt_pd(power), vscale);
+    _mm256_storeu_pd(out+i, _mm256_min_pd(_mm256_max_pd(amplitude, zero), one));
+  }
+  magnitudesSSE2(x+i, out+i, n-i, scale);
+}
+
+/*
+ * avx-512 kernels: four complex values per register
+ */
+
+__attribute__((target("avx512f,avx2,fma")))
+static inline __m512d cmulAVX512(__m512d a, __m512d w){
+  __m512d wr = _mm512_shuffle_pd(w, w, 0x00);
+  __m512d wi = _mm512_shuffle_pd(w, w, 0xFF);
+  __m512d swapped = _mm512_shuffle_pd(a, a, 0x55);
+  return _mm512_fmaddsub_pd(a, wr, _mm512_mul_pd(swapped, wi));
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static void radix4AVX512(Complex *x, size_t n, size_t m, const Complex *w){
+  // first passes have too few values in each block
+  if(m < 4){
+    radix4AVX2(x, n, m, w);
+    return;
+  }
+  // flips the sign of the imaginary parts
+  const __m512i sign = _mm512_castpd_si512(_mm512_set_pd(-0.0, 0.0, -0.0, 0.0, -0.0, 0.0, -0.0, 0.0));
+  double *d = reinterpret_cast<double*>(x);
+  const double *tw = reinterpret_cast<const double*>(w);
+  for(size_t base=0; base<n; base+=4*m){
+    double *b0 = d+2*base;
+    double *b1 = b0+2*m;
+    double *b2 = b1+2*m;
+    double *b3 = b2+2*m;
+    for(size_t k=0; k<m; k+=4){
+      __m512d a0 = _mm512_loadu_pd(b0+2*k);
+      __m512d p1 = cmulAVX512(_mm512_loadu_pd(b1+2*k), _mm512_loadu_pd(tw+2*(m+k)));
+      __m512d p2 = cmulAVX512(_mm512_loadu_pd(b2+2*k), _mm512_loadu_pd(tw+2*k));
+      __m512d p3 = cmulAVX512(_mm512_loadu_pd(b3+2*k), _mm512_loadu_pd(tw+2*(2*m+k)));
+      __m512d s0 = _mm512_add_pd(a0, p1);
+      __m512d d0 = _mm512_sub_pd(a0, p1);
+      __m512d s1 = _mm512_add_pd(p2, p3);
+      __m512d t = _mm512_sub_pd(p2, p3);
+      __m512d d1 = _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(_mm512_shuffle_pd(t, t, 0x55)), sign));
+      _mm512_storeu_pd(b0+2*k, _mm512_add_pd(s0, s1));
+      _mm512_storeu_pd(b1+2*k, _mm512_add_pd(d0, d1));
+      _mm512_storeu_pd(b2+2*k, _mm512_sub_pd(s0, s1));
+      _mm512_storeu_pd(b3+2*k, _mm512_sub_pd(d0, d1));
+    }
+  }
+}
+
+/*
+ * single precision kernels. a register holds twice as many
+ * complex values as in double precision
+ */
+
+// sse: two complex values per register
+__attribute__((target("sse2")))
+static inline __m128 cmulSSE2f(__m128 a, __m128 w){
+  const __m128 sign = _mm_set_ps(0.0f, -0.0f, 0.0f, -0.0f);
+  __m128 wr = _mm_shuffle_ps(w, w, _MM_SHUFFLE(2,2,0,0));
+  __m128 wi = _mm_shuffle_ps(w, w, _MM_SHUFFLE(3,3,1,1));
+  __m128 swapped = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1));
+  return _mm_add_ps(_mm_mul_ps(a, wr), _mm_xor_ps(_mm_mul_ps(swapped, wi), sign));
+}
+
+__attribute__((target("sse2")))
+static void radix4SSE2f(std::complex<float> *x, size_t n, size_t m, const std::complex<float> *w){
+  // the first pass merges single values. there is nothing to pair up
+  if(m < 2){
+    radix4Scalar(x, n, m, w);
+    return;
+  }
+  const __m128 sign = _mm_set_ps(-0.0f, 0.0f, -0.0f, 0.0f);
+  float *d = reinterpret_cast<float*>(x);
+  const float *tw = reinterpret_cast<const float*>(w);
+  for(size_t base=0; base<n; base+=4*m){
+    float *b0 = d+2*base;
+    float *b1 = b0+2*m;
+    float *b2 = b1+2*m;
+    float *b3 = b2+2*m;
+    for(size_t k=0; k<m; k+=2){
+      __m128 a0 = _mm_loadu_ps(b0+2*k);
+      __m128 p1 = cmulSSE2f(_mm_loadu_ps(b1+2*k), _mm_loadu_ps(tw+2*(m+k)));
+      __m128 p2 = cmulSSE2f(_mm_loadu_ps(b2+2*k), _mm_loadu_ps(tw+2*k));
+      __m128 p3 = cmulSSE2f(_mm_loadu_ps(b3+2*k), _mm_loadu_ps(tw+2*(2*m+k)));
+      __m128 s0 = _mm_add_ps(a0, p1);
+      __m128 d0 = _mm_sub_ps(a0, p1);
+      __m128 s1 = _mm_add_ps(p2, p3);
+      __m128 t = _mm_sub_ps(p2, p3);
+      __m128 d1 = _mm_xor_ps(_mm_shuffle_ps(t, t, _MM_SHUFFLE(2,3,0,1)), sign);
+      _mm_storeu_ps(b0+2*k, _mm_add_ps(s0, s1));
+      _mm_storeu_ps(b1+2*k, _mm_add_ps(d0, d1));
+      _mm_storeu_ps(b2+2*k, _mm_sub_ps(s0, s1));
+      _mm_storeu_ps(b3+2*k, _mm_sub_ps(d0, d1));
+    }
+  }
+}
+
+__attribute__((target("sse2")))
+static void magnitudesSSE2f(const std::complex<float> *x, float *out, size_t n, float scale){
+  const float *d = reinterpret_cast<const float*>(x);
+  const __m128 vscale = _mm_set1_ps(scale);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  size_t i = 0;
+  for(; i+4<=n; i+=4){
+    __m128 a = _mm_loadu_ps(d+2*i);
+    __m128 b = _mm_loadu_ps(d+2*i+4);
+    a = _mm_mul_ps(a, a);
+    b = _mm_mul_ps(b, b);
+    __m128 power = _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0)),
+                              _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1)));
+    __m128 amplitude = _mm_mul_ps(_mm_sqrt_ps(power), vscale);
+    _mm_storeu_ps(out+i, _mm_min_ps(_mm_max_ps(amplitude, zero), one));
+  }
+  magnitudesScalar(x+i, out+i, n-i, scale);
+}
+
+// avx2: four complex values per register
+__attribute__((target("avx2,fma")))
+static inline __m256 cmulAVX2f(__m256 a, __m256 w){
+  __m256 wr = _mm256_moveldup_ps(w);
+  __m256 wi = _mm256_movehdup_ps(w);
+  __m256 swapped = _mm256_permute_ps(a, 0xB1);
+  return _mm256_fmaddsub_ps(a, wr, _mm256_mul_ps(swapped, wi));
+}
+
+__attribute__((target("avx2,fma")))
+static void radix4AVX2f(std::complex<float> *x, size_t n, size_t m, const std::complex<float> *w){
+  if(m < 4){
+    radix4SSE2f(x, n, m, w);
+    return;
+  }
+  const __m256 sign = _mm256_set_ps(-0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f);
+  float *d = reinterpret_cast<float*>(x);
+  const float *tw = reinterpret_cast<const float*>(w);
+  for(size_t base=0; base<n; base+=4*m){
+    float *b0 = d+2*base;
+    float *b1 = b0+2*m;
+    float *b2 = b1+2*m;
+    float *b3 = b2+2*m;
+    for(size_t k=0; k<m; k+=4){
+      __m256 a0 = _mm256_loadu_ps(b0+2*k);
+      __m256 p1 = cmulAVX2f(_mm256_loadu_ps(b1+2*k), _mm256_loadu_ps(tw+2*(m+k)));
+      __m256 p2 = cmulAVX2f(_mm256_loadu_ps(b2+2*k), _mm256_loadu_ps(tw+2*k));
+      __m256 p3 = cmulAVX2f(_mm256_loadu_ps(b3+2*k), _mm256_loadu_ps(tw+2*(2*m+k)));
+      __m256 s0 = _mm256_add_ps(a0, p1);
+      __m256 d0 = _mm256_sub_ps(a0, p1);
+      __m256 s1 = _mm256_add_ps(p2, p3);
+      __m256 t = _mm256_sub_ps(p2, p3);
+      __m256 d1 = _mm256_xor_ps(_mm256_permute_ps(t, 0xB1), sign);
+      _mm256_storeu_ps(b0+2*k, _mm256_add_ps(s0, s1));
+      _mm256_storeu_ps(b1+2*k, _mm256_add_ps(d0, d1));
+      _mm256_storeu_ps(b2+2*k, _mm256_sub_ps(s0, s1));
+      _mm256_storeu_ps(b3+2*k, _mm256_sub_ps(d0, d1));
+    }
+  }
+}
+
+__attribute__((target("avx2,fma")))
+static void magnitudesAVX2f(const std::complex<float> *x, float *out, size_t n, float scale){
+  const float *d = reinterpret_cast<const float*>(x);
+  const __m256 vscale = _mm256_set1_ps(scale);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  size_t i = 0;
+  for(; i+8<=n; i+=8){
+    __m256 a = _mm256_loadu_ps(d+2*i);
+    __m256 b = _mm256_loadu_ps(d+2*i+8);
+    a = _mm256_mul_ps(a, a);
+    b = _mm256_mul_ps(b, b);
+    // the shuffles leave the values in order 0 1 4 5 2 3 6 7
+    __m256 power = _mm256_add_ps(_mm256_shuffle_ps(a, b, 0x88), _mm256_shuffle_ps(a, b, 0xDD));
+    power = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(power), 0xD8));
+    __m256 amplitude = _mm256_mul_ps(_mm256_sqrt_ps(power), vscale);
+    _mm256_storeu_ps(out+i, _mm256_min_ps(_mm256_max_ps(amplitude, zero), one));
+  }
+  magnitudesSSE2f(x+i, out+i, n-i, scale);
+}
+
+// avx-512: eight complex values per register
+__attribute__((target("avx512f,avx2,fma")))
+static inline __m512 cmulAVX512f(__m512 a, __m512 w){
+  __m512 wr = _mm512_shuffle_ps(w, w, 0xA0);
+  __m512 wi = _mm512_shuffle_ps(w, w, 0xF5);
+  __m512 swapped = _mm512_shuffle_ps(a, a, 0xB1);
+  return _mm512_fmaddsub_ps(a, wr, _mm512_mul_ps(swapped, wi));
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static void radix4AVX512f(std::complex<float> *x, size_t n, size_t m, const std::complex<float> *w){
+  if(m < 8){
+    radix4AVX2f(x, n, m, w);
+    return;
+  }
+  // flips the sign of the imaginary parts
+  const __m512i sign = _mm512_castps_si512(_mm512_set_ps(-0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f,
+                                                         -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f));
+  float *d = reinterpret_cast<float*>(x);
+  const float *tw = reinterpret_cast<const float*>(w);
+  for(size_t base=0; base<n; base+=4*m){
+    float *b0 = d+2*base;
+    float *b1 = b0+2*m;
+    float *b2 = b1+2*m;
+    float *b3 = b2+2*m;
+    for(size_t k=0; k<m; k+=8){
+      __m512 a0 = _mm512_loadu_ps(b0+2*k);
+      __m512 p1 = cmulAVX512f(_mm512_loadu_ps(b1+2*k), _mm512_loadu_ps(tw+2*(m+k)));
+      __m512 p2 = cmulAVX512f(_mm512_loadu_ps(b2+2*k), _mm512_loadu_ps(tw+2*k));
+      __m512 p3 = cmulAVX512f(_mm512_loadu_ps(b3+2*k), _mm512_loadu_ps(tw+2*(2*m+k)));
+      __m512 s0 = _mm512_add_ps(a0, p1);
+      __m512 d0 = _mm512_sub_ps(a0, p1);
+      __m512 s1 = _mm512_add_ps(p2, p3);
+      __m512 t = _mm512_sub_ps(p2, p3);
+      __m512 d1 = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(_mm512_shuffle_ps(t, t, 0xB1)), sign));
+      _mm512_storeu_ps(b0+2*k, _mm512_add_ps(s0, s1));
+      _mm512_storeu_ps(b1+2*k, _mm512_add_ps(d0, d1));
+      _mm512_storeu_ps(b2+2*k, _mm512_sub_ps(s0, s1));
+      _mm512_storeu_ps(b3+2*k, _mm512_sub_ps(d0, d1));
+    }
+  }
+}
+
+/*
+ * dot products. they are short (a few values to a few hundred),
+ * so one accumulator per register is enough
+ */
+
+__attribute__((target("sse2")))
+static double dotSSE2(const double *a, const double *b, size_t n){
+  __m128d sum = _mm_setzero_pd();
+  double lanes[2];
+  size_t i = 0;
+  for(; i+2<=n; i+=2)
+    sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(a+i), _mm_loadu_pd(b+i)));
+  _mm_storeu_pd(lanes, sum);
+  for(; i<n; i++)
+    lanes[0] += a[i]*b[i];
+  return lanes[0] + lanes[1];
+}
+
+__attribute__((target("sse2")))
+static float dotSSE2f(const float *a, const float *b, size_t n){
+  __m128 sum = _mm_setzero_ps();
+  float lanes[4];
+  size_t i = 0;
+  for(; i+4<=n; i+=4)
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+  _mm_storeu_ps(lanes, sum);
+  for(; i<n; i++)
+    lanes[0] += a[i]*b[i];
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+__attribute__((target("avx2,fma")))
+static double dotAVX2(const double *a, const double *b, size_t n){
+  __m256d sum = _mm256_setzero_pd();
+  double lanes[4];
+  size_t i = 0;
+  for(; i+4<=n; i+=4)
+    sum = _mm256_fmadd_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i), sum);
+  _mm256_storeu_pd(lanes, sum);
+  for(; i<n; i++)
+    lanes[0] += a[i]*b[i];
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+__attribute__((target("avx2,fma")))
+static float dotAVX2f(const float *a, const float *b, size_t n){
+  __m256 sum = _mm256_setzero_ps();
+  float lanes[8];
+  size_t i = 0;
+  for(; i+8<=n; i+=8)
+    sum = _mm256_fmadd_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i), sum);
+  _mm256_storeu_ps(lanes, sum);
+  for(; i<n; i++)
+    lanes[0] += a[i]*b[i];
+  return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+      ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+/*
+ * log scale kernels. the log is always taken in single
+ * precision: its error is way above the float rounding anyway
+ */
+
+// clamp(offset + slope*log2(x), 0, 1) for four floats
+__attribute__((target("sse2")))
+static inline __m128 logScaleSSE2(__m128 x, __m128 slope, __m128 offset){
+  __m128i bits = _mm_castps_si128(x);
+  __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+  bits = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000));
+  __m128 m = _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.0f));
+  __m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(LOG2_C4), m), _mm_set1_ps(LOG2_C3));
+  p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(LOG2_C2));
+  p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(LOG2_C1));
+  __m128 value = _mm_add_ps(offset, _mm_mul_ps(slope, _mm_add_ps(e, _mm_mul_ps(p, m))));
+  return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+__attribute__((target("sse2")))
+static void logScaleSSE2f(const float *in, float *out, size_t n, float slope, float offset){
+  const __m128 vslope = _mm_set1_ps(slope);
+  const __m128 voffset = _mm_set1_ps(offset);
+  size_t i = 0;
+  for(; i+4<=n; i+=4)
+    _mm_storeu_ps(out+i, logScaleSSE2(_mm_loadu_ps(in+i), vslope, voffset));
+  logScaleScalar(in+i, out+i, n-i, slope, offset);
+}
+
+__attribute__((target("sse2")))
+static void logScaleSSE2(const double *in, double *out, size_t n, double slope, double offset){
+  const __m128 vslope = _mm_set1_ps(float(slope));
+  const __m128 voffset = _mm_set1_ps(float(offset));
+  size_t i = 0;
+  for(; i+4<=n; i+=4){
+    __m128 x = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(in+i)), _mm_cvtpd_ps(_mm_loadu_pd(in+i+2)));
+    __m128 value = logScaleSSE2(x, vslope, voffset);
+    _mm_storeu_pd(out+i, _mm_cvtps_pd(value));
+    _mm_storeu_pd(out+i+2, _mm_cvtps_pd(_mm_movehl_ps(value, value)));
+  }
+  logScaleScalar(in+i, out+i, n-i, slope, offset);
+}
+
+// clamp(offset + slope*log2(x), 0, 1) for eight floats
+__attribute__((target("avx2,fma")))
+static inline __m256 logScaleAVX2(__m256 x, __m256 slope, __m256 offset){
+  __m256i bits = _mm256_castps_si256(x);
+  __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+  bits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+                         _mm256_set1_epi32(0x3F800000));
+  __m256 m = _mm256_sub_ps(_mm256_castsi256_ps(bits), _mm256_set1_ps(1.0f));
+  __m256 p = _mm256_fmadd_ps(_mm256_set1_ps(LOG2_C4), m, _mm256_set1_ps(LOG2_C3));
+  p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(LOG2_C2));
+  p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(LOG2_C1));
+  __m256 value = _mm256_fmadd_ps(slope, _mm256_fmadd_ps(p, m, e), offset);
+  return _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+}
+
+__attribute__((target("avx2,fma")))
+static void logScaleAVX2f(const float *in, float *out, size_t n, float slope, float offset){
+  const __m256 vslope = _mm256_set1_ps(slope);
+  const __m256 voffset = _mm256_set1_ps(offset);
+  size_t i = 0;
+  for(; i+8<=n; i+=8)
+    _mm256_storeu_ps(out+i, logScaleAVX2(_mm256_loadu_ps(in+i), vslope, voffset));
+  for(; i<n; i++){
+    float value = offset + slope*log2Approx(in[i]);
+    out[i] = CLAMP(value, 0.0f, 1.0f);
+  }
+}
+
+__attribute__((target("avx2,fma")))
+static void logScaleAVX2(const double *in, double *out, size_t n, double slope, double offset){
+  const __m256 vslope = _mm256_set1_ps(float(slope));
+  const __m256 voffset = _mm256_set1_ps(float(offset));
+  size_t i = 0;
+  for(; i+8<=n; i+=8){
+    __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_loadu_pd(in+i))),
+                                    _mm256_cvtpd_ps(_mm256_loadu_pd(in+i+4)), 1);
+    __m256 value = logScaleAVX2(x, vslope, voffset);
+    _mm256_storeu_pd(out+i, _mm256_cvtps_pd(_mm256_castps256_ps128(value)));
+    _mm256_storeu_pd(out+i+4, _mm256_cvtps_pd(_mm256_extractf128_ps(value, 1)));
+  }
+  for(; i<n; i++){
+    double value = offset + slope*log2Approx(float(in[i]));
+    out[i] = CLAMP(value, 0.0, 1.0);
+  }
+}
+
+#endif // SIMD_X86
+
+static const FFTKernels kernelTable[] = {
+  { SIMD_SCALAR, "scalar", radix4Scalar<double>, magnitudesScalar<double>,
+    radix4Scalar<float>, magnitudesScalar<float>, dotScalar<double>, dotScalar<float>,
+    logScaleScalar<double>, logScaleScalar<float> },
+#ifdef SIMD_X86
+  { SIMD_SSE2, "sse2", radix4SSE2, magnitudesSSE2, radix4SSE2f, magnitudesSSE2f,
+    dotSSE2, dotSSE2f, logScaleSSE2, logScaleSSE2f },
+  { SIMD_AVX2, "avx2", radix4AVX2, magnitudesAVX2, radix4AVX2f, magnitudesAVX2f,
+    dotAVX2, dotAVX2f, logScaleAVX2, logScaleAVX2f },
+  // the passes over bins and bands are short. avx2 is good enough for them
+  { SIMD_AVX512, "avx512", radix4AVX512, magnitudesAVX2, radix4AVX512f, magnitudesAVX2f,
+    dotAVX2, dotAVX2f, logScaleAVX2, logScaleAVX2f },
+#endif
+};
+
+static SimdLevel detectSimdLevel(){
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f"))
+    return SIMD_AVX512;
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return SIMD_AVX2;
+  if(__builtin_cpu_supports("sse2"))
+    return SIMD_SSE2;
+#endif
+  return SIMD_SCALAR;
+}
+
+SimdLevel simdLevel(){
+  static const SimdLevel level = detectSimdLevel();
+  return level;
+}
+
+const FFTKernels &fftKernels(SimdLevel level){
+  if(level > simdLevel())
+    level = simdLevel();
+  return kernelTable[level];
+}
+
+const FFTKernels &fftKernels(){
+  static const FFTKernels &kernels = fftKernels(simdLevel());
+  return kernels;
+}
@@ -0,0 +1,164 @@
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+#include <cstddef>
+#include "fft.h"
+
+/**
+ * @brief SimdLevel lists the instruction sets the kernels are written for
+ */
+enum SimdLevel{
+  SIMD_SCALAR = 0,
+  SIMD_SSE2,
+  SIMD_AVX2,
+  SIMD_AVX512
+};
+
+/**
+ * @brief simdLevel detects the best instruction set supported by the cpu
+ * @details Detection runs once. On non x86 builds it is always SIMD_SCALAR
+ */
+SimdLevel simdLevel();
+
+/**
+ * @brief The FFTKernels struct holds the inner loops of the spectrum analyzer
+ * @details One set of kernels exists for each SimdLevel. They all work on
+ * interleaved complex values (the std::complex layout), so the same arrays
+ * can be handed to any of them. Every kernel comes in a double and a float
+ * version; a float register holds twice as many values.
+ */
+struct FFTKernels{
+  /**
+   * @brief level is the instruction set used by these kernels
+   */
+  SimdLevel level;
+
+  /**
+   * @brief name is a printable name for the instruction set
+   */
+  const char *name;
+
+  /**
+   * @brief radix4 runs one radix-4 pass of the in place FFT
+   * @param x points to the n complex values being transformed
+   * @param n is the transform size
+   * @param m is the size of the transforms being merged. Blocks of 4m
+   * values are combined
+   * @param w holds the 3m twiddles of this pass: w^k, w^2k and w^3k
+   * for k in [0,m), one after the other, with w = exp(-2*PI*i/(4m))
+   */
+  void (*radix4)(Complex *x, size_t n, size_t m, const Complex *w);
+
+  /**
+   * @brief magnitudes calcs clamp(scale*|x[i]|, 0, 1) for n values
+   * @param x points to the complex values
+   * @param out receives the n scaled magnitudes
+   * @param n is the number of values
+   * @param scale multiplies every magnitude before clamping
+   */
+  void (*magnitudes)(const Complex *x, double *out, size_t n, double scale);
+
+  /**
+   * @brief radix4f is the single precision version of radix4
+   */
+  void (*radix4f)(std::complex<float> *x, size_t n, size_t m, const std::complex<float> *w);
+
+  /**
+   * @brief magnitudesf is the single precision version of magnitudes
+   */
+  void (*magnitudesf)(const std::complex<float> *x, float *out, size_t n, float scale);
+
+  /**
+   * @brief dot calcs the dot product of two arrays
+   * @param a and b point to the n values to be multiplied
+   */
+  double (*dot)(const double *a, const double *b, size_t n);
+
+  /**
+   * @brief dotf is the single precision version of dot
+   */
+  float (*dotf)(const float *a, const float *b, size_t n);
+
+  /**
+   * @brief logScale calcs clamp(offset + slope*log2(in[i]), 0, 1) for n values
+   * @details The logarithm is approximated in single precision, with an
+   * absolute error below 1.2e-4 (0.0007 dB). Zero goes to 0. The input
+   * must not be negative
+   * @param in and out may be the same array
+   */
+  void (*logScale)(const double *in, double *out, size_t n, double slope, double offset);
+
+  /**
+   * @brief logScalef is the single precision version of logScale
+   */
+  void (*logScalef)(const float *in, float *out, size_t n, float slope, float offset);
+};
+
+/**
+ * @brief magnitudes runs the magnitudes kernel that matches the data type
+ * @param kernels is the kernel set to be used
+ */
+inline void magnitudes(const FFTKernels &kernels, const std::complex<double> *x,
+                       double *out, size_t n, double scale){
+  kernels.magnitudes(x, out, n, scale);
+}
+
+/**
+ * @brief magnitudes runs the magnitudes kernel that matches the data type
+ * @param kernels is the kernel set to be used
+ */
+inline void magnitudes(const FFTKernels &kernels, const std::complex<float> *x,
+                       float *out, size_t n, float scale){
+  kernels.magnitudesf(x, out, n, scale);
+}
+
+/**
+ * @brief dot runs the dot product kernel that matches the data type
+ * @param kernels is the kernel set to be used
+ */
+inline double dot(const FFTKernels &kernels, const double *a, const double *b, size_t n){
+  return kernels.dot(a, b, n);
+}
+
+/**
+ * @brief dot runs the dot product kernel that matches the data type
+ * @param kernels is the kernel set to be used
+ */
+inline float dot(const FFTKernels &kernels, const float *a, const float *b, size_t n){
+  return kernels.dotf(a, b, n);
+}
+
+/**
+ * @brief logScale runs the log scale kernel that matches the data type
+ * @param kernels is the kernel set to be used
+ */
+inline void logScale(const FFTKernels &kernels, const double *in, double *out,
+                     size_t n, double slope, double offset){
+  kernels.logScale(in, out, n, slope, offset);
+}
+
+/**
+ * @brief logScale runs the log scale kernel that matches the data type
+ * @param kernels is the kernel set to be used
+ */
+inline void logScale(const FFTKernels &kernels, const float *in, float *out,
+                     size_t n, float slope, float offset){
+  kernels.logScalef(in, out, n, slope, offset);
+}
+
+/**
+ * @brief fftKernels returns the kernels for the detected instruction set
+ * @details The choice is made the first time the function is called and
+ * is kept for the rest of the program
+ */
+const FFTKernels &fftKernels();
+
+/**
+ * @brief fftKernels returns the kernels for a given instruction set
+ * @details Asking for a level the cpu does not support returns the
+ * best supported one instead
+ * @param level is the wanted instruction set
+ */
+const FFTKernels &fftKernels(SimdLevel level);
+
+#endif // SIMDKERNELS_H
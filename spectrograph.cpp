@@ -7,16 +7,32 @@
 #include <QDebug>
 #include <QResizeEvent>
 #include <QTimerEvent>
+#include <QShowEvent>
+#include <QHideEvent>
 #include <QMessageBox>
 #include <QAction>
 #include <QMenu>
 
+// the widget is repainted at most once every 16ms (60 frames per second)
+#define FRAME_INTERVAL 16
+
+// bars fall with this acceleration, in pixels per second squared
+#define GRAVITY 4444.0f
+
+// level bars fall at this speed, in pixels per second
+#define LEVEL_DECAY 66.7f
+
+// peak marks stand still for this many seconds
+#define PEAK_HOLD 1.5f
+
 Spectrograph::Spectrograph(QWidget *parent) :
   AbstractSpectrograph(parent){
-  // start a timer to update the widget each 15ms
-  startTimer(15);
+  // the frame timer starts when the widget is shown
+  timerId = 0;
+  frameClock.start();
 
-  // we have set up the maximum number of bands
+  // the number of bands follows the analyzer. this
+  // is only the count shown before the first spectrum
   NUM_BANDS = 256;
 
   // resize spectrum to this size
@@ -25,22 +41,39 @@ Spectrograph::Spectrograph(QWidget *parent) :
   // as well as delay array
   delay.resize(NUM_BANDS);
 
-  // start up all arrays with 1
+  // start up all arrays. bars stand still
   for(int i=0; i<NUM_BANDS; i++){
       spectrum[i]=1;
-      delay[i]=1;
+      delay[i]=0;
   }
+  lower = spectrum;
+  lowerDelay = delay;
 
   // initial values for left and right levels
   leftLevel = rightLevel = 1;
+  leftPeak = rightPeak = 0;
+  leftHold = rightHold = 0;
 
   gradientBrush.setStyle(Qt::SolidPattern);
   backgroundBrush.setColor(Qt::black);
   backgroundBrush.setStyle(Qt::SolidPattern);
 
+  // solid black line with 1 pixel width
+  pen.setStyle(Qt::SolidLine);
+  pen.setColor(Qt::black);
+  pen.setWidth(1);
+
   barSpacing = 1;
   acao = new QAction("Acao",this);
   connect(acao,SIGNAL(triggered()),this,SLOT(doAction()));
+
+  // bars are drawn in a single batch by default
+  batched = true;
+  bars.resize(NUM_BANDS);
+  batchedAction = new QAction("Fast rendering",this);
+  batchedAction->setCheckable(true);
+  batchedAction->setChecked(batched);
+  connect(batchedAction,SIGNAL(toggled(bool)),this,SLOT(setBatchedRendering(bool)));
 }
 
 void Spectrograph::resizeEvent(QResizeEvent *e){
@@ -50,25 +83,87 @@ void Spectrograph::resizeEvent(QResizeEvent *e){
   gradient.setColorAt(1, Qt::blue);
   gradient.setColorAt(0, Qt::red);
   gradientBrush = QBrush(gradient);
+
+  // the gradient is rendered once per size. the batched
+  // bars are filled with a plain copy of its pixels
+  if(!size().isEmpty()){
+    gradientPixmap = QPixmap(size());
+    QPainter painter(&gradientPixmap);
+    painter.fillRect(gradientPixmap.rect(), gradientBrush);
+  }
+
   barWidth = (float)width()/NUM_BANDS;
   widgetHeight = height();
-  repaint();
+  update();
+}
+
+void Spectrograph::setBatchedRendering(bool _batched){
+  batched = _batched;
+  update();
+}
+
+void Spectrograph::showEvent(QShowEvent *e){
+  Q_UNUSED(e);
+  startAnimation();
+}
+
+void Spectrograph::hideEvent(QHideEvent *e){
+  Q_UNUSED(e);
+  // nothing is seen, so nothing is animated
+  stopAnimation();
+}
+
+void Spectrograph::startAnimation(){
+  if(timerId == 0 && isVisible()){
+    // the first frame does not count the time spent idle
+    frameClock.restart();
+    timerId = startTimer(FRAME_INTERVAL);
+  }
+}
+
+void Spectrograph::stopAnimation(){
+  if(timerId != 0){
+    killTimer(timerId);
+    timerId = 0;
+  }
+}
+
+void Spectrograph::spectrumReady(){
+  startAnimation();
 }
 
 void Spectrograph::contextMenuEvent(QContextMenuEvent *e)
 {
   QMenu menu;
   menu.addAction(acao);
+  menu.addAction(batchedAction);
   menu.exec(e->globalPos());
 }
 
 void Spectrograph::loadLevels(double left, double right){
-  // 5 and 2 are two beautiful magic numbers
-  // I dont remember why I choose them :]
-  if(leftLevel < 5*width()/2*left)
-    leftLevel = 5*width()/2*left;
-  if(rightLevel < 5*width()/2*right)
-    rightLevel = 5*width()/2*right;
+  // each bar spans half the widget, from the middle
+  if(leftLevel < width()/2*left)
+    leftLevel = width()/2*left;
+  if(rightLevel < width()/2*right)
+    rightLevel = width()/2*right;
+
+  // levels arrive while the audio plays
+  if(leftLevel > 0 || rightLevel > 0)
+    startAnimation();
+}
+
+void Spectrograph::loadPeaks(double left, double right){
+  // a higher peak moves the mark up and holds it again
+  if(leftPeak <= width()/2*left && left > 0){
+    leftPeak = width()/2*left;
+    leftHold = PEAK_HOLD;
+  }
+  if(rightPeak <= width()/2*right && right > 0){
+    rightPeak = width()/2*right;
+    rightHold = PEAK_HOLD;
+  }
+  if(leftPeak > 0 || rightPeak > 0)
+    startAnimation();
 }
 
 void Spectrograph::doAction(){
@@ -86,6 +181,44 @@ void Spectrograph::paintEvent(QPaintEvent *e){
   // resources to draw, such as pens, brushes and geometric figures
   // that can be activated by calling appropriate methods
 
+  // the background and the spectrum bars
+  if(batched)
+    paintBatched(p);
+  else
+    paintClassic(p);
+
+  // now, lets draw left and right mean audio values.
+  // the rounded ends look better with antialiasing
+  p.setRenderHint(QPainter::Antialiasing);
+  p.setPen(pen);
+
+  // brush is black
+  p.setBrush(Qt::black);
+
+  // draw a black rectangle spanning the whole widget width
+  // it is 7 pixels height
+  // we just called the drawRect(x,y,width,height) overloaded function
+  p.drawRect(0,height()-7,width(),7);
+
+  // lets draw the bars
+  // left bar is red
+  p.setBrush(Qt::red);
+  p.drawRoundedRect(QRectF(width()/2-leftLevel,height()-6,leftLevel,6),3,3);
+
+  // right bar is blue
+  p.setBrush(Qt::blue);
+  p.drawRoundedRect(QRectF(width()/2,height()-6,rightLevel,6),3,3);
+
+  // the peak marks are thin white lines
+  p.setPen(Qt::NoPen);
+  p.setBrush(Qt::white);
+  if(leftPeak > 0)
+    p.drawRect(QRectF(width()/2-leftPeak-1,height()-6,2,6));
+  if(rightPeak > 0)
+    p.drawRect(QRectF(width()/2+rightPeak-1,height()-6,2,6));
+}
+
+void Spectrograph::paintClassic(QPainter &p){
   // stores coordinates of the rectangles of the spectrum
   float p1x, p2x, p1y, p2y;
 
@@ -101,13 +234,8 @@ void Spectrograph::paintEvent(QPaintEvent *e){
   // the full region of the widget
   p.drawRect(rect());
 
-  // prepares the pen that will draw the bars
-  // solid black line with 1 pixel width
-  pen.setStyle(Qt::SolidLine);
-  pen.setColor(Qt::black);
-  pen.setWidth(1);
-
   // gives the pen to the painter
+  // solid black line with 1 pixel width
   p.setPen(pen);
 
   // stores midline vertical coordinate to draw the mirrowed spectrum
@@ -130,77 +258,164 @@ void Spectrograph::paintEvent(QPaintEvent *e){
     p.drawRect(QRectF(QPointF(p1x,p1y),QPointF(p2x,p2y)));
 
     // calcs heights for down spectrum bars
-    p1y = p2y + spectrum[i]/2;
+    p1y = p2y + lower[i]/2;
     // draw the down bar
     p.drawRect(QRectF(QPointF(p1x,p1y),QPointF(p2x,p2y)));
   }
-  // now, lets draw left and right mean audio values
-  // brush is black
-  p.setBrush(Qt::black);
+}
 
-  // draw a black rectangle spanning the whole widget width
-  // it is 7 pixels height
-  // we just called the drawRect(x,y,width,height) overloaded function
-  p.drawRect(0,height()-7,width(),7);
+void Spectrograph::paintBatched(QPainter &p){
+  float mid, gap;
 
-  // lets draw the bars
-  // left bar is red
-  p.setBrush(Qt::red);
-  p.drawRoundedRect(width()/2-leftLevel,height()-6,leftLevel,6,3,3);
+  // every shape here is an axis aligned rectangle.
+  // antialiasing would only blur their edges
+  p.setRenderHint(QPainter::Antialiasing, false);
+  p.fillRect(rect(), Qt::black);
 
-  // right bar is blue
-  p.setBrush(Qt::blue);
-  p.drawRoundedRect(width()/2,height()-6,rightLevel,6,3,3);
+  // a gap stands for the black outline of the classic bars,
+  // as long as the bars are wide enough to show it
+  gap = barWidth > 2*barSpacing ? barSpacing : 0;
+
+  // the up and down bars of a band meet at the middle
+  // line, so each band is a single rectangle
+  mid = widgetHeight/2;
+  for(int i=0; i<NUM_BANDS; i++){
+    bars[i].setCoords(i*barWidth, mid - spectrum[i]/2,
+                      (i+1)*barWidth - gap, mid + lower[i]/2);
+  }
+
+  // one call fills all the bars, copying from the
+  // pre-rendered gradient
+  p.setPen(Qt::NoPen);
+  p.setBrush(QBrush(gradientPixmap));
+  p.drawRects(bars.constData(), NUM_BANDS);
 }
 
 void Spectrograph::timerEvent(QTimerEvent *e){
+  float dt;
+  bool idle;
   Q_UNUSED(e); // who cares about this event,
   // since we just have one timer running
 
+  // seconds since the last frame. a long stall
+  // does not make the bars jump
+  dt = qMin(frameClock.nsecsElapsed(), qint64(100000000))*1e-9f;
+  frameClock.restart();
+
   // the following stuff simulates bar decay with gravity
+  idle = fallBars(spectrum, delay, dt);
+  idle = fallBars(lower, lowerDelay, dt) && idle;
+  // decay left and right mean audio values and just
+  // be careful about negative values
+  leftLevel = qMax(0.0f, leftLevel - LEVEL_DECAY*dt);
+  rightLevel = qMax(0.0f, rightLevel - LEVEL_DECAY*dt);
+  if(leftLevel > 0 || rightLevel > 0)
+    idle = false;
+
+  // peak marks are held, then they fall too
+  leftHold -= dt;
+  if(leftHold <= 0)
+    leftPeak = qMax(0.0f, leftPeak - LEVEL_DECAY*dt);
+  rightHold -= dt;
+  if(rightHold <= 0)
+    rightPeak = qMax(0.0f, rightPeak - LEVEL_DECAY*dt);
+  if(leftPeak > 0 || rightPeak > 0)
+    idle = false;
+
+  // pick up the newest spectrum from the analyzer
+  if(pollSpectrum())
+    idle = false;
+
+  // schedule a paint. several requests are merged into one
+  update();
+
+  // everything has fallen and no audio arrives (paused or
+  // stopped): the timer stops until there is something new
+  if(idle && sleepSpectrum())
+    stopAnimation();
+}
+
+bool Spectrograph::fallBars(QVector<float> &bars, QVector<float> &speed, float dt){
+  bool down;
+
+  down = true;
   for(int i=0; i<NUM_BANDS; i++){
-    // spectrum decays according to its delay
-    spectrum[i]-=delay[i];
+    if(bars[i] <= 0)
+      continue;
+    // spectrum decays according to its falling speed
+    bars[i] -= speed[i]*dt + 0.5f*GRAVITY*dt*dt;
+    // increases the speed. next frame
+    // the bar will decay faster
+    speed[i] += GRAVITY*dt;
     // get rid of negative spectrum values
-    if(spectrum[i] < 0 ){
-      spectrum[i]=0;
-    }
-    // increases the delay. next timer event
-    // it will be larger and the bar will decay faster
-    delay[i]++;
+    if(bars[i] < 0)
+      bars[i] = 0;
+    else
+      down = false;
   }
-  // decay left and right mean audio values and just
-  // be careful about negative values
-  if(leftLevel > 0)
-    leftLevel--;
-  if(rightLevel > 0)
-    rightLevel--;
+  return down;
+}
 
-  // repaint the whole thing!!
-  repaint();
+void Spectrograph::setBandCount(int count){
+  // the bars start over from the bottom
+  NUM_BANDS = count;
+  spectrum.fill(0, NUM_BANDS);
+  delay.fill(0, NUM_BANDS);
+  lower.fill(0, NUM_BANDS);
+  lowerDelay.fill(0, NUM_BANDS);
+  bars.resize(NUM_BANDS);
+  barWidth = (float)width()/NUM_BANDS;
 }
 
-void Spectrograph::loadSamples(QVector<double> &_spectrum){
-  int increment, value;
-  // lets subsample the spectrum according to the number of bands
-  // selected by user
-  increment = _spectrum.size()/NUM_BANDS;
+void Spectrograph::raiseBars(QVector<float> &bars, QVector<float> &speed,
+                            const SpectrumReal *values){
+  int value;
 
   // processing audio bars...
   for(int i=0; i<NUM_BANDS;i++){
     // calculates values according to the widget height
-    value = ceil(_spectrum[i*increment]*height());
+    value = ceil(values[i]*height());
     // we just copy the values to its corresponding position on
     // spectrum if it exceeds the current value that is stored
     // this approach ensure smoothness to decay bars
-    if(value > spectrum[i]){
-      spectrum[i] = value;
+    if(value > bars[i]){
+      bars[i] = value;
 
       // if the spectrum is updated, we have to restart gravity
-      delay[i] = 0;
+      speed[i] = 0;
     }
   }
+}
+
+void Spectrograph::loadSamples(QVector<SpectrumReal> &_spectrum){
+  if(_spectrum.isEmpty())
+    return;
 
-  // repaint the whole thing!!
-  repaint();
+  // the analyzer already folded the spectrum into bands.
+  // there is one bar for each of them
+  if(_spectrum.size() != NUM_BANDS)
+    setBandCount(_spectrum.size());
+
+  // a single spectrum is mirrored below the middle line
+  raiseBars(spectrum, delay, _spectrum.constData());
+  raiseBars(lower, lowerDelay, _spectrum.constData());
+  // the frame timer paints the whole thing
+}
+
+void Spectrograph::loadChannels(QVector<SpectrumReal> &spectra, int channels){
+  int bands;
+
+  if(channels != 2){
+    AbstractSpectrograph::loadChannels(spectra, channels);
+    return;
+  }
+  bands = spectra.size()/2;
+  if(bands == 0)
+    return;
+  if(bands != NUM_BANDS)
+    setBandCount(bands);
+
+  // the first channel goes up and the second one down
+  raiseBars(spectrum, delay, spectra.constData());
+  raiseBars(lower, lowerDelay, spectra.constData() + bands);
 }
@@ -13,6 +13,8 @@
 #include <QTimer>
 #include <QGradient>
 #include <QAction>
+#include <QElapsedTimer>
+#include <QPixmap>
 
 // spectrograph class is used to display fourier spectrum
 // bars
@@ -44,19 +46,48 @@ public slots:
   /**
    * @brief This method decides what to do when a new spectrum sample
    * has arrived.
-   * @detailed This method is called periodically by mainwindow every time a
-   * new spectrum is calculated. the _spectrum array reference stores double values
-   * within the range [0,1] and it has 256 elements.
+   * @detailed This method is called by the widget timer every time the
+   * spectrum source has a new spectrum. the _spectrum array reference stores SpectrumReal values
+   * within the range [0,1], one per band, as many as the band count
+   * setting (spectrograph/bands) asks for.
    * @param _spectrum stores the spectrum.
    */
-  void loadSamples(QVector<double> &_spectrum);
+  void loadSamples(QVector<SpectrumReal> &_spectrum);
 
   /**
-   * @brief Used to modify spectrum while a new sample does not arrive
+   * @brief Loads the spectra of several channels
+   * @details With two channels (left and right, or mid and side) the
+   * upper bars show the first one and the lower bars the second one.
+   * More channels are merged, like AbstractSpectrograph does
+   * @param spectra holds the spectra, one after the other
+   * @param channels is the number of spectra
+   */
+  void loadChannels(QVector<SpectrumReal> &spectra, int channels);
+
+  /**
+   * @brief Animates the bars and picks up new spectra, once per frame
+   * @details The decay follows the real elapsed time, so it looks the
+   * same at any frame rate. When every bar has fallen and no spectrum
+   * arrives, the timer is stopped until spectrumReady() or loadLevels()
    * @param e
    */
   void timerEvent(QTimerEvent *e);
 
+  /**
+   * @brief Restarts the animation when a spectrum arrives while idle
+   */
+  void spectrumReady();
+
+  /**
+   * @brief Starts the animation when the widget is shown
+   */
+  void showEvent(QShowEvent *e);
+
+  /**
+   * @brief Stops the animation while the widget is hidden
+   */
+  void hideEvent(QHideEvent *e);
+
   /**
    * @brief What to do when widget size changes
    * @details It is used to recalculate the width of the bars and
@@ -87,30 +118,108 @@ public slots:
    */
   void loadLevels(double left, double right);
 
+  /**
+   * @brief Loads the left and right true peaks
+   * @details A mark stays at the highest peak for a moment and then
+   * falls like the level bars
+   */
+  void loadPeaks(double left, double right);
+
   /**
    * @brief Do some example action when user activates context menu
    * @details You can add new of such functions to allow new context
    * menu entries
    */
   void doAction();
+
+  /**
+   * @brief Chooses how the bars are drawn
+   * @details The batched mode draws every bar with a single drawRects()
+   * call, filled from a cached gradient pixmap and without antialiasing.
+   * The classic mode draws two antialiased, outlined rectangles per band.
+   * Batched is the default
+   * @param batched selects the batched mode
+   */
+  void setBatchedRendering(bool batched);
 private:
+  /**
+   * @brief paintClassic draws the bars one by one, with antialiasing
+   */
+  void paintClassic(QPainter &p);
+
+  /**
+   * @brief paintBatched draws all the bars with one call
+   */
+  void paintBatched(QPainter &p);
+
+  /**
+   * @brief startAnimation starts the frame timer, if it is not running
+   */
+  void startAnimation();
+
+  /**
+   * @brief stopAnimation stops the frame timer
+   */
+  void stopAnimation();
+
+  /**
+   * @brief setBandCount resizes the bars to a new number of bands
+   */
+  void setBandCount(int count);
+
+  /**
+   * @brief raiseBars lifts the bars below a new spectrum up to it
+   * @param bars holds the bar heights
+   * @param speed holds the falling speeds of the bars
+   * @param values points to NUM_BANDS values within [0,1]
+   */
+  void raiseBars(QVector<float> &bars, QVector<float> &speed, const SpectrumReal *values);
+
+  /**
+   * @brief fallBars makes the bars fall for dt seconds
+   * @return true when every bar is down
+   */
+  bool fallBars(QVector<float> &bars, QVector<float> &speed, float dt);
+
   /**
    * @brief Stores the fft spectrum.
-   * @details spectrum is an array that should have a MAXIMUM of 256 entries.
-   * You should not trespass this limit
+   * @details spectrum has one entry for each band
+   */
+  QVector<float> spectrum;
+  /**
+   * @brief Stores the falling speed of the bars (pixels per second)
+   * to simulate gravity
    */
-  QVector<int> spectrum;
+  QVector<float> delay;
+
   /**
-   * @brief Stores the delay for decay bars to simulate gravity
+   * @brief The mirrored bars below the middle line, and their speeds. They
+   * follow the upper ones unless two channels are shown
    */
-  QVector<int> delay;
+  QVector<float> lower, lowerDelay;
 
   /**
    * @brief Left and right level bar size
    */
-  int leftLevel, rightLevel;
+  float leftLevel, rightLevel;
+
+  /**
+   * @brief Left and right peak marks, and the seconds they
+   * are held before falling
+   */
+  float leftPeak, rightPeak, leftHold, rightHold;
+
   /**
-   * @brief Number of spectrum bands (MAX=256!!!)
+   * @brief Id of the frame timer, 0 while the animation is stopped
+   */
+  int timerId;
+
+  /**
+   * @brief Measures the time between frames
+   */
+  QElapsedTimer frameClock;
+  /**
+   * @brief Number of spectrum bands. It follows the size of the spectra
    */
   int NUM_BANDS;
   /**
@@ -130,6 +239,27 @@ private:
    */
   float barSpacing, barWidth, widgetHeight;
   QAction *acao;
+
+  /**
+   * @brief True when the bars are drawn in a single batch
+   */
+  bool batched;
+
+  /**
+   * @brief Context menu entry that switches the rendering mode
+   */
+  QAction *batchedAction;
+
+  /**
+   * @brief The bar gradient, pre-rendered at the widget size. It is
+   * used as a texture, so filling a bar is just a copy of pixels
+   */
+  QPixmap gradientPixmap;
+
+  /**
+   * @brief One rectangle for each band, reused by every paint
+   */
+  QVector<QRectF> bars;
 };
 
 #endif // SPECTROGRAM_H
@@ -0,0 +1,53 @@
+#include "spectrumframestore.h"
+
+SpectrumFrameStore::SpectrumFrameStore(){
+  // each side starts with its own buffer. the one in
+  // the middle holds no frame yet
+  backIndex = 0;
+  middle.storeRelease(1);
+  frontIndex = 2;
+  for(int i=0; i<3; i++)
+    channelCounts[i] = 1;
+
+  // the reader starts awake
+  idle.storeRelease(0);
+}
+
+SpectrumReal *SpectrumFrameStore::beginWrite(int size, int channels){
+  // the back buffer belongs to the writer. it only
+  // reallocates when the frame size changes
+  if(buffers[backIndex].size() != size)
+    buffers[backIndex].resize(size);
+  channelCounts[backIndex] = qMax(1, channels);
+  return buffers[backIndex].data();
+}
+
+bool SpectrumFrameStore::publish(){
+  // the filled buffer goes to the middle and the writer
+  // gets back whatever was there
+  backIndex = middle.fetchAndStoreOrdered(backIndex | FRESH) & 3;
+
+  // the reader only needs to be told when it sleeps
+  return idle.testAndSetOrdered(1, 0);
+}
+
+bool SpectrumFrameStore::acquire(){
+  // nothing new since the last frame was taken
+  if(!(middle.loadAcquire() & FRESH))
+    return false;
+
+  // the reader gives its old frame to the middle and
+  // takes the newest one
+  frontIndex = middle.fetchAndStoreOrdered(frontIndex) & 3;
+  return true;
+}
+
+bool SpectrumFrameStore::sleep(){
+  // same protocol as the pcm ring: the flag is raised with a full
+  // barrier, then the middle buffer is looked at once more, in
+  // case a frame was published before the writer could see the flag
+  idle.fetchAndStoreOrdered(1);
+  if((middle.loadAcquire() & FRESH) && idle.testAndSetOrdered(1, 0))
+    return false;
+  return true;
+}
@@ -0,0 +1,104 @@
+#ifndef SPECTRUMFRAMESTORE_H
+#define SPECTRUMFRAMESTORE_H
+
+#include <QAtomicInt>
+#include <QVector>
+#include "fft.h"
+
+/**
+ * @brief The SpectrumFrameStore class hands spectrum frames from the
+ * analyzer thread to the widget thread without copies or locks
+ * @details It is a triple buffer. The writer fills its back buffer and
+ * publishes it by atomically swapping it with the middle buffer. The reader
+ * swaps the middle buffer with its front buffer whenever a new frame was
+ * published, and keeps using the front buffer until it asks again.
+ *
+ * Both sides always own one buffer each, so neither waits for the other.
+ * When the writer is faster than the reader, intermediate frames are
+ * simply replaced by newer ones. Buffers only allocate memory when the
+ * frame size changes.
+ *
+ * Exactly one thread may write and exactly one thread may read.
+ */
+class SpectrumFrameStore{
+public:
+  /**
+   * @brief Creates a store with three empty buffers
+   */
+  SpectrumFrameStore();
+
+  /**
+   * @brief beginWrite returns the back buffer to be filled (writer side)
+   * @param size is the number of values of the new frame
+   * @param channels is the number of spectra in the frame, one after the
+   * other, each size/channels values long
+   * @return a pointer to size values. It stays valid until publish()
+   */
+  SpectrumReal *beginWrite(int size, int channels = 1);
+
+  /**
+   * @brief publish makes the back buffer the newest frame (writer side)
+   * @return true when the reader went to sleep and must be woken up.
+   * Only one call returns true for each sleep() of the reader
+   */
+  bool publish();
+
+  /**
+   * @brief acquire takes the newest published frame, if any (reader side)
+   * @return true when front() changed since the last call
+   */
+  bool acquire();
+
+  /**
+   * @brief front returns the frame taken by the last acquire() (reader side)
+   */
+  QVector<SpectrumReal> &front() { return buffers[frontIndex]; }
+
+  /**
+   * @brief frontChannels returns the number of spectra in front() (reader side)
+   */
+  int frontChannels() const { return channelCounts[frontIndex]; }
+
+  /**
+   * @brief sleep marks the reader as idle (reader side)
+   * @details The reader stops polling and waits to be woken up by
+   * whoever got true from publish()
+   * @return false when a frame was published in the meantime. In that
+   * case the reader is still awake and must acquire it
+   */
+  bool sleep();
+
+private:
+  /**
+   * @brief FRESH is set in middle while it holds a frame the reader did not take
+   */
+  enum { FRESH = 4 };
+
+  /**
+   * @brief buffers are the three frames
+   */
+  QVector<SpectrumReal> buffers[3];
+
+  /**
+   * @brief channelCounts holds the number of spectra of each buffer. It
+   * travels with its buffer, so no extra synchronization is needed
+   */
+  int channelCounts[3];
+
+  /**
+   * @brief backIndex is owned by the writer and frontIndex by the reader
+   */
+  int backIndex, frontIndex;
+
+  /**
+   * @brief middle holds the index of the shared buffer and the FRESH flag
+   */
+  QAtomicInt middle;
+
+  /**
+   * @brief idle is 1 while the reader sleeps
+   */
+  QAtomicInt idle;
+};
+
+#endif // SPECTRUMFRAMESTORE_H
@@ -0,0 +1,33 @@
+#include "stringpool.h"
+
+StringPool::StringPool(){
+  clear();
+}
+
+quint32 StringPool::intern(const QString &string){
+  QHash<QString, quint32>::const_iterator it;
+
+  if(string.isEmpty())
+    return 0;
+  it = ids.constFind(string);
+  if(it != ids.constEnd())
+    return *it;
+  strings.append(string);
+  ids.insert(string, strings.size() - 1);
+  return strings.size() - 1;
+}
+
+int StringPool::find(const QString &string) const{
+  QHash<QString, quint32>::const_iterator it;
+
+  if(string.isEmpty())
+    return 0;
+  it = ids.constFind(string);
+  return it != ids.constEnd() ? int(*it) : -1;
+}
+
+void StringPool::clear(){
+  strings.clear();
+  ids.clear();
+  strings.append(QString());
+}
@@ -0,0 +1,55 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief The StringPool class keeps one copy of each string and hands out
+ * small ids for them
+ * @details Tables with many rows and few distinct values, as artists and
+ * albums are, store the ids instead of the strings. An id is an index, so
+ * going back to the string costs nothing. Id 0 is the empty string.
+ *
+ * Strings are never taken out. clear() starts over.
+ */
+class StringPool{
+public:
+  /**
+   * @brief Creates a pool that holds the empty string only
+   */
+  StringPool();
+
+  /**
+   * @brief intern returns the id of a string, adding it when it is new
+   */
+  quint32 intern(const QString &string);
+
+  /**
+   * @brief find returns the id of a string without adding it
+   * @return -1 when the string is not in the pool
+   */
+  int find(const QString &string) const;
+
+  /**
+   * @brief string returns the string of an id
+   */
+  const QString &string(quint32 id) const { return strings[id]; }
+
+  /**
+   * @brief size returns the number of strings, the empty one included
+   */
+  int size() const { return strings.size(); }
+
+  /**
+   * @brief clear forgets every string but the empty one
+   */
+  void clear();
+
+private:
+  QVector<QString> strings;
+  QHash<QString, quint32> ids;
+};
+
+#endif // STRINGPOOL_H
@@ -0,0 +1,558 @@
+#include "tagparser.h"
+#include <QByteArray>
+#include <QFile>
+#include <QtEndian>
+
+// no tag, block or frame is read past this size. the
+// fields looked for are always much shorter
+#define MAX_TAG_BYTES (1 << 20)
+
+// mpeg frames are looked for this far after the id3 tag,
+// which is often followed by padding
+#define MPEG_SYNC_SEARCH 4096
+
+// the last ogg page is looked for this far from the end
+#define OGG_TAIL_BYTES 65536
+
+// bit rates of mpeg audio in kbit/s: mpeg 1 layers I, II and III,
+// then mpeg 2 and 2.5 layer I, and layers II and III
+static const int MPEG_BITRATES[5][15] = {
+  {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+  {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+  {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+  {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+  {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}
+};
+
+static const int MPEG_RATES[3] = {44100, 48000, 32000};
+
+// reads a file at known offsets, a few bytes at a time. a tag that
+// must be decoded as a whole may be held in memory instead
+class TagSource{
+public:
+  explicit TagSource(const QString &path) : file(path), heldStart(0){}
+  bool open(){ return file.open(QIODevice::ReadOnly | QIODevice::Unbuffered); }
+  qint64 size() const { return file.size(); }
+  void hold(qint64 start, const QByteArray &data){ heldStart = start; held = data; }
+  void release(){ held.clear(); }
+  QByteArray read(qint64 position, qint64 length);
+
+private:
+  QFile file;
+  QByteArray held;
+  qint64 heldStart;
+};
+
+QByteArray TagSource::read(qint64 position, qint64 length){
+  if(position < 0 || length <= 0)
+    return QByteArray();
+  length = qMin(length, qint64(MAX_TAG_BYTES));
+  if(!held.isEmpty()){
+    if(position < heldStart || position - heldStart >= held.size())
+      return QByteArray();
+    return held.mid(int(position - heldStart), int(length));
+  }
+  if(!file.seek(position))
+    return QByteArray();
+  return file.read(length);
+}
+
+static quint32 be32(const char *data){
+  return qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data));
+}
+
+static quint32 le32(const char *data){
+  return qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data));
+}
+
+// id3 sizes keep the high bit of each byte clear
+static quint32 syncsafe(const char *data){
+  return (quint32(uchar(data[0]) & 0x7f) << 21) | (quint32(uchar(data[1]) & 0x7f) << 14) |
+      (quint32(uchar(data[2]) & 0x7f) << 7) | quint32(uchar(data[3]) & 0x7f);
+}
+
+// a string ends at its first terminator. lists of values
+// keep the first one only
+static QString cut(const QString &text){
+  int end = text.indexOf(QChar(0));
+  return (end >= 0 ? text.left(end) : text).trimmed();
+}
+
+static QString fromUtf16(const char *data, int size, bool bigEndian){
+  QString text;
+  text.resize(size/2);
+  for(int i=0; i<size/2; i++){
+    text[i] = bigEndian ? QChar(uchar(data[2*i]) << 8 | uchar(data[2*i+1])) :
+                          QChar(uchar(data[2*i+1]) << 8 | uchar(data[2*i]));
+  }
+  return text;
+}
+
+static bool isUtf8(const QByteArray &bytes){
+  int follow = 0;
+  for(int i=0; i<bytes.size(); i++){
+    uchar c = uchar(bytes[i]);
+    if(follow > 0){
+      if((c & 0xc0) != 0x80)
+        return false;
+      follow--;
+    }
+    else if(c >= 0xf0 && c < 0xf8){
+      follow = 3;
+    }
+    else if(c >= 0xe0){
+      if(c >= 0xf0)
+        return false;
+      follow = 2;
+    }
+    else if(c >= 0xc2){
+      follow = 1;
+    }
+    else if(c >= 0x80){
+      return false;
+    }
+  }
+  return follow == 0;
+}
+
+// tags without a declared encoding are latin 1 by the book,
+// but utf-8 by many taggers
+static QString legacyText(const QByteArray &bytes){
+  return cut(isUtf8(bytes) ? QString::fromUtf8(bytes) : QString::fromLatin1(bytes));
+}
+
+// an id3 text frame starts with its encoding
+static QString id3Text(const QByteArray &frame){
+  const char *text = frame.constData() + 1;
+  int size = frame.size() - 1;
+
+  if(size < 1)
+    return QString();
+  switch(frame[0]){
+  case 1:
+    if(size >= 2 && uchar(text[0]) == 0xfe && uchar(text[1]) == 0xff)
+      return cut(fromUtf16(text + 2, size - 2, true));
+    if(size >= 2 && uchar(text[0]) == 0xff && uchar(text[1]) == 0xfe)
+      return cut(fromUtf16(text + 2, size - 2, false));
+    return cut(fromUtf16(text, size, false));
+  case 2:
+    return cut(fromUtf16(text, size, true));
+  case 3:
+    return cut(QString::fromUtf8(text, size));
+  default:
+    return legacyText(QByteArray(text, size));
+  }
+}
+
+// undoes the unsynchronization of id3: a zero after each 0xff
+static QByteArray resynchronize(const QByteArray &data){
+  QByteArray out;
+  out.reserve(data.size());
+  for(int i=0; i<data.size(); i++){
+    out.append(data[i]);
+    if(uchar(data[i]) == 0xff && i + 1 < data.size() && data[i+1] == 0)
+      i++;
+  }
+  return out;
+}
+
+// reads an id3v2 tag at start and returns its length, or 0
+// when there is none. frames that hold no wanted field, as
+// pictures do, are skipped without being read
+static qint64 readId3v2(TagSource &source, qint64 start, LibraryTrack *track){
+  QByteArray head, data, id;
+  QString text;
+  qint64 size, tagSize, position, end, frameSize;
+  int major, flags, frameFlags, headerSize;
+
+  head = source.read(start, 10);
+  if(head.size() < 10 || !head.startsWith("ID3"))
+    return 0;
+  major = uchar(head[3]);
+  flags = uchar(head[5]);
+  size = syncsafe(head.constData() + 6);
+  tagSize = 10 + size + (flags & 0x10 ? 10 : 0);
+  if(major < 2 || major > 4)
+    return tagSize;
+
+  // before 2.4, unsynchronization applies to the whole tag,
+  // which is then decoded at once
+  position = start + 10;
+  end = position + size;
+  if((flags & 0x80) && major < 4){
+    data = resynchronize(source.read(position, size));
+    source.hold(position, data);
+    end = position + data.size();
+  }
+  if((flags & 0x40) && major >= 3){
+    head = source.read(position, 4);
+    if(head.size() == 4)
+      position += major == 4 ? syncsafe(head.constData()) : be32(head.constData()) + 4;
+  }
+
+  headerSize = major == 2 ? 6 : 10;
+  while(position + headerSize <= end){
+    head = source.read(position, headerSize);
+    if(head.size() < headerSize || head[0] == 0)
+      break;
+    if(major == 2){
+      id = head.left(3);
+      frameSize = (uchar(head[3]) << 16) | (uchar(head[4]) << 8) | uchar(head[5]);
+    }
+    else{
+      id = head.left(4);
+      frameSize = major == 4 ? syncsafe(head.constData() + 4) : be32(head.constData() + 4);
+    }
+    if(frameSize <= 0 || position + headerSize + frameSize > end)
+      break;
+
+    if(id == "TIT2" || id == "TT2" || id == "TPE1" || id == "TP1" ||
+       id == "TALB" || id == "TAL" || id == "TLEN" || id == "TLE"){
+      data = source.read(position + headerSize, frameSize);
+      frameFlags = major >= 3 ? uchar(head[9]) : 0;
+      // compressed and encrypted frames are left alone
+      if((major == 3 && (frameFlags & 0xc0)) || (major == 4 && (frameFlags & 0x0c)))
+        data.clear();
+      if(major == 4 && (frameFlags & 0x01))
+        data = data.mid(4);
+      if(major == 4 && (frameFlags & 0x02))
+        data = resynchronize(data);
+      text = id3Text(data);
+      if(!text.isEmpty()){
+        if(id == "TIT2" || id == "TT2")
+          track->title = text;
+        else if(id == "TPE1" || id == "TP1")
+          track->artist = text;
+        else if(id == "TALB" || id == "TAL")
+          track->album = text;
+        else if(text.toLongLong() > 0)
+          track->duration = text.toLongLong();
+      }
+    }
+    position += headerSize + frameSize;
+  }
+  source.release();
+  return tagSize;
+}
+
+// the 128 bytes at the end of older mp3 files
+static void readId3v1(TagSource &source, LibraryTrack *track){
+  QByteArray tag;
+
+  tag = source.read(source.size() - 128, 128);
+  if(tag.size() < 128 || !tag.startsWith("TAG"))
+    return;
+  if(track->title.isEmpty())
+    track->title = legacyText(tag.mid(3, 30));
+  if(track->artist.isEmpty())
+    track->artist = legacyText(tag.mid(33, 30));
+  if(track->album.isEmpty())
+    track->album = legacyText(tag.mid(63, 30));
+}
+
+// decodes the header of an mpeg audio frame
+static bool mpegHeader(const char *header, int *bitrate, int *rate, int *samples,
+                       int *length, int *sideInfo){
+  const uchar *h = reinterpret_cast<const uchar*>(header);
+  int version, layer, bitrateIndex, rateIndex, padding, mono;
+  bool mpeg1;
+
+  if(h[0] != 0xff || (h[1] & 0xe0) != 0xe0)
+    return false;
+  version = (h[1] >> 3) & 3;
+  layer = 4 - ((h[1] >> 1) & 3);
+  bitrateIndex = h[2] >> 4;
+  rateIndex = (h[2] >> 2) & 3;
+  padding = (h[2] >> 1) & 1;
+  mono = (h[3] >> 6) == 3;
+  if(version == 1 || layer == 4 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3)
+    return false;
+
+  mpeg1 = version == 3;
+  *bitrate = 1000*MPEG_BITRATES[mpeg1 ? layer - 1 : layer == 1 ? 3 : 4][bitrateIndex];
+  *rate = MPEG_RATES[rateIndex] >> (mpeg1 ? 0 : version == 2 ? 1 : 2);
+  *samples = layer == 1 ? 384 : layer == 3 && !mpeg1 ? 576 : 1152;
+  *length = layer == 1 ? (12*(*bitrate)/(*rate) + padding)*4 :
+                         (*samples/8)*(*bitrate)/(*rate) + padding;
+  *sideInfo = layer != 3 ? 0 : mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+  return true;
+}
+
+// the duration of mpeg audio comes from the xing or vbri header of
+// variable bit rate files, or from the bit rate of the first frame
+static void readMpegDuration(TagSource &source, qint64 start, LibraryTrack *track){
+  QByteArray data, next, frame;
+  int bitrate, rate, samples, length, sideInfo, dummy;
+  qint64 frames, audio;
+
+  // without an id3 tag, the first frame must be right at the start
+  data = source.read(start, start > 0 ? MPEG_SYNC_SEARCH + 4 : 4);
+  for(int i=0; i + 4 <= data.size(); i++){
+    if(!mpegHeader(data.constData() + i, &bitrate, &rate, &samples, &length, &sideInfo))
+      continue;
+    // a false sync is not followed by another frame
+    next = source.read(start + i + length, 4);
+    if(next.size() < 4 || !mpegHeader(next.constData(), &dummy, &dummy, &dummy, &dummy, &dummy))
+      continue;
+
+    frames = 0;
+    frame = source.read(start + i, 4 + 32 + 18);
+    if(frame.size() >= 4 + sideInfo + 12 &&
+       (frame.mid(4 + sideInfo, 4) == "Xing" || frame.mid(4 + sideInfo, 4) == "Info") &&
+       (be32(frame.constData() + 4 + sideInfo + 4) & 1))
+      frames = be32(frame.constData() + 4 + sideInfo + 8);
+    else if(frame.size() >= 4 + 32 + 18 && frame.mid(4 + 32, 4) == "VBRI")
+      frames = be32(frame.constData() + 4 + 32 + 14);
+
+    if(frames > 0){
+      track->duration = frames*samples*1000/rate;
+    }
+    else{
+      audio = source.size() - start - i;
+      if(source.read(source.size() - 128, 3) == "TAG")
+        audio -= 128;
+      track->duration = audio*8000/bitrate;
+    }
+    return;
+  }
+}
+
+// vorbis comments are KEY=value pairs in utf-8, after a vendor
+// string. the first value of each key is kept
+static void readVorbisComment(const QByteArray &data, LibraryTrack *track){
+  const char *p = data.constData();
+  qint64 size = data.size(), position;
+  quint32 count, length;
+  bool title = false, artist = false, album = false;
+  QByteArray key;
+  QString value;
+  int equals;
+
+  if(size < 8)
+    return;
+  position = 4 + qint64(le32(p));
+  if(position + 4 > size)
+    return;
+  count = le32(p + position);
+  position += 4;
+  for(quint32 i=0; i<count && position + 4 <= size; i++){
+    length = le32(p + position);
+    position += 4;
+    if(length > size - position)
+      break;
+    QByteArray field = QByteArray::fromRawData(p + position, length);
+    position += length;
+    equals = field.indexOf('=');
+    if(equals <= 0)
+      continue;
+    key = field.left(equals).toUpper();
+    value = QString::fromUtf8(field.constData() + equals + 1, length - equals - 1).trimmed();
+    if(value.isEmpty())
+      continue;
+    if(key == "TITLE" && !title){
+      track->title = value;
+      title = true;
+    }
+    else if(key == "ARTIST" && !artist){
+      track->artist = value;
+      artist = true;
+    }
+    else if(key == "ALBUM" && !album){
+      track->album = value;
+      album = true;
+    }
+  }
+}
+
+// flac metadata blocks come right after the magic. pictures
+// and seek tables are skipped
+static bool readFlac(TagSource &source, qint64 start, LibraryTrack *track){
+  QByteArray head, info;
+  qint64 position, length, samples;
+  int type, rate;
+
+  if(source.read(start, 4) != "fLaC")
+    return false;
+  position = start + 4;
+  for(int blocks=0; blocks<256; blocks++){
+    head = source.read(position, 4);
+    if(head.size() < 4)
+      break;
+    type = uchar(head[0]) & 0x7f;
+    length = (uchar(head[1]) << 16) | (uchar(head[2]) << 8) | uchar(head[3]);
+    if(type == 0 && length >= 18){
+      info = source.read(position + 4, 18);
+      if(info.size() == 18){
+        rate = (uchar(info[10]) << 12) | (uchar(info[11]) << 4) | (uchar(info[12]) >> 4);
+        samples = (qint64(uchar(info[13]) & 0x0f) << 32) | be32(info.constData() + 14);
+        if(rate > 0 && samples > 0)
+          track->duration = samples*1000/rate;
+      }
+    }
+    else if(type == 4){
+      readVorbisComment(source.read(position + 4, length), track);
+    }
+    if(uchar(head[0]) & 0x80)
+      break;
+    position += 4 + length;
+  }
+  return true;
+}
+
+// the first two packets of an ogg vorbis or opus stream are its
+// identification and comment headers. the duration is the granule
+// position of the last page
+static void readOgg(TagSource &source, LibraryTrack *track){
+  QByteArray head, table, body, packets[2], tail;
+  qint64 position, bodyStart, bodySize, granule, tailStart;
+  quint32 serial = 0, rate = 0;
+  int packet, segments, offset, lace, preskip = 0;
+
+  position = 0;
+  packet = 0;
+  for(int pages=0; packet < 2 && pages < 1024; pages++){
+    head = source.read(position, 27);
+    if(head.size() < 27 || !head.startsWith("OggS"))
+      break;
+    segments = uchar(head[26]);
+    table = source.read(position + 27, segments);
+    if(table.size() < segments)
+      break;
+    bodyStart = position + 27 + segments;
+    bodySize = 0;
+    for(int i=0; i<segments; i++)
+      bodySize += uchar(table[i]);
+    if(pages == 0)
+      serial = le32(head.constData() + 14);
+
+    // packets are split in segments of 255 bytes. a
+    // shorter segment ends a packet
+    if(le32(head.constData() + 14) == serial){
+      body = source.read(bodyStart, bodySize);
+      offset = 0;
+      for(int i=0; i<segments && packet<2; i++){
+        lace = uchar(table[i]);
+        if(packets[packet].size() < MAX_TAG_BYTES)
+          packets[packet].append(body.mid(offset, lace));
+        offset += lace;
+        if(lace < 255)
+          packet++;
+      }
+    }
+    position = bodyStart + bodySize;
+  }
+
+  if(packets[0].startsWith("\x01vorbis") && packets[0].size() >= 16){
+    rate = le32(packets[0].constData() + 12);
+  }
+  else if(packets[0].startsWith("OpusHead") && packets[0].size() >= 12){
+    rate = 48000;
+    preskip = uchar(packets[0][10]) | (uchar(packets[0][11]) << 8);
+  }
+  else{
+    return;
+  }
+  // a truncated comment packet still gives the fields before the cut
+  if(packets[1].startsWith("\x03vorbis"))
+    readVorbisComment(packets[1].mid(7), track);
+  else if(packets[1].startsWith("OpusTags"))
+    readVorbisComment(packets[1].mid(8), track);
+
+  tailStart = qMax(qint64(0), source.size() - OGG_TAIL_BYTES);
+  tail = source.read(tailStart, source.size() - tailStart);
+  for(int i = tail.lastIndexOf("OggS"); i >= 0; i = i > 0 ? tail.lastIndexOf("OggS", i - 1) : -1){
+    if(i + 27 > tail.size() || le32(tail.constData() + i + 14) != serial)
+      continue;
+    granule = qFromLittleEndian<qint64>(reinterpret_cast<const uchar*>(tail.constData() + i + 6));
+    if(granule <= preskip)
+      continue;
+    if(rate > 0)
+      track->duration = (granule - preskip)*1000/rate;
+    break;
+  }
+}
+
+// the INFO list of a wave file holds its tags
+static void readRiffInfo(const QByteArray &list, LibraryTrack *track){
+  QByteArray id;
+  QString text;
+  quint32 length;
+  int offset;
+
+  offset = 4;
+  while(offset + 8 <= list.size()){
+    id = list.mid(offset, 4);
+    length = le32(list.constData() + offset + 4);
+    if(length > quint32(list.size() - offset - 8))
+      break;
+    text = legacyText(list.mid(offset + 8, length));
+    if(!text.isEmpty()){
+      if(id == "INAM")
+        track->title = text;
+      else if(id == "IART")
+        track->artist = text;
+      else if(id == "IPRD")
+        track->album = text;
+    }
+    offset += 8 + length + (length & 1);
+  }
+}
+
+// wave files are a list of chunks. the audio data
+// is skipped, whatever its place
+static void readRiff(TagSource &source, LibraryTrack *track){
+  QByteArray head, format, list;
+  qint64 position, size, length, byteRate, dataSize;
+
+  size = source.size();
+  position = 12;
+  byteRate = dataSize = 0;
+  for(int chunks=0; chunks<256 && position + 8 <= size; chunks++){
+    head = source.read(position, 8);
+    if(head.size() < 8)
+      break;
+    length = le32(head.constData() + 4);
+    if(head.startsWith("fmt ") && length >= 16){
+      format = source.read(position + 8, 16);
+      if(format.size() == 16)
+        byteRate = le32(format.constData() + 8);
+    }
+    else if(head.startsWith("data")){
+      dataSize = qMin(length, size - position - 8);
+    }
+    else if(head.startsWith("LIST")){
+      list = source.read(position + 8, length);
+      if(list.startsWith("INFO"))
+        readRiffInfo(list, track);
+    }
+    position += 8 + length + (length & 1);
+  }
+  if(byteRate > 0 && dataSize > 0)
+    track->duration = dataSize*1000/byteRate;
+}
+
+bool readTags(const QString &path, LibraryTrack *track){
+  TagSource source(path);
+  QByteArray head;
+  qint64 audio;
+
+  if(!source.open())
+    return false;
+  head = source.read(0, 12);
+  if(head.startsWith("OggS")){
+    readOgg(source, track);
+  }
+  else if(head.startsWith("RIFF") && head.mid(8, 4) == "WAVE"){
+    readRiff(source, track);
+  }
+  else{
+    // some flac files start with an id3 tag too
+    audio = readId3v2(source, 0, track);
+    if(!readFlac(source, audio, track)){
+      readId3v1(source, track);
+      if(track->duration <= 0)
+        readMpegDuration(source, audio, track);
+    }
+  }
+  return true;
+}
@@ -0,0 +1,27 @@
+#ifndef TAGPARSER_H
+#define TAGPARSER_H
+
+#include <QString>
+#include "librarytrack.h"
+
+/**
+ * @brief readTags reads the title, artist, album and duration of an audio
+ * file into a library record
+ * @details ID3v2 (2.2 to 2.4) and ID3v1 tags of MPEG audio, FLAC metadata
+ * blocks, Vorbis comments of FLAC, Ogg Vorbis and Opus, and the INFO list
+ * of RIFF WAVE files are understood. Where no tag tells the duration, it
+ * comes from the stream headers: FLAC STREAMINFO, the last Ogg granule,
+ * the WAVE format chunk, or the Xing, VBRI or first frame of MPEG audio.
+ *
+ * Only the headers are read, with small reads at known offsets. Pictures
+ * and other large blocks are skipped, not read.
+ *
+ * It may be called from any thread.
+ * @param path is the file to read
+ * @param track receives what was found. Fields that were not found are
+ * left as they were
+ * @return false when the file could not be opened
+ */
+bool readTags(const QString &path, LibraryTrack *track);
+
+#endif // TAGPARSER_H
@@ -0,0 +1,163 @@
+#include "tagreader.h"
+#include <QElapsedTimer>
+#include <QRunnable>
+#include <QThread>
+#include "tagparser.h"
+
+// a read task takes files from the queues until they are empty
+class TagReadTask : public QRunnable{
+public:
+  explicit TagReadTask(TagReader *_reader) : reader(_reader){}
+  void run();
+
+private:
+  void flush();
+
+  TagReader *reader;
+  LibraryTrackList batch, known;
+};
+
+void TagReadTask::run(){
+  QElapsedTimer timer;
+  LibraryTrack track;
+  QString path;
+  bool indexed;
+
+  timer.start();
+  while(reader->next(&path)){
+    track = LibraryTrack();
+    track.path = path;
+    indexed = reader->library && reader->library->find(path, &track);
+    if(indexed && !track.needsTags())
+      continue;
+    if(!readTags(path, &track))
+      continue;
+    track.tagsRead = true;
+
+    // the index keeps the tags of its files, and that they were
+    // read when there were none. the others are only remembered
+    // for this run
+    if(indexed){
+      known.append(track);
+    }
+    else{
+      QMutexLocker locker(&reader->mutex);
+      reader->attempted.insert(path);
+    }
+    batch.append(track);
+
+    // the first rows on screen should not wait for a full batch
+    if(batch.size() >= TAG_BATCH || timer.elapsed() >= TAG_BATCH_MS){
+      flush();
+      timer.restart();
+    }
+  }
+  flush();
+}
+
+void TagReadTask::flush(){
+  if(!known.isEmpty())
+    reader->library->put(known);
+  if(!batch.isEmpty())
+    QMetaObject::invokeMethod(reader, "takeBatch", Qt::QueuedConnection,
+                              Q_ARG(LibraryTrackList, batch));
+  known.clear();
+  batch.clear();
+}
+
+TagReader::TagReader(QObject *parent) : QObject(parent){
+  qRegisterMetaType<LibraryTrackList>();
+  running = 0;
+  libraryNext = libraryEnd = 0;
+  library = 0;
+
+  // the tasks mostly wait for the disk. a few of them
+  // keep it busy without fighting over it
+  pool.setMaxThreadCount(qBound(2, QThread::idealThreadCount(), 4));
+}
+
+TagReader::~TagReader(){
+  // the tasks use this object until they finish
+  mutex.lock();
+  urgent.clear();
+  background.clear();
+  libraryNext = libraryEnd;
+  mutex.unlock();
+  pool.waitForDone();
+}
+
+void TagReader::setIndex(LibraryIndex *index){
+  library = index;
+}
+
+void TagReader::readNow(QStringList paths){
+  mutex.lock();
+  urgent = paths;
+  mutex.unlock();
+  start();
+}
+
+void TagReader::readLater(QStringList paths){
+  mutex.lock();
+  background.append(paths);
+  mutex.unlock();
+  start();
+}
+
+void TagReader::readLibrary(){
+  if(!library)
+    return;
+  mutex.lock();
+  // the tracks added since the snapshot was written have no record
+  background.append(library->newPaths());
+  libraryNext = 0;
+  libraryEnd = library->snapshotSize();
+  mutex.unlock();
+  start();
+}
+
+void TagReader::start(){
+  QMutexLocker locker(&mutex);
+  while(running < pool.maxThreadCount() &&
+        running < urgent.size() + background.size() + libraryEnd - libraryNext){
+    running++;
+    pool.start(new TagReadTask(this));
+  }
+}
+
+bool TagReader::next(QString *path){
+  LibraryTrack track;
+  int number;
+
+  // files read already in this run are skipped. the
+  // task checks the index for the others
+  for(;;){
+    QMutexLocker locker(&mutex);
+    if(!urgent.isEmpty()){
+      *path = urgent.takeFirst();
+    }
+    else if(!background.isEmpty()){
+      *path = background.takeFirst();
+    }
+    else if(libraryNext < libraryEnd){
+      // the records are read with the mutex let go, so the gui
+      // thread does not wait while tagged ones are skipped
+      number = libraryNext++;
+      locker.unlock();
+      if(!library->record(number, &track) || !track.needsTags())
+        continue;
+      *path = track.path;
+      locker.relock();
+    }
+    else{
+      running--;
+      return false;
+    }
+    if(!attempted.contains(*path))
+      return true;
+  }
+}
+
+void TagReader::takeBatch(LibraryTrackList tracks){
+  emit tagsRead(tracks);
+}
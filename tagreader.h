@@ -0,0 +1,125 @@
+#ifndef TAGREADER_H
+#define TAGREADER_H
+
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include "libraryindex.h"
+
+// read tags are handed over this many at a time, or
+// after this many milliseconds, whatever comes first
+#define TAG_BATCH 64
+#define TAG_BATCH_MS 100
+
+/**
+ * @brief The TagReader class reads the tags of audio files in a thread pool
+ * @details Files wait in two queues. The files of the rows the user is
+ * looking at go to the first one, which is always served first, and
+ * replace whatever was there: rows scrolled away are not read for nothing.
+ * The rest of the library goes to the second one, and is read when there
+ * is nothing more urgent. The tracks the library had when it was opened
+ * come last, walked through record by record by the reading threads, so
+ * nothing lists them all up front.
+ *
+ * Files the library index holds tags for, or knows to have none, are not
+ * read again until they change. What is read goes into the index from the
+ * reading threads, so the gui thread never waits for the disk, and then to
+ * tagsRead() in batches.
+ *
+ * The reader lives in the gui thread. Its signals are emitted there.
+ */
+class TagReader : public QObject{
+  Q_OBJECT
+public:
+  /**
+   * @brief Creates an idle reader. Tags are not kept until setIndex()
+   */
+  explicit TagReader(QObject *parent = 0);
+
+  /**
+   * @brief Forgets the queued files and waits for the files being read
+   */
+  ~TagReader();
+
+  /**
+   * @brief setIndex tells where tags are looked up and kept. It is set
+   * while nothing is being read
+   * @param index must outlive the reader, or the next setIndex()
+   */
+  void setIndex(LibraryIndex *index);
+
+public slots:
+  /**
+   * @brief readNow reads the tags of files that are shown right now,
+   * before any other file
+   * @param paths replaces the files queued by the previous call
+   */
+  void readNow(QStringList paths);
+
+  /**
+   * @brief readLater queues files to be read when nothing else is
+   */
+  void readLater(QStringList paths);
+
+  /**
+   * @brief readLibrary reads the tracks of the library whose tags were
+   * never read, after every file queued by readLater()
+   */
+  void readLibrary();
+
+signals:
+  /**
+   * @brief tagsRead hands over the records of files whose tags were read
+   */
+  void tagsRead(LibraryTrackList tracks);
+
+private slots:
+  void takeBatch(LibraryTrackList tracks);
+
+private:
+  friend class TagReadTask;
+
+  /**
+   * @brief start queues tasks until every thread of the pool has one, or
+   * every queued file has a task
+   */
+  void start();
+
+  /**
+   * @brief next takes the next file to read
+   * @return false when the queues and the library are through. The task
+   * calling it then stops
+   */
+  bool next(QString *path);
+
+  /**
+   * @brief pool runs the read tasks. It is not the global pool, so the
+   * destructor waits for these tasks only
+   */
+  QThreadPool pool;
+
+  /**
+   * @brief mutex guards the queues and the task count
+   */
+  QMutex mutex;
+  QStringList urgent, background;
+  int running;
+
+  /**
+   * @brief libraryNext is the next snapshot record of the library to look
+   * at, and libraryEnd the number of records. The mutex guards them too
+   */
+  int libraryNext, libraryEnd;
+
+  /**
+   * @brief attempted holds the files out of the library read during this
+   * run. The index remembers which of its files were read
+   */
+  QSet<QString> attempted;
+
+  LibraryIndex *library;
+};
+
+#endif // TAGREADER_H
@@ -0,0 +1,18 @@
+# checks that the approximate decibels of the compressed
+# spectrum stay within 0.001 dB of the exact ones
+TEMPLATE = app
+TARGET = tst_bands
+CONFIG += console testcase
+CONFIG -= app_bundle
+QT -= gui
+
+INCLUDEPATH += ../..
+
+SOURCES += tst_bands.cpp \
+    ../../bandmapper.cpp \
+    ../../simdkernels.cpp \
+    ../../fft.cpp
+
+HEADERS += ../../bandmapper.h \
+    ../../simdkernels.h \
+    ../../fft.h
@@ -0,0 +1,146 @@
+// checks the compressed spectrum. the log scale kernel of every
+// kernel set is compared with log10 over the whole range the
+// bands may take, then spectra are folded into bands on every
+// scale both ways, from the bins to the display values: tones,
+// noise, silence and bins over full scale. the approximate
+// values must be within 0.001 dB of the exact ones. the program
+// prints what fails and returns the failure count
+
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "bandmapper.h"
+#include "simdkernels.h"
+
+// 0.001 dB on the display scale, where 40 dB span [0,1]
+#define TOLERANCE (0.001/40)
+
+static int failures = 0;
+
+static const char *scaleNames[SCALE_COUNT] = {
+  "log", "linear", "mel", "bark", "third octave"
+};
+
+static double noise(){
+  return double(rand()) / RAND_MAX;
+}
+
+static void check(double error, const char *what){
+  if(!(error <= TOLERANCE)){
+    printf("FAIL %s: error %g dB\n", what, error*40);
+    failures++;
+  }
+}
+
+// the log kernel against 1 + 20*log10(x)/40, from far
+// below the display range to far over it
+template <typename T>
+static void checkLogScale(const FFTKernels &kernels){
+  const int n = 4001;
+  std::vector<T> in(n), out(n);
+  double error = 0;
+  char what[64];
+
+  for(int i=0; i<n; i++)
+    in[i] = T(std::pow(10.0, -8 + 10.0*i/(n-1)));
+  logScale(kernels, &in[0], &out[0], n, T(0.5*log10(2.0)), T(1));
+  for(int i=0; i<n; i++){
+    double exact = 1 + 20*log10(double(in[i]))/40;
+    exact = exact < 0 ? 0 : exact > 1 ? 1 : exact;
+    error = std::max(error, std::fabs(out[i] - exact));
+  }
+  snprintf(what, sizeof(what), "%s log scale, %s", kernels.name,
+           sizeof(T) == sizeof(float) ? "float" : "double");
+  check(error, what);
+}
+
+// the spectra a band may see, by kind
+enum Spectrum{ SILENCE, TONE, TONES, NOISE, LOUD, SPECTRA };
+
+static const char *spectrumNames[SPECTRA] = {
+  "silence", "a tone", "tones", "noise", "loud noise"
+};
+
+static void fill(std::vector<SpectrumComplex> &bins, int kind){
+  for(size_t i=0; i<bins.size(); i++)
+    bins[i] = 0;
+  switch(kind){
+  case TONE:
+    bins[rand() % bins.size()] = SpectrumComplex(SpectrumReal(0.3), SpectrumReal(0.1));
+    break;
+  case TONES:
+    for(int i=0; i<20; i++)
+      bins[rand() % bins.size()] = std::polar(SpectrumReal(noise()), SpectrumReal(6.28*noise()));
+    break;
+  default:
+    // noise falls about 3 db per octave, like most music
+    for(size_t i=0; i<bins.size(); i++){
+      SpectrumReal level = SpectrumReal((kind == LOUD ? 4 : 0.05) / std::sqrt(i + 1.0));
+      bins[i] = std::polar(level*SpectrumReal(noise()), SpectrumReal(6.28*noise()));
+    }
+    break;
+  }
+}
+
+// the bins go through the same kernels as in the analyzer
+static void checkBands(int binCount, int sampleRate, int bands, BandScale scale){
+  std::vector<SpectrumComplex> bins(binCount);
+  std::vector<SpectrumReal> magnitude(binCount), exact, approximate;
+  BandMapper mapper;
+  char what[128];
+
+  mapper.configure(binCount, sampleRate, bands, scale);
+  exact.resize(mapper.bands());
+  approximate.resize(mapper.bands());
+  for(int kind=0; kind<SPECTRA; kind++){
+    double error = 0;
+    bool bounded = true;
+    fill(bins, kind);
+    magnitudes(fftKernels(), &bins[0], &magnitude[0], binCount, SpectrumReal(1));
+    mapper.applyCompressed(&magnitude[0], &exact[0], false);
+    mapper.applyCompressed(&magnitude[0], &approximate[0], true);
+    for(int i=0; i<mapper.bands(); i++){
+      error = std::max(error, double(std::fabs(approximate[i] - exact[i])));
+      bounded = bounded && approximate[i] >= 0 && approximate[i] <= 1;
+    }
+    snprintf(what, sizeof(what), "%s, %d bins, %d %s bands", spectrumNames[kind],
+             binCount, mapper.bands(), scaleNames[scale]);
+    check(bounded ? error : 1, what);
+  }
+}
+
+int main(){
+  static const int binCounts[] = {128, 1024, 8192};
+  static const int bandCounts[] = {12, 64, 256, 1024};
+  const FFTKernels *checked[SIMD_AVX512 + 1];
+  int count = 0;
+
+  srand(1);
+
+  // levels the cpu lacks fall back to a supported one,
+  // which is checked once
+  for(int level=SIMD_SCALAR; level<=SIMD_AVX512; level++){
+    const FFTKernels &kernels = fftKernels(SimdLevel(level));
+    bool seen = false;
+    for(int i=0; i<count; i++)
+      seen = seen || checked[i] == &kernels;
+    if(seen)
+      continue;
+    checked[count++] = &kernels;
+    checkLogScale<double>(kernels);
+    checkLogScale<float>(kernels);
+    printf("%s kernels checked\n", kernels.name);
+  }
+
+  for(int scale=0; scale<SCALE_COUNT; scale++){
+    for(int i=0; i<3; i++){
+      for(int j=0; j<4; j++)
+        checkBands(binCounts[i], 44100, bandCounts[j], BandScale(scale));
+    }
+  }
+
+  printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+  return failures;
+}
@@ -0,0 +1,15 @@
+# checks the planned and real input FFTs against a plain DFT,
+# with every kernel set the cpu supports
+TEMPLATE = app
+TARGET = tst_fft
+CONFIG += console testcase
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += tst_fft.cpp \
+    ../../fft.cpp \
+    ../../simdkernels.cpp
+
+HEADERS += ../../fft.h \
+    ../../simdkernels.h
@@ -0,0 +1,143 @@
+// checks the FFT plans. the complex plans are compared with a
+// plain DFT, summed in long double, and the real input plans
+// with the complex plan of the same size. every kernel set the
+// cpu supports is checked, in double and in single precision.
+// the program prints what fails and returns the failure count
+
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "fft.h"
+#include "simdkernels.h"
+
+static int failures = 0;
+
+// random input in [-0.5, 0.5], the same for every run
+static double noise(){
+  return double(rand()) / RAND_MAX - 0.5;
+}
+
+// the error of a transform grows about as log2(n) times
+// the precision, times the size of the bins
+template <typename T>
+static double tolerance(size_t n){
+  double epsilon = sizeof(T) == sizeof(float) ? 1.2e-7 : 2.2e-16;
+  return 16 * epsilon * (std::log(double(n))/std::log(2.0) + 1) * std::sqrt(double(n));
+}
+
+template <typename T>
+static void check(const char *what, const FFTKernels &kernels, size_t n, double error){
+  if(error > tolerance<T>(n)){
+    printf("FAIL %s, %s, %s, n=%u: error %g, tolerance %g\n",
+           what, kernels.name, sizeof(T) == sizeof(float) ? "float" : "double",
+           unsigned(n), error, tolerance<T>(n));
+    failures++;
+  }
+}
+
+// the complex plan against the definition
+template <typename T>
+static void checkComplex(const FFTKernels &kernels, size_t n){
+  std::vector<std::complex<T> > x(n), y(n);
+  BasicFFTPlan<T> plan(n);
+  double error = 0;
+
+  std::vector<std::complex<long double> > roots(n);
+
+  for(size_t i=0; i<n; i++)
+    x[i] = y[i] = std::complex<T>(T(noise()), T(noise()));
+  plan.setKernels(kernels);
+  plan.transform(&y[0]);
+
+  // the n roots of unity, so the sums call no trig function
+  for(size_t k=0; k<n; k++){
+    long double angle = -2 * 3.14159265358979323846264338327950288L * k / n;
+    roots[k] = std::complex<long double>(std::cos(angle), std::sin(angle));
+  }
+  for(size_t k=0; k<n; k++){
+    std::complex<long double> sum = 0;
+    for(size_t j=0; j<n; j++)
+      sum += std::complex<long double>(x[j].real(), x[j].imag()) * roots[(j*k) % n];
+    error = std::max(error, double(std::abs(sum - std::complex<long double>(y[k].real(), y[k].imag()))));
+  }
+  check<T>("complex plan against the dft", kernels, n, error);
+}
+
+// the real plan against the complex plan of the same size
+template <typename T>
+static void checkReal(const FFTKernels &kernels, size_t n){
+  std::vector<T> x(n);
+  std::vector<std::complex<T> > y(n/2+1), z(n);
+  BasicRealFFTPlan<T> real(n);
+  BasicFFTPlan<T> complex(n);
+  double error = 0;
+
+  for(size_t i=0; i<n; i++){
+    x[i] = T(noise());
+    z[i] = x[i];
+  }
+  real.setKernels(kernels);
+  complex.setKernels(kernels);
+  real.transform(&x[0], &y[0]);
+  complex.transform(&z[0]);
+
+  for(size_t k=0; k<=n/2; k++)
+    error = std::max(error, double(std::abs(y[k] - z[k])));
+  check<T>("real plan against the complex plan", kernels, n, error);
+}
+
+template <typename T>
+static void checkAll(const FFTKernels &kernels){
+  // powers of two, odd and even log2, and sizes that go
+  // through bluestein's algorithm
+  static const size_t sizes[] = {1, 2, 3, 4, 5, 8, 12, 16, 32, 64, 100, 128,
+                                 256, 512, 1000, 1024, 2048, 4096, 8192};
+  // the dft takes n*n steps. the largest sizes are only
+  // checked through the real plan
+  for(size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++){
+    if(sizes[i] <= 2048)
+      checkComplex<T>(kernels, sizes[i]);
+    if(sizes[i] % 2 == 0)
+      checkReal<T>(kernels, sizes[i]);
+  }
+}
+
+int main(){
+  const FFTKernels *checked[SIMD_AVX512 + 1];
+  int count = 0;
+
+  srand(1);
+
+  // levels the cpu lacks fall back to a supported one,
+  // which is checked once
+  for(int level=SIMD_SCALAR; level<=SIMD_AVX512; level++){
+    const FFTKernels &kernels = fftKernels(SimdLevel(level));
+    bool seen = false;
+    for(int i=0; i<count; i++)
+      seen = seen || checked[i] == &kernels;
+    if(seen)
+      continue;
+    checked[count++] = &kernels;
+    checkAll<double>(kernels);
+    checkAll<float>(kernels);
+    printf("%s kernels checked\n", kernels.name);
+  }
+
+  // the convenience functions use the same plans
+  CArray x(64);
+  std::valarray<double> r(64);
+  CArray y;
+  for(size_t i=0; i<64; i++)
+    x[i] = r[i] = noise();
+  fft(x);
+  rfft(r, y);
+  double error = 0;
+  for(size_t k=0; k<=32; k++)
+    error = std::max(error, std::abs(x[k] - y[k]));
+  check<double>("rfft() against fft()", fftKernels(), 64, error);
+
+  printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+  return failures;
+}
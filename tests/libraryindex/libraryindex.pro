@@ -0,0 +1,15 @@
+# checks that the library index keeps the library and its order
+# from one run to the next, and survives a crash at any point
+TEMPLATE = app
+TARGET = tst_libraryindex
+CONFIG += console testcase
+CONFIG -= app_bundle
+QT -= gui
+
+INCLUDEPATH += ../..
+
+SOURCES += tst_libraryindex.cpp \
+    ../../libraryindex.cpp
+
+HEADERS += ../../libraryindex.h \
+    ../../librarytrack.h
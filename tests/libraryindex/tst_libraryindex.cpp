@@ -0,0 +1,281 @@
+// checks the library index across reopens. the tracks must come
+// back with every field and in the order they were added, with
+// the changes made since the last snapshot. journals are also
+// written here by hand, as a crash would leave them: an entry
+// torn at the tail, or a journal the snapshot already holds
+// because the crash came between writing the snapshot and
+// emptying the journal. the program prints what fails and
+// returns the failure count
+
+#include <cstdio>
+#include <cstring>
+#include <QDataStream>
+#include <QFile>
+#include <QTemporaryDir>
+#include "libraryindex.h"
+
+static int failures = 0;
+
+// the journal layout, as libraryindex.cpp writes it
+static const char JOURNAL_MAGIC[8] = {'P','F','L','I','B','J','N','L'};
+static const quint32 BYTE_ORDER_MARK = 0x01020304u;
+
+static void check(bool ok, const char *what){
+  if(!ok){
+    printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+static LibraryTrack makeTrack(int number){
+  LibraryTrack track;
+  track.path = QString("/music/%1 track.flac").arg(number);
+  track.inode = 1000 + number;
+  track.modified = 1500000000000LL + number;
+  track.size = 4000000 + number;
+  track.mimeType = "audio/flac";
+  track.title = QString("title %1").arg(number);
+  track.artist = number % 2 ? "artist" : QString::fromUtf8("art\xc3\xafste");
+  track.album = "album";
+  track.duration = 180000 + number;
+  track.tagsRead = number % 3 == 0;
+  if(number % 2){
+    track.loudness = -14.5f;
+    track.truePeak = -0.5f;
+  }
+  return track;
+}
+
+// nans compare unequal, so they are compared as unset
+static bool sameFloat(float a, float b){
+  return a == b || (qIsNaN(a) && qIsNaN(b));
+}
+
+static bool sameTrack(const LibraryTrack &a, const LibraryTrack &b){
+  return a.path == b.path && a.sameFile(b) && a.mimeType == b.mimeType &&
+      a.title == b.title && a.artist == b.artist && a.album == b.album &&
+      a.duration == b.duration && a.tagsRead == b.tagsRead &&
+      sameFloat(a.loudness, b.loudness) && sameFloat(a.truePeak, b.truePeak);
+}
+
+// the library must hold these tracks, in this order
+static void checkTracks(const LibraryIndex &index, const LibraryTrackList &expected,
+                        const char *when){
+  LibraryTrackList tracks = index.tracks();
+  LibraryTrack track;
+  char what[160];
+  bool same;
+
+  snprintf(what, sizeof(what), "%s: %d tracks instead of %d", when,
+           index.size(), expected.size());
+  check(index.size() == expected.size() && tracks.size() == expected.size(), what);
+  same = tracks.size() == expected.size();
+  for(int i=0; same && i<tracks.size(); i++)
+    same = sameTrack(tracks[i], expected[i]) && index.find(expected[i].path, &track) &&
+        sameTrack(track, expected[i]);
+  snprintf(what, sizeof(what), "%s: the tracks or their order changed", when);
+  check(same, what);
+}
+
+static QByteArray journalHeader(){
+  QByteArray data(JOURNAL_MAGIC, 8);
+  quint32 value = LIBRARY_INDEX_VERSION;
+  data.append(reinterpret_cast<const char*>(&value), 4);
+  data.append(reinterpret_cast<const char*>(&BYTE_ORDER_MARK), 4);
+  return data;
+}
+
+static void appendEntry(QByteArray &data, char op, const QByteArray &payload){
+  quint32 length = payload.size(), checksum = 2166136261u;
+  QByteArray body = op + payload;
+
+  for(int i=0; i<body.size(); i++){
+    checksum ^= uchar(body[i]);
+    checksum *= 16777619u;
+  }
+  data.append(reinterpret_cast<const char*>(&length), 4);
+  data.append(reinterpret_cast<const char*>(&checksum), 4);
+  data.append(body);
+}
+
+static void appendPut(QByteArray &data, const LibraryTrack &track){
+  QByteArray payload;
+  QDataStream stream(&payload, QIODevice::WriteOnly);
+  stream.setVersion(QDataStream::Qt_5_0);
+  stream << track.path << track.inode << track.modified << track.size
+         << track.mimeType << track.title << track.artist << track.album
+         << track.duration << track.loudness << track.truePeak << track.tagsRead;
+  appendEntry(data, 'P', payload);
+}
+
+static void appendRemove(QByteArray &data, const QString &path){
+  appendEntry(data, 'R', path.toUtf8());
+}
+
+static void writeFile(const QString &name, const QByteArray &data){
+  QFile file(name);
+  file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+  file.write(data);
+}
+
+static QByteArray readFile(const QString &name){
+  QFile file(name);
+  file.open(QIODevice::ReadOnly);
+  return file.readAll();
+}
+
+// tracks put, replaced and removed through the index, with
+// snapshots written in between
+static void checkReopen(const QString &name){
+  LibraryTrackList expected;
+  LibraryTrackList batch;
+  QStringList gone;
+  LibraryIndex index;
+
+  check(index.open(name), "reopen: the index does not open");
+  for(int i=0; i<40; i++){
+    batch.clear();
+    batch.append(makeTrack(i));
+    index.put(batch);
+    expected.append(makeTrack(i));
+  }
+  checkTracks(index, expected, "reopen, before closing");
+  index.close();
+  check(index.size() == 0, "reopen: the index is not empty once closed");
+
+  index.open(name);
+  checkTracks(index, expected, "reopen, from the snapshot");
+
+  // a replaced track keeps its place, and so does one taken
+  // out and put back. new ones follow in the order they came
+  expected[5].title = "retitled";
+  batch.clear();
+  batch.append(expected[5]);
+  index.put(batch);
+  gone.append(expected[7].path);
+  gone.append(expected[20].path);
+  index.remove(gone);
+  index.setAnalysis(expected[8].path, -9.0f, 0.25f);
+  expected[8].loudness = -9.0f;
+  expected[8].truePeak = 0.25f;
+  batch.clear();
+  batch.append(makeTrack(40));
+  batch.append(expected[7]);
+  batch.append(makeTrack(41));
+  index.put(batch);
+  expected.remove(20);
+  expected.append(makeTrack(40));
+  expected.append(makeTrack(41));
+  checkTracks(index, expected, "reopen, changed over the snapshot");
+  index.close();
+
+  index.open(name);
+  checkTracks(index, expected, "reopen, from the second snapshot");
+  index.close();
+}
+
+// entries are replayed up to the first one that is cut short or
+// does not match its checksum, and new ones go right after it
+static void checkTornTail(const QString &name){
+  LibraryTrackList expected;
+  QByteArray journal, torn, entry;
+  LibraryIndex index;
+
+  journal = journalHeader();
+  for(int i=0; i<3; i++){
+    appendPut(journal, makeTrack(i));
+    expected.append(makeTrack(i));
+  }
+  appendPut(entry, makeTrack(3));
+
+  // the last entry stops anywhere: within its length, its
+  // checksum or its payload. whatever is left of it must go,
+  // so the next entry is written where the next run reads it
+  for(int cut=1; cut<entry.size(); cut++){
+    QFile::remove(name);
+    torn = journal + entry.left(cut);
+    writeFile(name + ".journal", torn);
+    index.open(name);
+    checkTracks(index, expected, "torn tail, cut short");
+    check(!index.contains(makeTrack(3).path), "torn tail: the torn entry was replayed");
+    check(readFile(name + ".journal") == journal,
+          "torn tail: the torn entry was left in the journal");
+    index.close();
+  }
+
+  // an entry that was overwritten, as a sector written half
+  // way would be, is dropped with everything after it
+  QFile::remove(name);
+  torn = journal + entry;
+  torn[torn.size() - 5] = torn[torn.size() - 5] ^ 0x10;
+  appendPut(torn, makeTrack(5));
+  writeFile(name + ".journal", torn);
+  index.open(name);
+  checkTracks(index, expected, "torn tail, overwritten");
+  check(!index.contains(makeTrack(5).path),
+        "torn tail: an entry after the broken one was replayed");
+  check(readFile(name + ".journal") == journal,
+        "torn tail: the broken entry was left in the journal");
+  index.close();
+  index.open(name);
+  checkTracks(index, expected, "torn tail, from the snapshot");
+  index.close();
+}
+
+// compaction writes the snapshot, then empties the journal. a
+// crash in between leaves a journal the snapshot already holds,
+// which replayed must change nothing
+static void checkStaleJournal(const QString &name){
+  LibraryTrackList expected;
+  QByteArray journal;
+  LibraryTrack track;
+  LibraryIndex index;
+
+  QFile::remove(name);
+  journal = journalHeader();
+  for(int i=0; i<6; i++)
+    appendPut(journal, makeTrack(i));
+  appendRemove(journal, makeTrack(2).path);
+  track = makeTrack(4);
+  track.album = "another album";
+  appendPut(journal, track);
+  appendPut(journal, makeTrack(2));
+  appendRemove(journal, makeTrack(0).path);
+  appendRemove(journal, "/music/never added.flac");
+
+  // track 2 came back before any snapshot, so it keeps the
+  // place it had
+  expected << makeTrack(1) << makeTrack(2) << makeTrack(3) << track << makeTrack(5);
+  writeFile(name + ".journal", journal);
+  index.open(name);
+  checkTracks(index, expected, "stale journal, replayed");
+  check(index.compact(), "stale journal: the snapshot was not written");
+  check(readFile(name + ".journal") == journalHeader(),
+        "stale journal: the journal was not emptied");
+  checkTracks(index, expected, "stale journal, compacted");
+  index.close();
+
+  // the snapshot holds the journal, and the journal comes back
+  writeFile(name + ".journal", journal);
+  index.open(name);
+  checkTracks(index, expected, "stale journal, replayed over its snapshot");
+  index.close();
+  index.open(name);
+  checkTracks(index, expected, "stale journal, compacted again");
+  index.close();
+}
+
+int main(){
+  QTemporaryDir dir;
+
+  if(!dir.isValid()){
+    printf("FAIL no temporary folder\n");
+    return 1;
+  }
+  checkReopen(dir.path() + "/reopen.index");
+  checkTornTail(dir.path() + "/torn.index");
+  checkStaleJournal(dir.path() + "/stale.index");
+
+  printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+  return failures;
+}
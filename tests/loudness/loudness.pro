@@ -0,0 +1,17 @@
+# checks the loudness meter with the test signals of EBU Tech 3341:
+# momentary, short-term and integrated loudness, and true peak
+TEMPLATE = app
+TARGET = tst_loudness
+CONFIG += console testcase
+CONFIG -= app_bundle
+QT -= gui
+QT += multimedia
+
+INCLUDEPATH += ../..
+
+SOURCES += tst_loudness.cpp \
+    ../../loudnessmeter.cpp
+
+HEADERS += ../../loudnessmeter.h \
+    ../../pcmconvert.h \
+    ../../fft.h
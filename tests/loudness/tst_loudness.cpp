@@ -0,0 +1,209 @@
+// checks the loudness meter with the test signals of EBU Tech 3341,
+// generated here at 48 kHz. steady tones must read -23.0 LUFS
+// momentary, short-term and integrated, and the sequences of tones
+// at other levels must be gated down to -23.0 LUFS integrated. the
+// short-term loudness of a sequence that repeats every 3 s must
+// stay at -23.0, and tone bursts must peak at -23.0. every reading
+// may be 0.1 LU off. sines sampled away from their peaks must read
+// the true peak between the samples, within +0.2 and -0.4 dB. the
+// program prints what fails and returns the failure count
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "loudnessmeter.h"
+
+static int failures = 0;
+
+static const int RATE = 48000;
+
+// the meter sums its squares in blocks of 10 ms. the
+// signals are played and read one block at a time
+static const int BLOCK = RATE/100;
+
+// a channel that takes no part in a signal
+static const double MUTED = -1000;
+
+static void check(bool ok, const char *what, double value, double expected){
+  if(!ok){
+    printf("FAIL %s: %.2f instead of %.2f\n", what, value, expected);
+    failures++;
+  }
+}
+
+static void checkLoudness(const char *what, double value, double expected){
+  check(std::fabs(value - expected) <= 0.1, what, value, expected);
+}
+
+// plays sines to the meter and keeps the extremes of the
+// readings, one for each block
+class Player{
+public:
+  explicit Player(int _channels) : channels(_channels), frames(0), fade(0){
+    meter.configure(RATE, channels);
+    maxMomentary = maxShortTerm = -1000;
+    minShortTerm = 1000;
+  }
+
+  // levels are the peak of each channel in dBFS. the phase
+  // runs on from one call to the next
+  void play(double seconds, const double *levels, double frequency = 1000,
+            double phase = 0){
+    std::vector<SpectrumReal> samples(BLOCK*channels);
+    LoudnessReading reading;
+    qint64 start = frames, end = frames + qint64(seconds*RATE + 0.5);
+    double amplitude[8], value;
+    int count;
+
+    for(int c=0; c<channels; c++)
+      amplitude[c] = levels[c] <= MUTED ? 0 : std::pow(10.0, levels[c]/20);
+    while(frames < end){
+      count = int(qMin(qint64(BLOCK), end - frames));
+      for(int i=0; i<count; i++){
+        value = std::sin(2*PI*frequency*(frames + i)/RATE + phase);
+        if(frames + i - start < fade)
+          value *= 0.5 - 0.5*std::cos(PI*(frames + i - start)/fade);
+        for(int c=0; c<channels; c++)
+          samples[i*channels + c] = SpectrumReal(amplitude[c]*value);
+      }
+      meter.process(&samples[0], count);
+      frames += count;
+
+      // the short-term loudness is whole after 3 s
+      reading = meter.reading();
+      maxMomentary = qMax(maxMomentary, reading.momentary);
+      if(frames >= 3*RATE){
+        maxShortTerm = qMax(maxShortTerm, reading.shortTerm);
+        minShortTerm = qMin(minShortTerm, reading.shortTerm);
+      }
+    }
+    last = reading;
+  }
+
+  // the same level on the first two channels
+  void playStereo(double seconds, double level){
+    double levels[2] = {level, level};
+    play(seconds, levels);
+  }
+
+  LoudnessMeter meter;
+  int channels;
+  qint64 frames;
+
+  // the frames each play() takes to rise from silence
+  int fade;
+
+  LoudnessReading last;
+  float maxMomentary, maxShortTerm, minShortTerm;
+};
+
+// tests 1 and 2: steady stereo tones
+static void checkSteady(double level){
+  Player player(2);
+  char what[64];
+
+  player.playStereo(20, level);
+  snprintf(what, sizeof(what), "%g dBFS tone, momentary", level);
+  checkLoudness(what, player.last.momentary, level);
+  snprintf(what, sizeof(what), "%g dBFS tone, short-term", level);
+  checkLoudness(what, player.last.shortTerm, level);
+  snprintf(what, sizeof(what), "%g dBFS tone, integrated", level);
+  checkLoudness(what, player.last.integrated, level);
+}
+
+// tests 3 to 5: the quiet parts fall below the relative gate,
+// and the silent ones below the absolute gate
+static void checkGating(){
+  Player test3(2), test4(2), test5(2);
+
+  test3.playStereo(10, -36);
+  test3.playStereo(60, -23);
+  test3.playStereo(10, -36);
+  checkLoudness("test 3, integrated", test3.last.integrated, -23);
+
+  test4.playStereo(10, -72);
+  test4.playStereo(10, -36);
+  test4.playStereo(60, -23);
+  test4.playStereo(10, -36);
+  test4.playStereo(10, -72);
+  checkLoudness("test 4, integrated", test4.last.integrated, -23);
+
+  test5.playStereo(20, -26);
+  test5.playStereo(20.1, -20);
+  test5.playStereo(20, -26);
+  checkLoudness("test 5, integrated", test5.last.integrated, -23);
+}
+
+// test 6: 5.1 in the usual order, the surround channels
+// weighted up and the lfe channel silent
+static void checkSurround(){
+  double levels[6] = {-28, -28, -24, MUTED, -30, -30};
+  Player player(6);
+
+  player.play(20, levels);
+  checkLoudness("test 6, 5.1, integrated", player.last.integrated, -23);
+}
+
+// test 9: -20 dBFS for 1.34 s and -30 dBFS for 1.66 s, five
+// times over. any 3 s hold the same energy
+static void checkShortTerm(){
+  Player player(2);
+
+  for(int i=0; i<5; i++){
+    player.playStereo(1.34, -20);
+    player.playStereo(1.66, -30);
+  }
+  checkLoudness("test 9, lowest short-term", player.minShortTerm, -23);
+  checkLoudness("test 9, highest short-term", player.maxShortTerm, -23);
+}
+
+// tests 10 and 12: a 3 s and a 0.4 s tone burst, between
+// silences, peak as a steady tone of their level would
+static void checkBursts(){
+  Player longBurst(2), shortBurst(2);
+
+  longBurst.playStereo(2, MUTED);
+  longBurst.playStereo(3, -23);
+  longBurst.playStereo(2, MUTED);
+  checkLoudness("test 10, highest short-term", longBurst.maxShortTerm, -23);
+
+  shortBurst.playStereo(1, MUTED);
+  shortBurst.playStereo(0.4, -23);
+  shortBurst.playStereo(1, MUTED);
+  checkLoudness("test 12, highest momentary", shortBurst.maxMomentary, -23);
+}
+
+// tests 15 to 19: sines at a quarter, a sixth and an eighth of
+// the sample rate. the samples fall half a sample from the peaks.
+// they fade in over 10 ms: a sine that starts on a sample away
+// from 0 is a step, which rings through the oversampling filter
+static void checkTruePeak(const char *what, double level, double fraction, double degrees){
+  double levels[2] = {level, level};
+  Player player(2);
+  double peak;
+
+  player.fade = BLOCK;
+  player.play(1, levels, RATE*fraction, degrees*PI/180);
+  peak = player.meter.reading().maxTruePeak;
+  check(peak - level <= 0.2 && level - peak <= 0.4, what, peak, level);
+}
+
+int main(){
+  checkSteady(-23);
+  checkSteady(-33);
+  checkGating();
+  checkSurround();
+  checkShortTerm();
+  checkBursts();
+  checkTruePeak("test 15, true peak", -6.02, 1.0/4, 0);
+  checkTruePeak("test 16, true peak", -6.02, 1.0/4, 45);
+  checkTruePeak("test 17, true peak", -6.02, 1.0/6, 60);
+  checkTruePeak("test 18, true peak", -6.02, 1.0/8, 67.5);
+  checkTruePeak("test 19, true peak", 3.01, 1.0/4, 45);
+  // just below full scale, where a peak between the
+  // samples is what clips
+  checkTruePeak("-0.06 dBTP, true peak", -0.06, 1.0/4, 45);
+
+  printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+  return failures;
+}
@@ -0,0 +1,19 @@
+# checks the vector pcm conversion kernels against the scalar
+# ones, and the streams taken from the converted channels
+TEMPLATE = app
+TARGET = tst_pcmconvert
+CONFIG += console testcase
+CONFIG -= app_bundle
+QT -= gui
+QT += multimedia
+
+INCLUDEPATH += ../..
+
+SOURCES += tst_pcmconvert.cpp \
+    ../../pcmconvert.cpp \
+    ../../simdkernels.cpp \
+    ../../fft.cpp
+
+HEADERS += ../../pcmconvert.h \
+    ../../simdkernels.h \
+    ../../fft.h
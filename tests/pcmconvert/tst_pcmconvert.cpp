@@ -0,0 +1,165 @@
+// checks the pcm converter. every vector kernel must give the
+// same values as the scalar one, for every format, any number
+// of samples and any alignment. the scalar kernels are checked
+// on the limits of each format, and the channel modes on the
+// number of values they write. the program prints what fails
+// and returns the failure count
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "pcmconvert.h"
+
+static int failures = 0;
+
+static const char *formatNames[PCM_FORMATS] = {
+  "u8", "s8", "u16", "s16", "s24", "u32", "s32", "f32"
+};
+
+static void check(bool ok, const char *what){
+  if(!ok){
+    printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+// random bytes, the same for every run. float samples
+// include nans and infinities, which must come out as 0
+static std::vector<uchar> noise(int size){
+  std::vector<uchar> bytes(size);
+  for(int i=0; i<size; i++)
+    bytes[i] = uchar(rand());
+  return bytes;
+}
+
+// a vector kernel against the scalar one. the values are
+// written between guards, which must be left alone
+static void checkKernel(const PcmKernels &kernels, int format){
+  const PcmKernels &scalar = pcmKernels(SIMD_SCALAR);
+  std::vector<uchar> bytes = noise(4*80 + 3);
+  char what[128];
+
+  for(int offset=0; offset<4; offset++){
+    for(int count=0; count<70; count++){
+      std::vector<SpectrumReal> a(count + 2, 7), b(count + 2, 7);
+      scalar.convert[format](&bytes[offset], count, &a[1]);
+      kernels.convert[format](&bytes[offset], count, &b[1]);
+      bool same = memcmp(&a[0], &b[0], a.size()*sizeof(SpectrumReal)) == 0;
+      bool guarded = b[0] == 7 && b[count+1] == 7;
+      // 32 bit samples near full scale round to 1
+      for(int i=1; i<=count; i++)
+        same = same && (format == PCM_F32 || (b[i] >= -1 && b[i] <= 1));
+      snprintf(what, sizeof(what), "%s kernel, %s, %d samples at offset %d",
+               kernels.name, formatNames[format], count, offset);
+      check(same && guarded, what);
+    }
+  }
+}
+
+// the smallest, middle and largest sample of each format
+static void checkLimits(){
+  static const uchar low[PCM_FORMATS][4] = {
+    {0x00}, {0x80}, {0x00, 0x00}, {0x00, 0x80}, {0x00, 0x00, 0x80},
+    {0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x00, 0x80}, {0x00, 0x00, 0x80, 0xbf}
+  };
+  static const uchar middle[PCM_FORMATS][4] = {
+    {0x80}, {0x00}, {0x00, 0x80}, {0x00, 0x00}, {0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x80}, {0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x80, 0x7f}
+  };
+  const PcmKernels &scalar = pcmKernels(SIMD_SCALAR);
+  SpectrumReal x;
+  char what[64];
+
+  for(int f=0; f<PCM_FORMATS; f++){
+    scalar.convert[f](low[f], 1, &x);
+    snprintf(what, sizeof(what), "%s full scale", formatNames[f]);
+    check(x == -1, what);
+    // the middle of float is an infinity, which is muted
+    scalar.convert[f](middle[f], 1, &x);
+    snprintf(what, sizeof(what), "%s silence", formatNames[f]);
+    check(x == 0, what);
+  }
+}
+
+// converts channels of 16 bit samples and takes the streams of
+// every mode from them
+static void checkChannels(int channels){
+  const int frames = 50;
+  std::vector<uchar> bytes = noise(frames*channels*2);
+  const qint16 *samples = reinterpret_cast<const qint16*>(&bytes[0]);
+  int converted = pcmStreams(PCM_ALL_CHANNELS, channels);
+  std::vector<SpectrumReal> all(frames*converted + 1, 7);
+  QAudioFormat format;
+  char what[128];
+  bool same = true;
+
+  format.setChannelCount(channels);
+  format.setSampleSize(16);
+  format.setSampleType(QAudioFormat::SignedInt);
+  format.setByteOrder(QAudioFormat::LittleEndian);
+  snprintf(what, sizeof(what), "%d channels converted", channels);
+  check(pcmConvertChannels(format, &bytes[0], frames, &all[0]), what);
+  for(int i=0; i<frames; i++){
+    for(int c=0; c<converted; c++)
+      same = same && all[i*converted + c] == samples[i*channels + c] / SpectrumReal(32768);
+  }
+  check(same && all[frames*converted] == 7, what);
+
+  for(int mode=0; mode<PCM_CHANNEL_MODES; mode++){
+    int count = frames*pcmStreams(PcmChannelMode(mode), channels);
+    std::vector<SpectrumReal> out(count + 1, 7);
+    pcmSelectStreams(&all[0], frames, converted, PcmChannelMode(mode), &out[0]);
+    bool written = out[count] == 7;
+    for(int i=0; i<count; i++)
+      written = written && out[i] != 7;
+    snprintf(what, sizeof(what), "%d channels in mode %d write %d values",
+             channels, mode, count);
+    check(written, what);
+
+    // mono is its own right channel, with a silent side
+    if(channels == 1 && mode == PCM_MID_SIDE){
+      bool mono = true;
+      for(int i=0; i<frames; i++)
+        mono = mono && out[2*i] == all[i] && out[2*i+1] == 0;
+      check(mono, "mono mid and side");
+    }
+    if(channels == 2 && mode == PCM_MID_SIDE){
+      bool stereo = true;
+      for(int i=0; i<frames; i++){
+        stereo = stereo && out[2*i] == (all[2*i] + all[2*i+1]) / 2
+            && out[2*i+1] == (all[2*i] - all[2*i+1]) / 2;
+      }
+      check(stereo, "stereo mid and side");
+    }
+  }
+}
+
+int main(){
+  const PcmKernels *checked[SIMD_AVX512 + 1];
+  int count = 0;
+
+  srand(1);
+
+  // levels the cpu lacks fall back to a supported one,
+  // which is checked once
+  for(int level=SIMD_SSE2; level<=SIMD_AVX512; level++){
+    const PcmKernels &kernels = pcmKernels(SimdLevel(level));
+    bool seen = &kernels == &pcmKernels(SIMD_SCALAR);
+    for(int i=0; i<count; i++)
+      seen = seen || checked[i] == &kernels;
+    if(seen)
+      continue;
+    checked[count++] = &kernels;
+    for(int f=0; f<PCM_FORMATS; f++)
+      checkKernel(kernels, f);
+    printf("%s kernels checked\n", kernels.name);
+  }
+
+  checkLimits();
+  for(int channels=1; channels<=PCM_MAX_CHANNELS + 2; channels++)
+    checkChannels(channels);
+
+  printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+  return failures;
+}
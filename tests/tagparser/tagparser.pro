@@ -0,0 +1,16 @@
+# checks the tag parser on small files of every format it reads,
+# whole, cut short, or with lengths past their end
+TEMPLATE = app
+TARGET = tst_tagparser
+CONFIG += console testcase
+CONFIG -= app_bundle
+QT -= gui
+
+INCLUDEPATH += ../..
+DEFINES += FIXTURES=\\\"$$PWD/fixtures\\\"
+
+SOURCES += tst_tagparser.cpp \
+    ../../tagparser.cpp
+
+HEADERS += ../../tagparser.h \
+    ../../librarytrack.h
@@ -0,0 +1,107 @@
+// checks the tag parser on the files in fixtures. there is one of
+// each tag format: id3v2.2, id3v2.3 unsynchronized as a whole and
+// with an extended header, id3v2.4 with a frame unsynchronized on
+// its own, a picture and padding, id3v1, flac, flac behind an id3
+// tag, ogg vorbis, opus and wave. then the same files cut short,
+// and with lengths that run past the frame, the block or the file.
+// those must give the fields before the damage and leave the others
+// as they were. records start empty, as the tag reader hands them
+// over. the program prints what fails and returns the failure count
+
+#include <cstdio>
+#include "tagparser.h"
+
+static int failures = 0;
+
+// a field the file does not tell
+static const char *UNSET = "";
+
+struct Fixture{
+  const char *file;
+  const char *title, *artist, *album;
+  qint64 duration;
+};
+
+static const Fixture fixtures[] = {
+  {"id3v22.mp3", "Old Title", "Old Artist", "Old Album", 52},
+  {"id3v23-unsync.mp3", "\xc3\x9cnsynced T\xc3\xaetle", "\xc3\x84rtist", "Album \xc3\xbf", 215000},
+  {"id3v24.mp3", "\xc3\x9cn\xc3\xaf" "code Title", "Artist 2.4", "Album 2.4", 26122},
+  {"id3v1.mp3", "V1 Title", "V1 Artist", "V1 Alb\xc3\xbcm", 52},
+  {"tagged.flac", "Flac Title", "Flac Artist", "Flac Album", 10000},
+  {"id3-then.flac", "Id3 Title", "Flac Artist", UNSET, 10000},
+  {"tagged.ogg", "Vorbis Title", "Vorbis Artist", "Vorbis Album", 10000},
+  {"tagged.opus", "Opus Title", "Opus Artist", "Opus Album", 5000},
+  {"tagged.wav", "Wave Title", "Wave Artist", "Wave Album", 100},
+  {"not-audio.txt", UNSET, UNSET, UNSET, 0},
+
+  // cut in the middle of the album
+  {"truncated-id3v23.mp3", "\xc3\x9cnsynced T\xc3\xaetle", "\xc3\x84rtist", UNSET, 0},
+  {"truncated.flac", "Flac Title", "Flac Artist", UNSET, 10000},
+  {"truncated.opus", "Opus Title", "Opus Artist", UNSET, 0},
+  // cut in the middle of the audio
+  {"truncated.wav", "Wave Title", "Wave Artist", "Wave Album", 50},
+
+  // an artist frame longer than its tag, and a tag
+  // longer than its file
+  {"oversized-id3v24-frame.mp3", "Sized Title", UNSET, UNSET, 52},
+  {"oversized-id3v24-tag.mp3", "Huge Tag Title", UNSET, UNSET, 0},
+  // a block longer than the file, more comments than
+  // it holds, and an artist longer than the block
+  {"oversized.flac", "Flac Title", UNSET, UNSET, 10000},
+  // a vendor string longer than the packet
+  {"oversized.opus", UNSET, UNSET, UNSET, 5000},
+  // an artist longer than its list, and a chunk
+  // longer than the file
+  {"oversized.wav", "Wave Title", UNSET, UNSET, 100}
+};
+
+static void checkField(const char *file, const char *field, const QString &value,
+                       const char *expected){
+  if(value != QString::fromUtf8(expected)){
+    printf("FAIL %s: %s is \"%s\" instead of \"%s\"\n", file, field,
+           value.toUtf8().constData(), expected);
+    failures++;
+  }
+}
+
+static void checkFixture(const Fixture &fixture){
+  LibraryTrack track;
+
+  if(!readTags(QString(FIXTURES) + "/" + fixture.file, &track)){
+    printf("FAIL %s: not read\n", fixture.file);
+    failures++;
+    return;
+  }
+  checkField(fixture.file, "title", track.title, fixture.title);
+  checkField(fixture.file, "artist", track.artist, fixture.artist);
+  checkField(fixture.file, "album", track.album, fixture.album);
+  if(track.duration != fixture.duration){
+    printf("FAIL %s: duration is %lld instead of %lld\n", fixture.file,
+           (long long)track.duration, (long long)fixture.duration);
+    failures++;
+  }
+}
+
+int main(){
+  LibraryTrack track;
+
+  for(unsigned i=0; i<sizeof(fixtures)/sizeof(fixtures[0]); i++)
+    checkFixture(fixtures[i]);
+
+  // what the file does not tell is left alone
+  track.album = "Kept Album";
+  track.duration = 1234;
+  readTags(QString(FIXTURES) + "/truncated.opus", &track);
+  checkField("truncated.opus", "kept album", track.album, "Kept Album");
+  if(track.duration != 1234){
+    printf("FAIL truncated.opus: the duration was not kept\n");
+    failures++;
+  }
+  if(readTags(QString(FIXTURES) + "/missing.mp3", &track)){
+    printf("FAIL missing.mp3: read\n");
+    failures++;
+  }
+
+  printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+  return failures;
+}
@@ -0,0 +1,4 @@
+# checks of the analysis and library code. build them with the player, or
+# on their own, and run "make check"
+TEMPLATE = subdirs
+SUBDIRS = fft pcmconvert bands libraryindex tagparser loudness
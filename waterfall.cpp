@@ -0,0 +1,137 @@
+#include "waterfall.h"
+#include <QPainter>
+#include <QShowEvent>
+#include <QHideEvent>
+#include <QTimerEvent>
+
+// the spectrum is polled at most once every 16ms (60 rows per second)
+#define FRAME_INTERVAL 16
+
+// the colour map goes through these colours, from silence to full scale
+static const QRgb colorStops[] = {
+  qRgb(0, 0, 0), qRgb(0, 0, 160), qRgb(160, 0, 160),
+  qRgb(255, 64, 0), qRgb(255, 220, 0), qRgb(255, 255, 255)
+};
+
+Waterfall::Waterfall(QWidget *parent) :
+  AbstractSpectrograph(parent){
+  int stops, segment;
+  float t;
+
+  // one column per band, as told by the first spectrum. about 8
+  // seconds of history at the fastest polling rate
+  NUM_BANDS = 256;
+  HISTORY = 512;
+
+  // the lookup table is built once. each entry interpolates
+  // between two neighbour stops
+  stops = sizeof(colorStops)/sizeof(colorStops[0]);
+  colors.resize(256);
+  for(int i=0; i<256; i++){
+    t = i/255.0f*(stops-1);
+    segment = qMin(int(t), stops-2);
+    t -= segment;
+    QRgb a = colorStops[segment], b = colorStops[segment+1];
+    colors[i] = qRgb(qRound(qRed(a) + t*(qRed(b) - qRed(a))),
+                     qRound(qGreen(a) + t*(qGreen(b) - qGreen(a))),
+                     qRound(qBlue(a) + t*(qBlue(b) - qBlue(a))));
+  }
+
+  // the history starts silent
+  rows = QImage(NUM_BANDS, HISTORY, QImage::Format_RGB32);
+  rows.fill(colors[0]);
+  head = 0;
+
+  // the polling timer starts when the widget is shown
+  timerId = 0;
+}
+
+void Waterfall::setBandCount(int count){
+  // older rows do not fit the new columns
+  NUM_BANDS = count;
+  rows = QImage(NUM_BANDS, HISTORY, QImage::Format_RGB32);
+  rows.fill(colors[0]);
+  head = 0;
+}
+
+void Waterfall::loadSamples(QVector<SpectrumReal> &_spectrum){
+  int index;
+  QRgb *line;
+
+  if(_spectrum.isEmpty())
+    return;
+  if(_spectrum.size() != NUM_BANDS)
+    setBandCount(_spectrum.size());
+
+  // the oldest row is reused for the newest spectrum. nothing
+  // else moves
+  head = (head + HISTORY - 1) % HISTORY;
+  line = reinterpret_cast<QRgb*>(rows.scanLine(head));
+
+  // the analyzer already folded the spectrum into one value per column
+  for(int i=0; i<NUM_BANDS; i++){
+    index = int(_spectrum[i]*255 + 0.5f);
+    line[i] = colors[qBound(0, index, 255)];
+  }
+  update();
+}
+
+void Waterfall::loadLevels(double left, double right){
+  Q_UNUSED(left);
+  Q_UNUSED(right);
+}
+
+void Waterfall::paintEvent(QPaintEvent *e){
+  int newer;
+  qreal rowHeight, split;
+  Q_UNUSED(e);
+
+  QPainter p(this);
+
+  // rows from head to the bottom of the image are the newest
+  // ones, so they go first. the rows above head follow them
+  newer = HISTORY - head;
+  rowHeight = qreal(height())/HISTORY;
+  split = newer*rowHeight;
+  p.drawImage(QRectF(0, 0, width(), split), rows,
+              QRectF(0, head, NUM_BANDS, newer));
+  if(head > 0){
+    p.drawImage(QRectF(0, split, width(), height() - split), rows,
+                QRectF(0, 0, NUM_BANDS, head));
+  }
+}
+
+void Waterfall::timerEvent(QTimerEvent *e){
+  Q_UNUSED(e);
+
+  // the picture only changes when a spectrum arrives. without
+  // one (paused or stopped), polling stops until the next one
+  if(!pollSpectrum() && sleepSpectrum())
+    stopPolling();
+}
+
+void Waterfall::spectrumReady(){
+  startPolling();
+}
+
+void Waterfall::showEvent(QShowEvent *e){
+  Q_UNUSED(e);
+  startPolling();
+}
+
+void Waterfall::hideEvent(QHideEvent *e){
+  Q_UNUSED(e);
+  stopPolling();
+}
+
+void Waterfall::startPolling(){
+  if(timerId == 0 && isVisible())
+    timerId = startTimer(FRAME_INTERVAL);
+}
+
+void Waterfall::stopPolling(){
+  if(timerId != 0){
+    killTimer(timerId);
+    timerId = 0;
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef WATERFALL_H
+#define WATERFALL_H
+
+#include "abstractspectrograph.h"
+
+#include <QImage>
+#include <QRgb>
+#include <QVector>
+
+/**
+ * @brief The Waterfall class draws a scrolling time-frequency picture
+ * @details Each new spectrum becomes one row of pixels, the newest at the top.
+ * Frequency goes from left to right and the colour tells the magnitude.
+ *
+ * The rows live in a circular QImage with a fixed number of rows, so memory
+ * is bounded. A new row is written over the oldest one, through a colour
+ * lookup table, and only the index of the newest row moves: adding a
+ * spectrum costs O(bands), however long the history is. The image is drawn
+ * with two blits, one on each side of the newest row.
+ */
+class Waterfall : public AbstractSpectrograph{
+  Q_OBJECT
+public:
+  /**
+   * @brief Class constructor
+   * @param parent is the pointer to parent widget
+   */
+  explicit Waterfall(QWidget *parent = 0);
+
+public slots:
+  /**
+   * @brief loadSamples writes the spectrum as the newest row
+   * @param _spectrum stores the spectrum, with values within [0,1]
+   */
+  void loadSamples(QVector<SpectrumReal> &_spectrum);
+
+  /**
+   * @brief loadLevels is not used. The waterfall has no level meters
+   */
+  void loadLevels(double left, double right);
+
+  /**
+   * @brief Restarts polling when a spectrum arrives while idle
+   */
+  void spectrumReady();
+
+protected:
+  void paintEvent(QPaintEvent *e);
+  void timerEvent(QTimerEvent *e);
+  void showEvent(QShowEvent *e);
+  void hideEvent(QHideEvent *e);
+
+private:
+  void startPolling();
+  void stopPolling();
+
+  /**
+   * @brief setBandCount restarts the history with a new number of columns
+   */
+  void setBandCount(int count);
+
+  /**
+   * @brief Number of frequency columns. It follows the size of the spectra
+   */
+  int NUM_BANDS;
+
+  /**
+   * @brief Number of rows kept in the history
+   */
+  int HISTORY;
+
+  /**
+   * @brief The circular image. Row head is the newest spectrum, the
+   * rows after it are older and older, and the ones before it are the oldest
+   */
+  QImage rows;
+  int head;
+
+  /**
+   * @brief The colour map: one colour for each magnitude step
+   */
+  QVector<QRgb> colors;
+
+  /**
+   * @brief Id of the polling timer, 0 while idle
+   */
+  int timerId;
+};
+
+#endif // WATERFALL_H
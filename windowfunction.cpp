@@ -0,0 +1,150 @@
+#include "windowfunction.h"
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWeakPointer>
+#include <cmath>
+
+static const char *windowNames[WINDOW_TYPES] = {
+  "hann", "hamming", "blackman-harris", "kaiser", "flat-top", "gaussian"
+};
+
+// cosine sum windows: w = a0 - a1 cos(x) + a2 cos(2x) - ...
+static const double hannTerms[] = { 0.5, 0.5 };
+static const double hammingTerms[] = { 0.54, 0.46 };
+static const double blackmanHarrisTerms[] = { 0.35875, 0.48829, 0.14128, 0.01168 };
+static const double flatTopTerms[] = { 0.21557895, 0.41663158, 0.277263158,
+                                       0.083578947, 0.006947368 };
+
+// the key of a shared table
+struct WindowKey{
+  int type, size;
+  double parameter;
+  bool operator<(const WindowKey &other) const{
+    if(type != other.type)
+      return type < other.type;
+    if(size != other.size)
+      return size < other.size;
+    return parameter < other.parameter;
+  }
+};
+
+// tables are only kept while someone uses them
+static QMutex registryMutex;
+static QMap<WindowKey, QWeakPointer<const WindowTable> > registry;
+
+static double cosineSum(const double *terms, int count, double x){
+  double sum = 0;
+  for(int k=0; k<count; k++)
+    sum += (k % 2 ? -terms[k] : terms[k])*cos(k*x);
+  return sum;
+}
+
+// modified bessel function of the first kind, order zero
+static double besselI0(double x){
+  double sum = 1, term = 1;
+  for(int k=1; k<64 && term > 1e-12*sum; k++){
+    term *= (x/(2*k))*(x/(2*k));
+    sum += term;
+  }
+  return sum;
+}
+
+static double defaultParameter(WindowType type){
+  switch(type){
+  case WINDOW_KAISER:
+    return 8.6;
+  case WINDOW_GAUSSIAN:
+    return 0.4;
+  default:
+    return 0;
+  }
+}
+
+static WindowTable *buildWindow(WindowType type, int size, double parameter){
+  WindowTable *table = new WindowTable;
+  double x, w, sum, squares;
+
+  table->type = type;
+  table->parameter = parameter;
+  table->coefficients.resize(size);
+  sum = squares = 0;
+  for(int i=0; i<size; i++){
+    // the phase of the sample, and its position in [-1,1)
+    x = 2*PI*i/size;
+    switch(type){
+    case WINDOW_HAMMING:
+      w = cosineSum(hammingTerms, 2, x);
+      break;
+    case WINDOW_BLACKMAN_HARRIS:
+      w = cosineSum(blackmanHarrisTerms, 4, x);
+      break;
+    case WINDOW_KAISER:
+      x = 2.0*i/size - 1;
+      w = besselI0(parameter*sqrt(1 - x*x))/besselI0(parameter);
+      break;
+    case WINDOW_FLAT_TOP:
+      w = cosineSum(flatTopTerms, 5, x);
+      break;
+    case WINDOW_GAUSSIAN:
+      x = (2.0*i/size - 1)/parameter;
+      w = exp(-0.5*x*x);
+      break;
+    default:
+      w = cosineSum(hannTerms, 2, x);
+      break;
+    }
+    table->coefficients[i] = SpectrumReal(w);
+    sum += w;
+    squares += w*w;
+  }
+  table->coherentGain = size > 0 ? sum/size : 1;
+  table->energyGain = size > 0 ? sqrt(squares/size) : 1;
+  return table;
+}
+
+QSharedPointer<const WindowTable> windowTable(WindowType type, int size, double parameter){
+  QSharedPointer<const WindowTable> table;
+  WindowKey key;
+
+  if(type < 0 || type >= WINDOW_TYPES)
+    type = WINDOW_HANN;
+  if(parameter <= 0)
+    parameter = defaultParameter(type);
+  key.type = type;
+  key.size = size;
+  key.parameter = parameter;
+
+  // a table still in use somewhere is shared. otherwise it is built
+  // again. building takes well under a millisecond for any size
+  QMutexLocker locker(&registryMutex);
+  table = registry.value(key).toStrongRef();
+  if(table.isNull()){
+    table = QSharedPointer<const WindowTable>(buildWindow(type, size, parameter));
+    registry.insert(key, table);
+  }
+
+  // forget tables nobody holds anymore
+  for(QMap<WindowKey, QWeakPointer<const WindowTable> >::iterator it = registry.begin();
+      it != registry.end();){
+    if(it.value().isNull())
+      it = registry.erase(it);
+    else
+      it++;
+  }
+  return table;
+}
+
+QString windowName(WindowType type){
+  if(type < 0 || type >= WINDOW_TYPES)
+    type = WINDOW_HANN;
+  return windowNames[type];
+}
+
+WindowType windowType(const QString &name){
+  for(int i=0; i<WINDOW_TYPES; i++){
+    if(name == windowNames[i])
+      return WindowType(i);
+  }
+  return WINDOW_HANN;
+}
@@ -0,0 +1,97 @@
+#ifndef WINDOWFUNCTION_H
+#define WINDOWFUNCTION_H
+
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include "fft.h"
+
+/**
+ * @brief WindowType lists the window functions the analyzer may use
+ */
+enum WindowType{
+  WINDOW_HANN = 0,
+  WINDOW_HAMMING,
+  WINDOW_BLACKMAN_HARRIS,
+  /**
+   * @brief WINDOW_KAISER takes beta as its parameter (8.6 by default)
+   */
+  WINDOW_KAISER,
+  WINDOW_FLAT_TOP,
+  /**
+   * @brief WINDOW_GAUSSIAN takes the standard deviation as its parameter,
+   * relative to half the window (0.4 by default)
+   */
+  WINDOW_GAUSSIAN,
+  WINDOW_TYPES
+};
+
+/**
+ * @brief The WindowTable struct holds the coefficients of a window function
+ * for one frame size, along with its correction factors
+ * @details Windows are periodic (the DFT-even form), which is what a
+ * spectrum analyzer wants: the coefficient after the last one would be
+ * the first one again.
+ */
+struct WindowTable{
+  WindowType type;
+
+  /**
+   * @brief parameter is the shape parameter of Kaiser and Gaussian windows
+   */
+  double parameter;
+
+  /**
+   * @brief coefficients holds one value for each sample of the frame
+   */
+  QVector<SpectrumReal> coefficients;
+
+  /**
+   * @brief coherentGain is the mean of the coefficients. A windowed sine
+   * peaks at this fraction of its unwindowed height
+   */
+  double coherentGain;
+
+  /**
+   * @brief energyGain is the root mean square of the coefficients. The
+   * energy of windowed noise is multiplied by its square
+   */
+  double energyGain;
+
+  /**
+   * @brief amplitudeCorrection scales magnitudes so a sine reads the same
+   * height with any window
+   */
+  double amplitudeCorrection() const { return 1/coherentGain; }
+
+  /**
+   * @brief energyCorrection scales magnitudes so broadband noise reads the
+   * same level with any window
+   */
+  double energyCorrection() const { return 1/energyGain; }
+};
+
+/**
+ * @brief windowTable returns the coefficients of a window function
+ * @details Tables are built the first time a (type, size, parameter) is
+ * asked for and shared by everyone asking for it while it is in use.
+ * Any thread may call it.
+ * @param type is the window function
+ * @param size is the frame size
+ * @param parameter is the shape parameter. 0 picks the default one
+ */
+QSharedPointer<const WindowTable> windowTable(WindowType type, int size, double parameter = 0);
+
+/**
+ * @brief windowName returns the name of a window function, as stored in
+ * the settings
+ */
+QString windowName(WindowType type);
+
+/**
+ * @brief windowType returns the window function of a name
+ * @return the window, or WINDOW_HANN when the name is unknown
+ */
+WindowType windowType(const QString &name);
+
+#endif // WINDOWFUNCTION_H